@@ -0,0 +1,362 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <string.h>
+#include "alert_store.h"
+
+#define INDEX_MASK (ALERT_STORE_INDEX_SLOTS - 1)
+
+// Parses count digits at *text into *value.
+static bool parse_digits(char const** text, char const* end, size_t count, int32_t* value)
+{
+    if ((size_t)(end - *text) < count) {
+        return false;
+    }
+    int32_t parsed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        char c = (*text)[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        parsed = parsed * 10 + (c - '0');
+    }
+    *text += count;
+    *value = parsed;
+    return true;
+}
+
+static bool parse_char(char const** text, char const* end, char expected)
+{
+    if (*text == end || **text != expected) {
+        return false;
+    }
+    (*text)++;
+    return true;
+}
+
+static bool is_leap_year(int32_t year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int32_t days_in_month(int32_t year, int32_t month)
+{
+    static int32_t const days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 && is_leap_year(year) ? 29 : days[month - 1];
+}
+
+// Days from 1970-01-01 to a date of the proleptic Gregorian calendar. Years start in March, so that the leap day is
+// the last day of a year, and are grouped in eras of 400 years, which all have the same number of days.
+static int64_t days_from_civil(int32_t year, int32_t month, int32_t day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+bool alert_time_parse(char const* text, size_t size, int64_t* epoch_ms)
+{
+    char const* end = text + size;
+    int32_t year, month, day, hour, minute, second;
+    if (!parse_digits(&text, end, 4, &year) || !parse_char(&text, end, '-')
+            || !parse_digits(&text, end, 2, &month) || !parse_char(&text, end, '-')
+            || !parse_digits(&text, end, 2, &day) || !parse_char(&text, end, 'T')
+            || !parse_digits(&text, end, 2, &hour) || !parse_char(&text, end, ':')
+            || !parse_digits(&text, end, 2, &minute) || !parse_char(&text, end, ':')
+            || !parse_digits(&text, end, 2, &second)) {
+        return false;
+    }
+    // A leap second is the last millisecond of its minute, as close as milliseconds since the epoch get.
+    if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month) || hour > 23 || minute > 59
+            || second > 60) {
+        return false;
+    }
+
+    int32_t millisecond = 0;
+    if (text != end && (*text == '.' || *text == ',')) {
+        text++;
+        int32_t scale = 100;
+        int32_t digit;
+        if (!parse_digits(&text, end, 1, &digit)) {
+            return false;
+        }
+        do {
+            millisecond += digit * scale;
+            scale /= 10;
+        } while (parse_digits(&text, end, 1, &digit));
+    }
+
+    int32_t offset_minutes = 0;
+    if (text != end && *text == 'Z') {
+        text++;
+    } else if (text != end && (*text == '+' || *text == '-')) {
+        int32_t sign = *text == '-' ? -1 : 1;
+        int32_t offset_hour;
+        int32_t offset_minute = 0;
+        text++;
+        if (!parse_digits(&text, end, 2, &offset_hour)) {
+            return false;
+        }
+        if (text != end) {
+            parse_char(&text, end, ':');
+            if (!parse_digits(&text, end, 2, &offset_minute)) {
+                return false;
+            }
+        }
+        if (offset_hour > 23 || offset_minute > 59) {
+            return false;
+        }
+        offset_minutes = sign * (offset_hour * 60 + offset_minute);
+    }
+    if (text != end) {
+        return false;
+    }
+
+    int64_t seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + (minute - offset_minutes) * 60;
+    if (second == 60) {
+        *epoch_ms = (seconds + 60) * 1000 - 1;
+    } else {
+        *epoch_ms = (seconds + second) * 1000 + millisecond;
+    }
+    return true;
+}
+
+alert_type_t alert_type_parse(char const* text, size_t size)
+{
+    static struct {
+        char const* name;
+        alert_type_t type;
+    } const types[] = {{"TIMER", ALERT_TYPE_TIMER}, {"ALARM", ALERT_TYPE_ALARM}, {"REMINDER", ALERT_TYPE_REMINDER}};
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (strlen(types[i].name) == size && 0 == memcmp(types[i].name, text, size)) {
+            return types[i].type;
+        }
+    }
+    return ALERT_TYPE_OTHER;
+}
+
+// 32-bit FNV-1a hash of a token.
+static uint32_t hash_token(char const* token, size_t size)
+{
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ (uint8_t)token[i]) * 16777619U;
+    }
+    return hash;
+}
+
+static bool token_equals(alert_t const* alert, char const* token, size_t size)
+{
+    return 0 == strncmp(alert->token, token, size) && alert->token[size] == '\0';
+}
+
+// Slot of the alert with this token, or the empty slot where it would go.
+static size_t find_slot(alert_store_t const* store, char const* token, size_t size)
+{
+    size_t slot = hash_token(token, size) & INDEX_MASK;
+    while (store->index[slot] && !token_equals(store->index[slot], token, size)) {
+        slot = (slot + 1) & INDEX_MASK;
+    }
+    return slot;
+}
+
+// Empties a slot of the index. The entries after it in the probe sequence are moved back to fill the gap, rather than
+// leaving a deleted marker, so lookups never get longer as alerts come and go.
+static void remove_slot(alert_store_t* store, size_t slot)
+{
+    size_t gap = slot;
+    store->index[gap] = NULL;
+    for (size_t next = (gap + 1) & INDEX_MASK; store->index[next]; next = (next + 1) & INDEX_MASK) {
+        alert_t const* alert = store->index[next];
+        size_t home = hash_token(alert->token, strlen(alert->token)) & INDEX_MASK;
+        // The entry can move to the gap if its home slot is not between the gap and its slot, cyclically.
+        if (((next - home) & INDEX_MASK) >= ((next - gap) & INDEX_MASK)) {
+            store->index[gap] = store->index[next];
+            store->index[next] = NULL;
+            gap = next;
+        }
+    }
+}
+
+static void heap_place(alert_store_t* store, size_t position, alert_t* alert)
+{
+    store->heap[position] = alert;
+    alert->heap_index = position;
+}
+
+static void sift_up(alert_store_t* store, size_t position)
+{
+    alert_t* alert = store->heap[position];
+    while (position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (store->heap[parent]->next_ms <= alert->next_ms) {
+            break;
+        }
+        heap_place(store, position, store->heap[parent]);
+        position = parent;
+    }
+    heap_place(store, position, alert);
+}
+
+static void sift_down(alert_store_t* store, size_t position)
+{
+    alert_t* alert = store->heap[position];
+    for (;;) {
+        size_t child = position * 2 + 1;
+        if (child >= store->count) {
+            break;
+        }
+        if (child + 1 < store->count && store->heap[child + 1]->next_ms < store->heap[child]->next_ms) {
+            child++;
+        }
+        if (alert->next_ms <= store->heap[child]->next_ms) {
+            break;
+        }
+        heap_place(store, position, store->heap[child]);
+        position = child;
+    }
+    heap_place(store, position, alert);
+}
+
+// Restores the heap order after the next_ms of an alert in the heap changed.
+static void heap_update(alert_store_t* store, alert_t* alert)
+{
+    size_t position = alert->heap_index;
+    sift_up(store, position);
+    sift_down(store, alert->heap_index);
+}
+
+// Removes an alert from the heap and the index. It stays valid until release() is called.
+static void unlink_alert(alert_store_t* store, alert_t* alert)
+{
+    size_t position = alert->heap_index;
+    store->count--;
+    if (position != store->count) {
+        heap_place(store, position, store->heap[store->count]);
+        heap_update(store, store->heap[position]);
+    }
+    remove_slot(store, find_slot(store, alert->token, strlen(alert->token)));
+}
+
+static void release(alert_store_t* store, alert_t* alert)
+{
+    store->free_alerts[store->free_count++] = alert;
+}
+
+void alert_store_init(alert_store_t* store, uint32_t loop_duration_ms, alert_callback_t callback, void* context)
+{
+    memset(store, 0, sizeof(*store));
+    for (size_t i = 0; i < ALERT_STORE_MAX_ALERTS; ++i) {
+        store->free_alerts[i] = &store->alerts[ALERT_STORE_MAX_ALERTS - 1 - i];
+    }
+    store->free_count = ALERT_STORE_MAX_ALERTS;
+    store->loop_duration_ms = loop_duration_ms;
+    store->callback = callback;
+    store->context = context;
+}
+
+alert_store_result_t alert_store_set(alert_store_t* store, char const* token, size_t token_size, alert_type_t type,
+        int64_t scheduled_ms, int32_t loop_count, int32_t loop_pause_ms)
+{
+    if (token_size == 0 || token_size >= ALERT_TOKEN_SIZE || memchr(token, '\0', token_size)) {
+        return ALERT_STORE_INVALID_TOKEN;
+    }
+    size_t slot = find_slot(store, token, token_size);
+    alert_t* alert = store->index[slot];
+    if (alert) {
+        if (alert->state != ALERT_STATE_SCHEDULED) {
+            store->callback(store->context, alert, ALERT_EVENT_STOPPED, alert->next_ms);
+        }
+    } else {
+        if (store->free_count == 0) {
+            return ALERT_STORE_FULL;
+        }
+        alert = store->free_alerts[--store->free_count];
+        memcpy(alert->token, token, token_size);
+        alert->token[token_size] = '\0';
+        store->index[slot] = alert;
+        heap_place(store, store->count++, alert);
+    }
+    alert->type = type;
+    alert->state = ALERT_STATE_SCHEDULED;
+    alert->scheduled_ms = scheduled_ms;
+    alert->next_ms = scheduled_ms;
+    alert->loop = 0;
+    alert->loop_count = loop_count > 0 ? loop_count : 1;
+    alert->loop_pause_ms = loop_pause_ms > 0 ? loop_pause_ms : 0;
+    heap_update(store, alert);
+    return ALERT_STORE_OK;
+}
+
+bool alert_store_delete(alert_store_t* store, char const* token, size_t token_size)
+{
+    if (token_size >= ALERT_TOKEN_SIZE) {
+        return false;
+    }
+    alert_t* alert = store->index[find_slot(store, token, token_size)];
+    if (!alert) {
+        return false;
+    }
+    unlink_alert(store, alert);
+    if (alert->state != ALERT_STATE_SCHEDULED) {
+        store->callback(store->context, alert, ALERT_EVENT_STOPPED, alert->next_ms);
+    }
+    release(store, alert);
+    return true;
+}
+
+alert_t const* alert_store_find(alert_store_t const* store, char const* token, size_t token_size)
+{
+    if (token_size >= ALERT_TOKEN_SIZE) {
+        return NULL;
+    }
+    return store->index[find_slot(store, token, token_size)];
+}
+
+void alert_store_poll(alert_store_t* store, int64_t now_ms)
+{
+    while (store->count > 0 && store->heap[0]->next_ms <= now_ms) {
+        alert_t* alert = store->heap[0];
+        int64_t due_ms = alert->next_ms;
+        // Times follow from the scheduled time rather than from when the poll ran, so late polls do not add up.
+        if (alert->state == ALERT_STATE_PLAYING) {
+            alert->loop++;
+            if (alert->loop >= alert->loop_count) {
+                unlink_alert(store, alert);
+                store->callback(store->context, alert, ALERT_EVENT_FINISHED, due_ms);
+                release(store, alert);
+                continue;
+            }
+            alert->state = ALERT_STATE_PAUSED;
+            alert->next_ms += alert->loop_pause_ms;
+            heap_update(store, alert);
+            continue;
+        }
+        if (alert->state == ALERT_STATE_SCHEDULED && now_ms - alert->scheduled_ms > ALERT_STORE_MAX_LATE_MS) {
+            unlink_alert(store, alert);
+            store->callback(store->context, alert, ALERT_EVENT_EXPIRED, due_ms);
+            release(store, alert);
+            continue;
+        }
+        alert->state = ALERT_STATE_PLAYING;
+        alert->next_ms += store->loop_duration_ms;
+        heap_update(store, alert);
+        store->callback(store->context, alert, ALERT_EVENT_LOOP_STARTED, due_ms);
+    }
+}
+
+bool alert_store_next_deadline(alert_store_t const* store, int64_t* deadline_ms)
+{
+    if (store->count == 0) {
+        return false;
+    }
+    *deadline_ms = store->heap[0]->next_ms;
+    return true;
+}
@@ -0,0 +1,136 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_ALERT_STORE_H
+#define ALEXA_GADGETS_SAMPLE_CODE_ALERT_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of alerts that can be set at once.
+#define ALERT_STORE_MAX_ALERTS (32U)
+// Slots of the token index. A power of two, at least twice the number of alerts to keep probes short.
+#define ALERT_STORE_INDEX_SLOTS (64U)
+// Size of a token, NUL included. Same as the max_size of the DeleteAlert token.
+#define ALERT_TOKEN_SIZE (64U)
+// Alerts whose scheduled time is this far in the past are expired rather than played, e.g. after a power cycle.
+#define ALERT_STORE_MAX_LATE_MS (30 * 60 * 1000)
+
+typedef enum {
+    ALERT_TYPE_TIMER = 0,
+    ALERT_TYPE_ALARM,
+    ALERT_TYPE_REMINDER,
+    ALERT_TYPE_OTHER
+} alert_type_t;
+
+typedef enum {
+    // Waiting for its scheduled time.
+    ALERT_STATE_SCHEDULED = 0,
+    // Playing a loop of the alert sound.
+    ALERT_STATE_PLAYING,
+    // In the pause between two loops.
+    ALERT_STATE_PAUSED
+} alert_state_t;
+
+typedef struct {
+    char token[ALERT_TOKEN_SIZE];
+    alert_type_t type;
+    alert_state_t state;
+    // Scheduled time, in milliseconds since the Unix epoch.
+    int64_t scheduled_ms;
+    // When the alert changes state next: the scheduled time, or the end of a loop or of a pause.
+    int64_t next_ms;
+    // Loop being played or about to be, from 0, out of loop_count.
+    int32_t loop;
+    int32_t loop_count;
+    int32_t loop_pause_ms;
+    // Position in the heap of the store.
+    size_t heap_index;
+} alert_t;
+
+typedef enum {
+    // A loop of the alert sound starts: play it.
+    ALERT_EVENT_LOOP_STARTED = 0,
+    // The last loop is over.
+    ALERT_EVENT_FINISHED,
+    // The alert was deleted while playing or pausing between loops: stop the sound.
+    ALERT_EVENT_STOPPED,
+    // The alert was due more than ALERT_STORE_MAX_LATE_MS ago and was not played.
+    ALERT_EVENT_EXPIRED
+} alert_event_t;
+
+// Called when an alert changes state, due_ms being when the change was due. STOPPED happens when the alert is deleted
+// or set again, and its due_ms is when the alert would have changed state next. The alert is removed from the store
+// after FINISHED, STOPPED and EXPIRED. The callback must not change the store.
+typedef void (*alert_callback_t)(void* context, alert_t const* alert, alert_event_t event, int64_t due_ms);
+
+typedef enum {
+    ALERT_STORE_OK = 0,
+    // The store has ALERT_STORE_MAX_ALERTS alerts already.
+    ALERT_STORE_FULL,
+    // The token is empty or does not fit in ALERT_TOKEN_SIZE.
+    ALERT_STORE_INVALID_TOKEN
+} alert_store_result_t;
+
+// Alerts ordered by the time they change state next, in a binary min-heap, and indexed by token in an open addressing
+// hash table. Setting and deleting an alert is O(log n), and finding what is due next is O(1), so a gadget can sleep
+// until then instead of scanning the alerts on every tick. Times are given by the caller in milliseconds since the
+// Unix epoch, so the store does not depend on a platform.
+typedef struct {
+    alert_t alerts[ALERT_STORE_MAX_ALERTS];
+    alert_t* free_alerts[ALERT_STORE_MAX_ALERTS];
+    size_t free_count;
+    alert_t* heap[ALERT_STORE_MAX_ALERTS];
+    size_t count;
+    // Alerts by token hash, with linear probing. NULL for an empty slot.
+    alert_t* index[ALERT_STORE_INDEX_SLOTS];
+    // Length of the alert sound of the gadget, i.e. of a loop.
+    uint32_t loop_duration_ms;
+    alert_callback_t callback;
+    void* context;
+} alert_store_t;
+
+// Parses an ISO-8601 date and time, e.g. "2019-12-03T10:15:30+0000", into milliseconds since the Unix epoch.
+// Accepts fractions of a second and a "Z", "+HH", "+HHMM" or "+HH:MM" offset. A time without offset is taken as UTC.
+// Does not allocate and does not depend on the time zone of the system.
+bool alert_time_parse(char const* text, size_t size, int64_t* epoch_ms);
+
+// Maps the type of a SetAlert directive, e.g. "TIMER", to an alert_type_t.
+alert_type_t alert_type_parse(char const* text, size_t size);
+
+// Initializes an empty store.
+void alert_store_init(alert_store_t* store, uint32_t loop_duration_ms, alert_callback_t callback, void* context);
+
+// Sets an alert from a SetAlert directive. An alert with the same token is updated, and restarts if it was playing.
+// A loop count of 0 or less plays the alert once.
+alert_store_result_t alert_store_set(alert_store_t* store, char const* token, size_t token_size, alert_type_t type,
+        int64_t scheduled_ms, int32_t loop_count, int32_t loop_pause_ms);
+
+// Deletes an alert, e.g. from a DeleteAlert directive. Returns false if there is no alert with this token.
+bool alert_store_delete(alert_store_t* store, char const* token, size_t token_size);
+
+// Returns the alert with this token, or NULL.
+alert_t const* alert_store_find(alert_store_t const* store, char const* token, size_t token_size);
+
+// Moves the alerts due at now_ms on, calling the callback for each change.
+void alert_store_poll(alert_store_t* store, int64_t now_ms);
+
+// Returns when an alert changes state next in *deadline_ms, for the caller to sleep until then and poll.
+// Returns false if the store is empty.
+bool alert_store_next_deadline(alert_store_t const* store, int64_t* deadline_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_ALERT_STORE_H
@@ -0,0 +1,189 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <string.h>
+#include "beat_clock.h"
+
+#define PPM (1000000)
+
+// Song position at local time now_us.
+static int64_t media_at(beat_clock_timeline_t const* timeline, uint64_t now_us)
+{
+    int64_t elapsed_us = (int64_t)(now_us - timeline->anchor_local_us);
+    return timeline->anchor_media_us + elapsed_us + elapsed_us * timeline->rate_ppm / PPM;
+}
+
+// Local time of song position media_us, rounded up so that the song has reached media_us at that time.
+static uint64_t local_at(beat_clock_timeline_t const* timeline, int64_t media_us)
+{
+    int64_t scaled_us = (media_us - timeline->anchor_media_us) * PPM;
+    int64_t rate = PPM + timeline->rate_ppm;
+    int64_t elapsed_us = scaled_us >= 0 ? (scaled_us + rate - 1) / rate : -(-scaled_us / rate);
+    return timeline->anchor_local_us + (uint64_t)elapsed_us;
+}
+
+// Writes the timeline to the buffer the readers do not read, then switches them to it. The buffer is only written with
+// atomic stores, so a reader still reading it from the update before last gets a torn copy but no data race, and
+// retries because its generation changed.
+static void publish(beat_clock_t* clock, beat_clock_timeline_t const* timeline)
+{
+    uint32_t words[BEAT_CLOCK_TIMELINE_WORDS] = {0};
+    memcpy(words, timeline, sizeof(*timeline));
+    unsigned index = atomic_load_explicit(&clock->active, memory_order_relaxed) ^ 1U;
+    unsigned generation = atomic_load_explicit(&clock->generation[index], memory_order_relaxed);
+    atomic_store_explicit(&clock->generation[index], generation + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < BEAT_CLOCK_TIMELINE_WORDS; ++i) {
+        atomic_store_explicit(&clock->buffer[index][i], words[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&clock->generation[index], generation + 2, memory_order_release);
+    atomic_store_explicit(&clock->active, index, memory_order_release);
+    clock->timeline = *timeline;
+}
+
+// Reads a consistent copy of the timeline. The active buffer is never being written, so this only loops if the
+// writer published twice during the read, and never waits for it.
+static void read_timeline(beat_clock_t const* clock, beat_clock_timeline_t* timeline)
+{
+    uint32_t words[BEAT_CLOCK_TIMELINE_WORDS];
+    for (;;) {
+        unsigned index = atomic_load_explicit(&clock->active, memory_order_acquire);
+        unsigned generation = atomic_load_explicit(&clock->generation[index], memory_order_acquire);
+        for (size_t i = 0; i < BEAT_CLOCK_TIMELINE_WORDS; ++i) {
+            words[i] = atomic_load_explicit(&clock->buffer[index][i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        // An odd generation means the writer moved on to this buffer after it was loaded as the active one.
+        if (!(generation & 1U) && atomic_load_explicit(&clock->generation[index], memory_order_relaxed) == generation) {
+            memcpy(timeline, words, sizeof(*timeline));
+            return;
+        }
+    }
+}
+
+void beat_clock_init(beat_clock_t* clock, uint32_t delivery_delay_us)
+{
+    memset(&clock->timeline, 0, sizeof(clock->timeline));
+    atomic_init(&clock->active, 0);
+    for (size_t index = 0; index < 2; ++index) {
+        atomic_init(&clock->generation[index], 0);
+        for (size_t i = 0; i < BEAT_CLOCK_TIMELINE_WORDS; ++i) {
+            atomic_init(&clock->buffer[index][i], 0);
+        }
+    }
+    clock->synced = false;
+    clock->delivery_delay_us = delivery_delay_us;
+    clock->resync_count = 0;
+}
+
+void beat_clock_stop(beat_clock_t* clock)
+{
+    beat_clock_timeline_t timeline = clock->timeline;
+    timeline.tempo_count = 0;
+    clock->synced = false;
+    publish(clock, &timeline);
+}
+
+// Replaces the tempo changes from the first new one on, and drops those that are over at song position media_us.
+static void merge_tempo(beat_clock_timeline_t* timeline, int64_t media_us, beat_clock_tempo_t const* tempo,
+        size_t tempo_count)
+{
+    size_t kept = 0;
+    while (kept < timeline->tempo_count && tempo_count > 0
+            && timeline->tempo[kept].start_offset_ms < tempo[0].start_offset_ms) {
+        kept++;
+    }
+    timeline->tempo_count = kept;
+    for (size_t i = 0; i < tempo_count; ++i) {
+        if (tempo[i].bpm <= 0 || (timeline->tempo_count > 0
+                && tempo[i].start_offset_ms <= timeline->tempo[timeline->tempo_count - 1].start_offset_ms)) {
+            continue;
+        }
+        if (timeline->tempo_count == BEAT_CLOCK_MAX_TEMPO) {
+            // The table is full: this and the later tempo changes are dropped.
+            break;
+        }
+        timeline->tempo[timeline->tempo_count++] = tempo[i];
+    }
+
+    size_t over = 0;
+    while (over + 1 < timeline->tempo_count && (int64_t)timeline->tempo[over + 1].start_offset_ms * 1000 <= media_us) {
+        over++;
+    }
+    memmove(timeline->tempo, timeline->tempo + over, (timeline->tempo_count - over) * sizeof(timeline->tempo[0]));
+    timeline->tempo_count -= over;
+}
+
+void beat_clock_update(beat_clock_t* clock, uint64_t now_us, int32_t player_offset_ms,
+        beat_clock_tempo_t const* tempo, size_t tempo_count)
+{
+    beat_clock_timeline_t timeline = clock->timeline;
+    // The player was at player_offset_ms when the directive was sent, it has moved on by the delivery delay since.
+    int64_t measured_us = (int64_t)player_offset_ms * 1000 + clock->delivery_delay_us;
+    int64_t error_us = clock->synced ? measured_us - media_at(&timeline, now_us) : 0;
+
+    if (!clock->synced || error_us > BEAT_CLOCK_RESYNC_US || error_us < -BEAT_CLOCK_RESYNC_US) {
+        if (clock->synced) {
+            clock->resync_count++;
+        }
+        timeline.anchor_media_us = measured_us;
+        timeline.rate_ppm = 0;
+        timeline.tempo_count = 0;
+        clock->synced = true;
+    } else {
+        // Proportional term: half of the error now. Integral term: a quarter of the rate the error suggests.
+        uint64_t elapsed_us = now_us - timeline.anchor_local_us;
+        timeline.anchor_media_us = media_at(&timeline, now_us) + error_us / 2;
+        if (elapsed_us > 0) {
+            int64_t rate_ppm = timeline.rate_ppm + error_us * PPM / (int64_t)elapsed_us / 4;
+            if (rate_ppm > BEAT_CLOCK_MAX_RATE_PPM) {
+                rate_ppm = BEAT_CLOCK_MAX_RATE_PPM;
+            } else if (rate_ppm < -BEAT_CLOCK_MAX_RATE_PPM) {
+                rate_ppm = -BEAT_CLOCK_MAX_RATE_PPM;
+            }
+            timeline.rate_ppm = (int32_t)rate_ppm;
+        }
+    }
+    timeline.anchor_local_us = now_us;
+    merge_tempo(&timeline, timeline.anchor_media_us, tempo, tempo_count);
+    publish(clock, &timeline);
+}
+
+bool beat_clock_next_beat(beat_clock_t const* clock, uint64_t now_us, beat_t* beat)
+{
+    beat_clock_timeline_t timeline;
+    read_timeline(clock, &timeline);
+    if (timeline.tempo_count == 0) {
+        return false;
+    }
+
+    int64_t media_us = media_at(&timeline, now_us);
+    size_t index = 0;
+    while (index + 1 < timeline.tempo_count && (int64_t)timeline.tempo[index + 1].start_offset_ms * 1000 <= media_us) {
+        index++;
+    }
+    beat_clock_tempo_t const* tempo = &timeline.tempo[index];
+    int64_t start_us = (int64_t)tempo->start_offset_ms * 1000;
+    int64_t period_us = 60 * PPM / tempo->bpm;
+    int64_t beat_us = start_us;
+    if (media_us > start_us) {
+        beat_us += (media_us - start_us + period_us - 1) / period_us * period_us;
+    }
+    // The next tempo change starts on a beat of its own.
+    if (index + 1 < timeline.tempo_count) {
+        int64_t next_start_us = (int64_t)timeline.tempo[index + 1].start_offset_ms * 1000;
+        if (beat_us >= next_start_us) {
+            beat_us = next_start_us;
+            tempo = &timeline.tempo[index + 1];
+            period_us = 60 * PPM / tempo->bpm;
+        }
+    }
+    beat->local_us = local_at(&timeline, beat_us);
+    beat->period_us = (uint32_t)period_us;
+    beat->bpm = tempo->bpm;
+    return true;
+}
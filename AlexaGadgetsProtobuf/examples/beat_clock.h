@@ -0,0 +1,96 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_BEAT_CLOCK_H
+#define ALEXA_GADGETS_SAMPLE_CODE_BEAT_CLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of tempo changes kept. Once it is reached, the later tempo changes of a directive are dropped.
+#define BEAT_CLOCK_MAX_TEMPO (16U)
+// A Tempo directive this far from the predicted song position restarts the clock, e.g. after a seek or a new song.
+#define BEAT_CLOCK_RESYNC_US (200000)
+// Largest rate correction between the local clock and the player, in parts per million.
+#define BEAT_CLOCK_MAX_RATE_PPM (2000)
+
+// The song plays at bpm beats per minute from start_offset_ms on, with a beat at start_offset_ms.
+typedef struct {
+    int32_t start_offset_ms;
+    int32_t bpm;
+} beat_clock_tempo_t;
+
+// What the beat queries read: the song position at a local time, and the tempo changes.
+typedef struct {
+    // Song position anchor_media_us was reached at local time anchor_local_us, and the song moves on by
+    // 1000000 + rate_ppm microseconds per million microseconds of local time.
+    uint64_t anchor_local_us;
+    int64_t anchor_media_us;
+    int32_t rate_ppm;
+    size_t tempo_count;
+    beat_clock_tempo_t tempo[BEAT_CLOCK_MAX_TEMPO];
+} beat_clock_timeline_t;
+
+// Size of a timeline in the 32-bit words it is published in.
+#define BEAT_CLOCK_TIMELINE_WORDS ((sizeof(beat_clock_timeline_t) + 3U) / 4U)
+
+// Beat clock phase-locked to the song from the Tempo directives.
+// It is updated by a single thread, the one handling the directives, and can be queried from any number of threads
+// or interrupts without locks. The timeline is double buffered: an update writes the buffer readers do not read and
+// then switches them to it, so a query never waits for an update to finish, even from an interrupt that preempted it.
+// A query only reads again if its buffer was written over while it read it, i.e. after two updates.
+typedef struct {
+    // Buffer the queries read.
+    atomic_uint active;
+    // Odd while the buffer is written.
+    atomic_uint generation[2];
+    atomic_uint_least32_t buffer[2][BEAT_CLOCK_TIMELINE_WORDS];
+    // Last timeline published, for the updating thread only.
+    beat_clock_timeline_t timeline;
+    bool synced;
+    // Time from the player offset being sent to the directive being received, e.g. the BLE connection interval.
+    uint32_t delivery_delay_us;
+    size_t resync_count;
+} beat_clock_t;
+
+typedef struct {
+    // Local time of the beat.
+    uint64_t local_us;
+    // Time to the beat after it, at the current tempo.
+    uint32_t period_us;
+    int32_t bpm;
+} beat_t;
+
+// Initializes a clock with no tempo.
+void beat_clock_init(beat_clock_t* clock, uint32_t delivery_delay_us);
+
+// Updates the clock from a Tempo directive received at now_us. player_offset_ms is the song position when it was sent
+// and the tempo start offsets are song positions, like speechmarks. The tempo changes replace the ones from the first
+// of them on. The clock error, i.e. where the song is compared to where the clock predicted, is corrected smoothly:
+// half of it at once and the rest through the rate between the local clock and the player.
+void beat_clock_update(beat_clock_t* clock, uint64_t now_us, int32_t player_offset_ms,
+        beat_clock_tempo_t const* tempo, size_t tempo_count);
+
+// Drops the tempo, e.g. when the music stops.
+void beat_clock_stop(beat_clock_t* clock);
+
+// Returns the first beat at or after now_us. Lock-free and without system calls, for loops running at 1 kHz.
+// Returns false if there is no tempo.
+bool beat_clock_next_beat(beat_clock_t const* clock, uint64_t now_us, beat_t* beat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_BEAT_CLOCK_H
@@ -47,3 +47,6 @@ for /R %INPUT_ROOT%\AlexaGadgetsProtobuf\common %%G in (*.proto) do (
 	echo Compiling %%G
 	%PROTO_COMMAND% -I. --nanopb_out=%OUTPUT_PATH% %%~nG%%~xG
 )
+
+echo Generating directive ids
+python %OUTPUT_PATH%\gen_directive_ids.py %INPUT_ROOT%\AlexaGadgetsProtobuf %OUTPUT_PATH%
@@ -46,3 +46,6 @@ for file in $all_proto_files; do
 	$output_path \
 	$proto_path
 done
+
+echo 'generating directive ids'
+python3 gen_directive_ids.py .. $CURRENT_FOLDER
@@ -0,0 +1,118 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <string.h>
+#include "pb.h"
+#include "pb_decode.h"
+#include "directive_arena.h"
+
+void directive_arena_init(directive_arena_t* arena, void* buffer, size_t size)
+{
+    arena->buffer = buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->failed_count = 0;
+}
+
+void* directive_arena_alloc(directive_arena_t* arena, size_t size)
+{
+    size_t const alignment = _Alignof(max_align_t);
+    uintptr_t const base = (uintptr_t)arena->buffer;
+    size_t offset = ((base + arena->used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    if (offset > arena->size || size > arena->size - offset) {
+        arena->failed_count++;
+        return NULL;
+    }
+    arena->used = offset + size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return &arena->buffer[offset];
+}
+
+void directive_arena_reset(directive_arena_t* arena)
+{
+    arena->used = 0;
+    arena->failed_count = 0;
+}
+
+bool directive_arena_list_decode(pb_istream_t* stream, pb_field_t const* field, void** arg)
+{
+    directive_arena_list_t* list = *arg;
+    directive_arena_node_t* node = directive_arena_alloc(list->arena, sizeof(*node) + list->item_size);
+    if (!node) {
+        PB_RETURN_ERROR(stream, "directive arena full");
+    }
+    node->next = NULL;
+    // Zeroed like an init_default message: empty fields and no callbacks.
+    memset(node->item, 0, list->item_size);
+    if (list->prepare && !list->prepare(list->arena, node->item)) {
+        PB_RETURN_ERROR(stream, "directive arena full");
+    }
+    if (!pb_decode(stream, list->fields, node->item)) {
+        return false;
+    }
+    if (list->tail) {
+        list->tail->next = node;
+    } else {
+        list->head = node;
+    }
+    list->tail = node;
+    list->count++;
+    return true;
+}
+
+void directive_arena_list_bind(pb_callback_t* callback, directive_arena_list_t* list)
+{
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+    callback->funcs.decode = directive_arena_list_decode;
+    callback->arg = list;
+}
+
+// Where a string field bound to an arena is copied. Allocated from the arena when the field is bound.
+typedef struct {
+    directive_arena_t* arena;
+    char* value;
+} arena_string_t;
+
+static bool decode_arena_string(pb_istream_t* stream, pb_field_t const* field, void** arg)
+{
+    arena_string_t* string = *arg;
+    size_t size = stream->bytes_left;
+    char* value = directive_arena_alloc(string->arena, size + 1);
+    if (!value) {
+        PB_RETURN_ERROR(stream, "directive arena full");
+    }
+    if (!pb_read(stream, (pb_byte_t*)value, size)) {
+        return false;
+    }
+    value[size] = '\0';
+    string->value = value;
+    return true;
+}
+
+bool directive_arena_string_bind(directive_arena_t* arena, pb_callback_t* callback)
+{
+    arena_string_t* string = directive_arena_alloc(arena, sizeof(*string));
+    if (!string) {
+        return false;
+    }
+    string->arena = arena;
+    string->value = NULL;
+    callback->funcs.decode = decode_arena_string;
+    callback->arg = string;
+    return true;
+}
+
+char const* directive_arena_string(pb_callback_t const* callback)
+{
+    arena_string_t const* string = callback->arg;
+    return string && string->value ? string->value : "";
+}
@@ -0,0 +1,84 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_ARENA_H
+#define ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bump allocator over a caller-provided buffer, holding what the decode of one directive allocates.
+// Everything is released at once by directive_arena_reset(), there is no per-allocation free.
+typedef struct {
+    uint8_t* buffer;
+    size_t size;
+    size_t used;
+    // Largest number of bytes used by one directive, to size the buffer.
+    size_t peak;
+    // Number of allocations that did not fit since the arena was last reset.
+    size_t failed_count;
+} directive_arena_t;
+
+// Initializes an arena. The buffer must outlive the arena.
+void directive_arena_init(directive_arena_t* arena, void* buffer, size_t size);
+
+// Returns size bytes aligned for any type, or NULL if the arena is full.
+void* directive_arena_alloc(directive_arena_t* arena, size_t size);
+
+// Releases all memory allocated from the arena.
+void directive_arena_reset(directive_arena_t* arena);
+
+// Element of a directive_arena_list_t, followed by the decoded element message.
+typedef struct directive_arena_node_s {
+    struct directive_arena_node_s* next;
+    max_align_t item[];
+} directive_arena_node_t;
+
+// Binds the callback fields of an element message before it is decoded, e.g. with directive_arena_string_bind().
+// Returns false if the arena is full.
+typedef bool (*directive_arena_prepare_t)(directive_arena_t* arena, void* item);
+
+// Elements of a repeated message field declared with type:FT_CALLBACK, decoded into the arena in the received order.
+// There is no maximum count: the arena size bounds the memory used by the whole directive instead.
+typedef struct {
+    directive_arena_t* arena;
+    // Fields and size of the element message, e.g. alexaGadgetMusicData_TempoDirectivePayloadProto_TempoData_fields.
+    pb_field_t const* fields;
+    size_t item_size;
+    // Optional.
+    directive_arena_prepare_t prepare;
+    directive_arena_node_t* head;
+    directive_arena_node_t* tail;
+    size_t count;
+} directive_arena_list_t;
+
+// Decode callback of a repeated message field, appending to the directive_arena_list_t *arg.
+bool directive_arena_list_decode(pb_istream_t* stream, pb_field_t const* field, void** arg);
+
+// Binds a repeated message field to a list. The list is emptied.
+void directive_arena_list_bind(pb_callback_t* callback, directive_arena_list_t* list);
+
+// Binds a string field declared with type:FT_CALLBACK to a NUL terminated copy of its value in the arena.
+// Returns false if the arena is full.
+bool directive_arena_string_bind(directive_arena_t* arena, pb_callback_t* callback);
+
+// Returns the value of a string field bound with directive_arena_string_bind(), or "" if it was not present.
+char const* directive_arena_string(pb_callback_t const* callback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_ARENA_H
@@ -0,0 +1,194 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <stdio.h>
+#include <string.h>
+#include "pb.h"
+#include "pb_decode.h"
+#include "directiveHeader.pb.h"
+#include "directiveParser.pb.h"
+#include "directive_arena.h"
+#include "directive_ids.h"
+#include "directive_router.h"
+#include "directive_strings.h"
+
+// FNV-1a over the namespace and the name, with a separator so that ("ab", "c") and ("a", "bc") differ.
+static uint32_t hash_directive(char const* namespace, char const* name)
+{
+    uint32_t hash = 2166136261U;
+    for (char const* c = namespace; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619U;
+    }
+    hash = (hash ^ 0xffU) * 16777619U;
+    for (char const* c = name; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619U;
+    }
+    return hash;
+}
+
+// Returns the slot of a custom directive, or the empty slot where it would be added.
+static size_t find_slot(directive_router_t const* router, char const* namespace, char const* name)
+{
+    size_t index = hash_directive(namespace, name) & (DIRECTIVE_ROUTER_SLOTS - 1);
+    // Linear probing. The table is never full, so an empty slot always ends the probe.
+    while (router->slots[index].namespace != NULL) {
+        if (0 == strcmp(router->slots[index].namespace, namespace) && 0 == strcmp(router->slots[index].name, name)) {
+            break;
+        }
+        index = (index + 1) & (DIRECTIVE_ROUTER_SLOTS - 1);
+    }
+    return index;
+}
+
+void directive_router_init(directive_router_t* router)
+{
+    memset(router, 0, sizeof(*router));
+}
+
+bool directive_router_register(directive_router_t* router, directive_route_t const* route)
+{
+    directive_id_t id = directive_id_lookup(route->namespace, route->name);
+    if (id != DIRECTIVE_ID_UNKNOWN) {
+        if (router->known[id].namespace != NULL) {
+            printf("%s: %s.%s already has a route\n", __FUNCTION__, route->namespace, route->name);
+            return false;
+        }
+        router->known[id] = *route;
+        return true;
+    }
+    if (router->count + 1 >= DIRECTIVE_ROUTER_SLOTS) {
+        printf("%s: no slot left for %s.%s\n", __FUNCTION__, route->namespace, route->name);
+        return false;
+    }
+    size_t index = find_slot(router, route->namespace, route->name);
+    if (router->slots[index].namespace != NULL) {
+        printf("%s: %s.%s already has a route\n", __FUNCTION__, route->namespace, route->name);
+        return false;
+    }
+    router->slots[index] = *route;
+    router->count++;
+    return true;
+}
+
+directive_route_t const* directive_router_find(directive_router_t const* router, char const* namespace,
+        char const* name)
+{
+    // Directives defined under AlexaGadgetsProtobuf are found with one hash and one comparison, only custom
+    // directives are looked up in the hash table.
+    directive_id_t id = directive_id_lookup(namespace, name);
+    directive_route_t const* route = id != DIRECTIVE_ID_UNKNOWN ? &router->known[id]
+            : &router->slots[find_slot(router, namespace, name)];
+    return route->namespace != NULL ? route : NULL;
+}
+
+// Decodes the fields of DirectiveParserProto.Directive: the header, and the location of the payload.
+// end is the offset in the buffer of the end of stream.
+static bool peek_directive_fields(pb_istream_t* stream, size_t end, header_DirectiveHeaderProto* header,
+        directive_slice_t* payload)
+{
+    while (stream->bytes_left) {
+        pb_wire_type_t wire_type;
+        uint32_t tag;
+        bool eof;
+        if (!pb_decode_tag(stream, &wire_type, &tag, &eof)) {
+            return eof;
+        }
+        if (tag == directive_DirectiveParserProto_Directive_header_tag && wire_type == PB_WT_STRING) {
+            pb_istream_t header_stream;
+            if (!pb_make_string_substream(stream, &header_stream)) {
+                return false;
+            }
+            bool status = pb_decode(&header_stream, header_DirectiveHeaderProto_fields, header);
+            pb_close_string_substream(stream, &header_stream);
+            if (!status) {
+                return false;
+            }
+        } else if (tag == directive_DirectiveParserProto_Directive_payload_tag && wire_type == PB_WT_STRING) {
+            uint32_t size;
+            if (!pb_decode_varint32(stream, &size) || size > stream->bytes_left) {
+                return false;
+            }
+            // Leave the payload in the buffer, it is decoded once its type is known.
+            payload->offset = end - stream->bytes_left;
+            payload->size = size;
+            if (!pb_read(stream, NULL, size)) {
+                return false;
+            }
+        } else if (!pb_skip_field(stream, wire_type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool directive_peek(uint8_t const* buffer, size_t len, header_DirectiveHeaderProto* header,
+        directive_slice_t* payload)
+{
+    *header = (header_DirectiveHeaderProto) header_DirectiveHeaderProto_init_default;
+    payload->offset = 0;
+    payload->size = 0;
+
+    pb_istream_t stream = pb_istream_from_buffer(buffer, len);
+    while (stream.bytes_left) {
+        pb_wire_type_t wire_type;
+        uint32_t tag;
+        bool eof;
+        if (!pb_decode_tag(&stream, &wire_type, &tag, &eof)) {
+            return eof;
+        }
+        if (tag == directive_DirectiveParserProto_directive_tag && wire_type == PB_WT_STRING) {
+            pb_istream_t directive_stream;
+            if (!pb_make_string_substream(&stream, &directive_stream)) {
+                return false;
+            }
+            // The substream ends where the rest of the stream begins.
+            bool status = peek_directive_fields(&directive_stream, len - stream.bytes_left, header, payload);
+            pb_close_string_substream(&stream, &directive_stream);
+            if (!status) {
+                return false;
+            }
+        } else if (!pb_skip_field(&stream, wire_type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+directive_router_result_t directive_router_dispatch(directive_router_t const* router, uint8_t const* buffer,
+        size_t len, header_DirectiveHeaderProto* header)
+{
+    directive_slice_t payload;
+    if (!directive_peek(buffer, len, header, &payload)) {
+        return DIRECTIVE_ROUTER_DECODE_ERROR;
+    }
+    directive_route_t const* route = directive_router_find(router, header->namespace, header->name);
+    if (!route) {
+        return DIRECTIVE_ROUTER_UNKNOWN_DIRECTIVE;
+    }
+    // The payload stream tracks its position in the buffer, for the string views of the payload.
+    directive_string_source_t source;
+    pb_istream_t stream = directive_string_istream(&source, buffer + payload.offset, payload.size);
+    if (route->prepare) {
+        route->prepare(route->context, route->payload, &source);
+    }
+    directive_router_result_t result = DIRECTIVE_ROUTER_HANDLED;
+    if (route->payload_fields) {
+        if (!pb_decode(&stream, route->payload_fields, route->payload)) {
+            printf("%s: error decoding %s.%s payload: %s\n", __FUNCTION__, header->namespace, header->name,
+                    PB_GET_ERROR(&stream));
+            result = DIRECTIVE_ROUTER_DECODE_ERROR;
+        }
+    }
+    if (result == DIRECTIVE_ROUTER_HANDLED && !route->handler(route->context, header, route->payload)) {
+        result = DIRECTIVE_ROUTER_HANDLER_ERROR;
+    }
+    // Whatever the decode allocated is released at once, ready for the next directive.
+    if (route->arena) {
+        directive_arena_reset(route->arena);
+    }
+    return result;
+}
@@ -0,0 +1,98 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_ROUTER_H
+#define ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pb.h"
+#include "directiveHeader.pb.h"
+#include "directive_arena.h"
+#include "directive_ids.h"
+#include "directive_strings.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of slots of a directive_router_t for custom directives. A power of two, larger than the number of
+// registered custom directives.
+#define DIRECTIVE_ROUTER_SLOTS (16U)
+
+// Location of the still encoded payload of a directive in the buffer it was received in.
+typedef struct {
+    size_t offset;
+    size_t size;
+} directive_slice_t;
+
+// Called with the header and the decoded payload of a routed directive. Returns false if the directive failed.
+typedef bool (*directive_route_handler_t)(void* context, header_DirectiveHeaderProto const* header, void* payload);
+
+// Called before the payload of a routed directive is decoded, e.g. to bind its callback fields. The payload is decoded
+// from the stream of source, so string views bound to source point into the received buffer.
+typedef void (*directive_route_prepare_t)(void* context, void* payload, directive_string_source_t const* source);
+
+// How a directive is decoded and handled.
+typedef struct {
+    char const* namespace;
+    char const* name;
+    // Fields of the payload message, e.g. notifications_SetIndicatorDirectivePayloadProto_fields.
+    pb_field_t const* payload_fields;
+    // Storage the payload is decoded into, of the type described by payload_fields.
+    void* payload;
+    directive_route_handler_t handler;
+    void* context;
+    // Optional.
+    directive_route_prepare_t prepare;
+    // Optional arena the payload is decoded into, reset once the handler returns.
+    directive_arena_t* arena;
+} directive_route_t;
+
+// Routes of the directives. Directives defined under AlexaGadgetsProtobuf are indexed by their directive_id_t,
+// custom directives are in a hash table keyed on (namespace, name).
+typedef struct {
+    directive_route_t known[DIRECTIVE_ID_COUNT];
+    directive_route_t slots[DIRECTIVE_ROUTER_SLOTS];
+    size_t count;
+} directive_router_t;
+
+typedef enum {
+    DIRECTIVE_ROUTER_HANDLED = 0,
+    DIRECTIVE_ROUTER_DECODE_ERROR,
+    DIRECTIVE_ROUTER_UNKNOWN_DIRECTIVE,
+    DIRECTIVE_ROUTER_HANDLER_ERROR
+} directive_router_result_t;
+
+// Empties the router.
+void directive_router_init(directive_router_t* router);
+
+// Adds a route. The strings and the payload storage are not copied and must outlive the router.
+// Returns false if the router is full or the directive already has a route.
+bool directive_router_register(directive_router_t* router, directive_route_t const* route);
+
+// Returns the route of a directive, or NULL.
+directive_route_t const* directive_router_find(directive_router_t const* router, char const* namespace,
+        char const* name);
+
+// Decodes the header of an encoded directive, and locates its payload without decoding it.
+bool directive_peek(uint8_t const* buffer, size_t len, header_DirectiveHeaderProto* header,
+        directive_slice_t* payload);
+
+// Decodes the header of an encoded directive, then decodes the payload once with the type of its route and calls
+// the route handler. header receives the decoded header, so unknown directives can be reported by the caller.
+directive_router_result_t directive_router_dispatch(directive_router_t const* router, uint8_t const* buffer,
+        size_t len, header_DirectiveHeaderProto* header);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_ROUTER_H
@@ -0,0 +1,116 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <string.h>
+#include "pb.h"
+#include "pb_decode.h"
+#include "pb_encode.h"
+#include "directive_strings.h"
+
+// Read callback of directive_string_istream(). Every read, from the stream or from any of its substreams, goes
+// through the source.
+static bool read_source(pb_istream_t* stream, pb_byte_t* buf, size_t count)
+{
+    directive_string_source_t* source = stream->state;
+    if (count > source->bytes_left) {
+        return false;
+    }
+    if (buf) {
+        memcpy(buf, source->buffer + (source->len - source->bytes_left), count);
+        source->bytes_copied += count;
+    }
+    source->bytes_left -= count;
+    return true;
+}
+
+pb_istream_t directive_string_istream(directive_string_source_t* source, uint8_t const* buffer, size_t len)
+{
+    source->buffer = buffer;
+    source->len = len;
+    source->bytes_left = len;
+    source->bytes_copied = 0;
+    pb_istream_t stream = {read_source, source, len};
+    return stream;
+}
+
+// Records the location in source of the value that stream is positioned on, and skips it.
+static bool view_string(pb_istream_t* stream, directive_string_source_t const* source, directive_string_t* view)
+{
+    if (!source) {
+        PB_RETURN_ERROR(stream, "string view without a source");
+    }
+    // pb_read() only skips without copying from its own buffer streams, it copies the bytes of any other stream
+    // through a small buffer. The value is skipped by the read callback of the source instead.
+    if (stream->callback != read_source) {
+        PB_RETURN_ERROR(stream, "string views need the stream of their source");
+    }
+    size_t offset = source->len - source->bytes_left;
+    size_t size = stream->bytes_left;
+    if (!read_source(stream, NULL, size)) {
+        PB_RETURN_ERROR(stream, "io error");
+    }
+    stream->bytes_left -= size;
+    // Skipping the value moves the source past it only if stream reads from the source.
+    if (source->len - source->bytes_left != offset + size) {
+        PB_RETURN_ERROR(stream, "string views need the stream of their source");
+    }
+    view->data = (char const*)source->buffer + offset;
+    view->size = size;
+    return true;
+}
+
+bool directive_string_decode(pb_istream_t* stream, pb_field_t const* field, void** arg)
+{
+    directive_string_t* view = *arg;
+    return view_string(stream, view->source, view);
+}
+
+bool directive_string_list_decode(pb_istream_t* stream, pb_field_t const* field, void** arg)
+{
+    directive_string_list_t* list = *arg;
+    if (list->count >= list->capacity) {
+        PB_RETURN_ERROR(stream, "too many strings");
+    }
+    if (!view_string(stream, list->source, &list->items[list->count])) {
+        return false;
+    }
+    list->count++;
+    return true;
+}
+
+void directive_string_bind(pb_callback_t* callback, directive_string_t* view, directive_string_source_t const* source)
+{
+    view->data = NULL;
+    view->size = 0;
+    view->source = source;
+    callback->funcs.decode = directive_string_decode;
+    callback->arg = view;
+}
+
+void directive_string_list_bind(pb_callback_t* callback, directive_string_list_t* list,
+        directive_string_source_t const* source)
+{
+    list->count = 0;
+    list->source = source;
+    callback->funcs.decode = directive_string_list_decode;
+    callback->arg = list;
+}
+
+bool directive_string_equals(directive_string_t view, char const* string)
+{
+    size_t size = strlen(string);
+    return view.size == size && (size == 0 || 0 == memcmp(view.data, string, size));
+}
+
+bool directive_string_encode(pb_ostream_t* stream, pb_field_t const* field, void* const* arg)
+{
+    char const* string = *arg;
+    if (!string || !*string) {
+        return true;
+    }
+    return pb_encode_tag_for_field(stream, field) && pb_encode_string(stream, (pb_byte_t const*)string, strlen(string));
+}
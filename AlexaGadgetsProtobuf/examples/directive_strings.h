@@ -0,0 +1,83 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_STRINGS_H
+#define ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_STRINGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The buffer a message with string views is decoded from. The stream made by directive_string_istream() keeps
+// bytes_left up to date as the message is decoded, so the next byte to read is always at len - bytes_left, even from
+// the substreams nanopb makes for submessages and callback fields.
+typedef struct {
+    uint8_t const* buffer;
+    size_t len;
+    size_t bytes_left;
+    // Bytes copied out of the buffer by the decode, i.e. all but the values of the string views.
+    size_t bytes_copied;
+} directive_string_source_t;
+
+// A string or bytes field left in the buffer the message was decoded from. It is not NUL terminated, print it with
+// "%.*s", (int)view.size, view.data. It is valid as long as the buffer is. data is NULL if the field was not present.
+typedef struct {
+    char const* data;
+    size_t size;
+    // The buffer the view points into.
+    directive_string_source_t const* source;
+} directive_string_t;
+
+// Views of the values of a repeated string field, in the storage given by the caller.
+typedef struct {
+    directive_string_t* items;
+    size_t capacity;
+    size_t count;
+    // The buffer the views point into.
+    directive_string_source_t const* source;
+} directive_string_list_t;
+
+// Makes a stream that decodes the len bytes of buffer, and sets source to that buffer.
+// Decode the messages with string views from it.
+pb_istream_t directive_string_istream(directive_string_source_t* source, uint8_t const* buffer, size_t len);
+
+// Decode callback of a string or bytes field declared with type:FT_CALLBACK in the .options of its message.
+// Instead of copying the value, it records where the value is in the buffer into the directive_string_t *arg.
+// The message must be decoded from the stream of the view's source, see directive_string_istream().
+bool directive_string_decode(pb_istream_t* stream, pb_field_t const* field, void** arg);
+
+// Decode callback of a repeated string field declared with type:FT_CALLBACK, appending to the
+// directive_string_list_t *arg. Fails if there are more values than the list can hold.
+bool directive_string_list_decode(pb_istream_t* stream, pb_field_t const* field, void** arg);
+
+// Binds a callback field to a view into the buffer of source. The view is emptied, and is set when the field is
+// decoded.
+void directive_string_bind(pb_callback_t* callback, directive_string_t* view, directive_string_source_t const* source);
+
+// Binds a repeated callback field to a list of views into the buffer of source. The list is emptied.
+void directive_string_list_bind(pb_callback_t* callback, directive_string_list_t* list,
+        directive_string_source_t const* source);
+
+// Returns true if the view holds the NUL terminated string.
+bool directive_string_equals(directive_string_t view, char const* string);
+
+// Encode callback of a string field declared with type:FT_CALLBACK, encoding the NUL terminated char const* arg.
+// An empty or NULL string is left out, as proto3 does for a static field.
+bool directive_string_encode(pb_ostream_t* stream, pb_field_t const* field, void* const* arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_STRINGS_H
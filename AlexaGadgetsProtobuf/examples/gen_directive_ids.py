@@ -0,0 +1,196 @@
+#
+# Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+# These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+# The Agreement is available at https://aws.amazon.com/asl/.
+# See the Agreement for the specific terms and conditions of the Agreement.
+# Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+#
+"""Generates directive_ids.h and directive_ids.c from the directive .proto files.
+
+Each directive lives in AlexaGadgetsProtobuf/<namespace>/<name>/<...>Directive.proto. The generated code has an enum
+with one id per (namespace, name) pair, and directive_id_lookup(), which maps a decoded header to its id with a
+perfect hash: one hash pass over the strings and a single comparison with the only candidate.
+
+Usage: gen_directive_ids.py <AlexaGadgetsProtobuf folder> <output folder>
+"""
+
+import os
+import re
+import sys
+
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+SEPARATOR = 0xFF
+
+
+def find_directives(proto_root):
+    directives = set()
+    for folder, _, files in os.walk(proto_root):
+        if any(f.endswith('Directive.proto') for f in files):
+            namespace_folder, name = os.path.split(os.path.relpath(folder, proto_root))
+            directives.add((os.path.basename(namespace_folder), name))
+    return sorted(directives)
+
+
+def fnv1a(seed, namespace, name):
+    value = FNV_OFFSET_BASIS ^ seed
+    for byte in namespace.encode() + bytes([SEPARATOR]) + name.encode():
+        value = ((value ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def slot_of(seed, directive, slot_bits):
+    # The low bits of an FNV hash only depend on the low bits of the input, so the slot is taken from the high bits.
+    return fnv1a(seed, *directive) >> (32 - slot_bits)
+
+
+def find_seed(directives, slot_bits):
+    for seed in range(1 << 20):
+        slots = {slot_of(seed, directive, slot_bits) for directive in directives}
+        if len(slots) == len(directives):
+            return seed
+    raise RuntimeError('no perfect hash seed for %d directives in %d slots' % (len(directives), 1 << slot_bits))
+
+
+def enum_name(namespace, name):
+    words = re.sub(r'([a-z0-9])([A-Z])', r'\1_\2', namespace + '_' + name)
+    return 'DIRECTIVE_ID_' + re.sub(r'[^A-Za-z0-9]+', '_', words).upper()
+
+
+HEADER = '''//
+// Generated by gen_directive_ids.py from the directive .proto files. Do not edit.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_IDS_H
+#define ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_IDS_H
+
+#ifdef __cplusplus
+extern "C" {{
+#endif
+
+// The directives defined under AlexaGadgetsProtobuf. Custom directives map to DIRECTIVE_ID_UNKNOWN.
+typedef enum {{
+    DIRECTIVE_ID_UNKNOWN = 0,
+{enumerators}
+    DIRECTIVE_ID_COUNT
+}} directive_id_t;
+
+// Returns the id of a directive from the namespace and name of its header, or DIRECTIVE_ID_UNKNOWN.
+directive_id_t directive_id_lookup(char const* namespace, char const* name);
+
+// Returns the namespace of a directive id, or NULL for DIRECTIVE_ID_UNKNOWN.
+char const* directive_id_namespace(directive_id_t id);
+
+// Returns the name of a directive id, or NULL for DIRECTIVE_ID_UNKNOWN.
+char const* directive_id_name(directive_id_t id);
+
+#ifdef __cplusplus
+}}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_IDS_H
+'''
+
+SOURCE = '''//
+// Generated by gen_directive_ids.py from the directive .proto files. Do not edit.
+//
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "directive_ids.h"
+
+#define DIRECTIVE_ID_HASH_SEED ({seed}U)
+#define DIRECTIVE_ID_SLOT_BITS ({slot_bits}U)
+#define DIRECTIVE_ID_SLOTS (1U << DIRECTIVE_ID_SLOT_BITS)
+
+typedef struct {{
+    char const* namespace;
+    size_t namespace_len;
+    char const* name;
+    size_t name_len;
+}} directive_key_t;
+
+static directive_key_t const directive_keys[DIRECTIVE_ID_COUNT] = {{
+    [DIRECTIVE_ID_UNKNOWN] = {{NULL, 0, NULL, 0}},
+{keys}
+}};
+
+// Perfect hash of the known directives: each slot holds the only directive that can hash to it.
+static uint8_t const directive_slots[DIRECTIVE_ID_SLOTS] = {{
+{slots}
+}};
+
+directive_id_t directive_id_lookup(char const* namespace, char const* name)
+{{
+    // FNV-1a over the namespace, a separator and the name, measuring the strings in the same pass.
+    uint32_t hash = {basis}U ^ DIRECTIVE_ID_HASH_SEED;
+    size_t namespace_len = 0;
+    for (; namespace[namespace_len]; namespace_len++) {{
+        hash = (hash ^ (uint8_t)namespace[namespace_len]) * {prime}U;
+    }}
+    hash = (hash ^ {separator:#04x}U) * {prime}U;
+    size_t name_len = 0;
+    for (; name[name_len]; name_len++) {{
+        hash = (hash ^ (uint8_t)name[name_len]) * {prime}U;
+    }}
+
+    // Unknown directives can hash to any slot, so confirm the only candidate.
+    directive_id_t id = (directive_id_t)directive_slots[hash >> (32U - DIRECTIVE_ID_SLOT_BITS)];
+    directive_key_t const* key = &directive_keys[id];
+    if (id == DIRECTIVE_ID_UNKNOWN || key->namespace_len != namespace_len || key->name_len != name_len
+            || memcmp(key->namespace, namespace, namespace_len) != 0 || memcmp(key->name, name, name_len) != 0) {{
+        return DIRECTIVE_ID_UNKNOWN;
+    }}
+    return id;
+}}
+
+char const* directive_id_namespace(directive_id_t id)
+{{
+    return id < DIRECTIVE_ID_COUNT ? directive_keys[id].namespace : NULL;
+}}
+
+char const* directive_id_name(directive_id_t id)
+{{
+    return id < DIRECTIVE_ID_COUNT ? directive_keys[id].name : NULL;
+}}
+'''
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write(__doc__)
+        return 1
+    proto_root, output_folder = argv[1], argv[2]
+    directives = find_directives(proto_root)
+    if not directives or len(directives) > 255:
+        sys.stderr.write('%d directives found under %s\n' % (len(directives), proto_root))
+        return 1
+
+    # Twice as many slots as directives keeps the seed search short.
+    slot_bits = 1
+    while (1 << slot_bits) < 2 * len(directives):
+        slot_bits += 1
+    seed = find_seed(directives, slot_bits)
+
+    slots = [0] * (1 << slot_bits)
+    for index, directive in enumerate(directives, start=1):
+        slots[slot_of(seed, directive, slot_bits)] = index
+
+    enumerators = '\n'.join('    %s,' % enum_name(*directive) for directive in directives)
+    keys = '\n'.join('    [%s] = {"%s", %d, "%s", %d},' % (enum_name(namespace, name), namespace, len(namespace), name,
+                                                          len(name))
+                     for namespace, name in directives)
+    slot_names = ['DIRECTIVE_ID_UNKNOWN'] + [enum_name(*directive) for directive in directives]
+    slot_lines = '\n'.join('    %s,' % slot_names[slot] for slot in slots)
+
+    with open(os.path.join(output_folder, 'directive_ids.h'), 'w') as header:
+        header.write(HEADER.format(enumerators=enumerators))
+    with open(os.path.join(output_folder, 'directive_ids.c'), 'w') as source:
+        source.write(SOURCE.format(seed=seed, slot_bits=slot_bits, keys=keys, slots=slot_lines,
+                                   basis=FNV_OFFSET_BASIS, prime=FNV_PRIME, separator=SEPARATOR))
+    print('%d directives, perfect hash seed %d over %d slots' % (len(directives), seed, len(slots)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
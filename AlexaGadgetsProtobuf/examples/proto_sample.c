@@ -6,73 +6,399 @@
 // Capitalized terms not defined in this file have the meanings given to them in the Agreement.
 //
 #include<stdio.h>
+#include<stdlib.h>
+#include<time.h>
 #include "pb.h"
 #include "pb_decode.h"
 #include "pb_encode.h"
 #include "directiveParser.pb.h"
+#include "alert_store.h"
+#include "beat_clock.h"
+#include "directive_arena.h"
+#include "directive_router.h"
+#include "directive_strings.h"
+#include "speechmarks_scheduler.h"
+#include "state_table.h"
 #include "eventParser.pb.h"
 #include "notificationsSetIndicatorDirective.pb.h"
+#include "alertsSetAlertDirective.pb.h"
+#include "alertsDeleteAlertDirective.pb.h"
 #include "alexaDiscoveryDiscoverResponseEvent.pb.h"
 #include "alexaDiscoveryDiscoverDirective.pb.h"
 #include "alexaGadgetStateListenerStateUpdateDirective.pb.h"
 #include "alexaGadgetSpeechDataSpeechmarksDirective.pb.h"
+#include "alexaGadgetMusicDataTempoDirective.pb.h"
 
 typedef unsigned char uint8_t;
 typedef unsigned char BOOL;
 
+static void print_directive_header(header_DirectiveHeaderProto const* header)
+{
+    printf("name = %s, namespace=%s\n", header->name, header->namespace);
+}
+
+// SetIndicator payload. The asset strings are FT_CALLBACK fields, viewed in the received buffer instead of copied.
+typedef struct {
+    notifications_SetIndicatorDirectivePayloadProto proto;
+    directive_string_t asset_id;
+    directive_string_t url;
+} set_indicator_t;
+
+static void prepare_set_indicator(void* context, void* payload, directive_string_source_t const* source)
+{
+    set_indicator_t* set_indicator = context;
+    directive_string_bind(&set_indicator->proto.asset.assetId, &set_indicator->asset_id, source);
+    directive_string_bind(&set_indicator->proto.asset.url, &set_indicator->url, source);
+}
+
+static bool print_set_indicator(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    set_indicator_t const* set_indicator = context;
+    print_directive_header(header);
+    printf("visualIndicator:%d, audioIndicator=%d, assetId=%.*s, url=%.*s\n",
+            set_indicator->proto.persistVisualIndicator,
+            set_indicator->proto.playAudioIndicator,
+            (int)set_indicator->asset_id.size, set_indicator->asset_id.data,
+            (int)set_indicator->url.size, set_indicator->url.data);
+    return true;
+}
+
+#define SAMPLE_MAX_ALERT_ASSETS (4)
+
+typedef struct {
+    directive_string_t asset_id;
+    directive_string_t url;
+} alert_asset_t;
+
+// SetAlert payload. All its strings are FT_CALLBACK fields, viewed in the received buffer instead of copied.
+typedef struct {
+    alerts_SetAlertDirectivePayloadProto proto;
+    directive_string_t token;
+    directive_string_t type;
+    directive_string_t scheduled_time;
+    directive_string_t background_alert_asset;
+    directive_string_t asset_play_order_items[SAMPLE_MAX_ALERT_ASSETS];
+    directive_string_list_t asset_play_order;
+    alert_asset_t assets[SAMPLE_MAX_ALERT_ASSETS];
+    size_t assets_count;
+    // The buffer the payload is decoded from, for the views of the assets.
+    directive_string_source_t const* source;
+} set_alert_t;
+
+// Decodes one entry of the repeated assets field into the views of the next alert_asset_t.
+static bool decode_alert_asset(pb_istream_t* stream, pb_field_t const* field, void** arg)
+{
+    set_alert_t* set_alert = *arg;
+    if (set_alert->assets_count >= SAMPLE_MAX_ALERT_ASSETS) {
+        PB_RETURN_ERROR(stream, "too many assets");
+    }
+    alert_asset_t* asset = &set_alert->assets[set_alert->assets_count];
+    alerts_SetAlertDirectivePayloadProto_Assets proto = alerts_SetAlertDirectivePayloadProto_Assets_init_default;
+    directive_string_bind(&proto.assetId, &asset->asset_id, set_alert->source);
+    directive_string_bind(&proto.url, &asset->url, set_alert->source);
+    if (!pb_decode(stream, alerts_SetAlertDirectivePayloadProto_Assets_fields, &proto)) {
+        return false;
+    }
+    set_alert->assets_count++;
+    return true;
+}
+
+static void prepare_set_alert(void* context, void* payload, directive_string_source_t const* source)
+{
+    set_alert_t* set_alert = context;
+    directive_string_bind(&set_alert->proto.token, &set_alert->token, source);
+    directive_string_bind(&set_alert->proto.type, &set_alert->type, source);
+    directive_string_bind(&set_alert->proto.scheduledTime, &set_alert->scheduled_time, source);
+    directive_string_bind(&set_alert->proto.backgroundAlertAsset, &set_alert->background_alert_asset, source);
+    set_alert->asset_play_order.items = set_alert->asset_play_order_items;
+    set_alert->asset_play_order.capacity = SAMPLE_MAX_ALERT_ASSETS;
+    directive_string_list_bind(&set_alert->proto.assetPlayOrder, &set_alert->asset_play_order, source);
+    set_alert->assets_count = 0;
+    set_alert->source = source;
+    set_alert->proto.assets.funcs.decode = decode_alert_asset;
+    set_alert->proto.assets.arg = set_alert;
+}
+
+// Length of the alert sound of the sample, i.e. of a loop of an alert.
+#define SAMPLE_ALERT_LOOP_DURATION_MS (2000)
+
+// Alerts set by SetAlert and deleted by DeleteAlert directives, played by run_sample_alerts().
+static alert_store_t alert_store;
+
+static bool print_set_alert(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    set_alert_t const* set_alert = context;
+    print_directive_header(header);
+    printf("token=%.*s, type=%.*s, scheduledTime=%.*s\n",
+            (int)set_alert->token.size, set_alert->token.data,
+            (int)set_alert->type.size, set_alert->type.data,
+            (int)set_alert->scheduled_time.size, set_alert->scheduled_time.data);
+    for (size_t i = 0; i < set_alert->assets_count; ++i) {
+        printf("asset: assetId=%.*s, url=%.*s\n",
+                (int)set_alert->assets[i].asset_id.size, set_alert->assets[i].asset_id.data,
+                (int)set_alert->assets[i].url.size, set_alert->assets[i].url.data);
+    }
+    for (size_t i = 0; i < set_alert->asset_play_order.count; ++i) {
+        printf("asset play order: %.*s\n",
+                (int)set_alert->asset_play_order.items[i].size, set_alert->asset_play_order.items[i].data);
+    }
+    printf("loopCount=%d, loopPauseInMilliSeconds=%d\n", set_alert->proto.loopCount,
+            set_alert->proto.loopPauseInMilliSeconds);
+
+    // The values of the views are skipped in the buffer, only the tags, lengths and numbers around them are copied.
+    size_t viewed = set_alert->token.size + set_alert->type.size + set_alert->scheduled_time.size
+            + set_alert->background_alert_asset.size;
+    for (size_t i = 0; i < set_alert->assets_count; ++i) {
+        viewed += set_alert->assets[i].asset_id.size + set_alert->assets[i].url.size;
+    }
+    for (size_t i = 0; i < set_alert->asset_play_order.count; ++i) {
+        viewed += set_alert->asset_play_order.items[i].size;
+    }
+    printf("payload: %zu bytes, %zu bytes of strings viewed in place, %zu bytes copied\n", set_alert->source->len,
+            viewed, set_alert->source->bytes_copied);
+
+    int64_t scheduled_ms;
+    if (!alert_time_parse(set_alert->scheduled_time.data, set_alert->scheduled_time.size, &scheduled_ms)) {
+        printf("Error: invalid scheduledTime\n");
+        return false;
+    }
+    alert_store_result_t result = alert_store_set(&alert_store, set_alert->token.data, set_alert->token.size,
+            alert_type_parse(set_alert->type.data, set_alert->type.size), scheduled_ms, set_alert->proto.loopCount,
+            set_alert->proto.loopPauseInMilliSeconds);
+    if (result != ALERT_STORE_OK) {
+        printf("Error: could not set alert (%s)\n", result == ALERT_STORE_FULL ? "store full" : "invalid token");
+        return false;
+    }
+    printf("alert set for %lldms since the epoch, %zu alerts\n", (long long)scheduled_ms, alert_store.count);
+    return true;
+}
+
+static bool print_delete_alert(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    alerts_DeleteAlertDirectivePayloadProto const* delete_alert = payload;
+    print_directive_header(header);
+    printf("token=%s\n", delete_alert->token);
+    if (!alert_store_delete(&alert_store, delete_alert->token, strlen(delete_alert->token))) {
+        printf("no alert with this token\n");
+    }
+    printf("%zu alerts\n", alert_store.count);
+    return true;
+}
+
+static bool print_discover(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    alexaDiscovery_DiscoverDirectivePayloadProto const* discover = payload;
+    print_directive_header(header);
+    printf("scope type: %s\n", discover->scope.type);
+    printf("scope token: %s\n", discover->scope.token);
+    return true;
+}
+
+// Memory of the repeated fields and strings of StateUpdate, Speechmarks and Tempo. They have no maximum count, the
+// entries of a directive are allocated from this arena and released once it is handled.
+#define SAMPLE_DIRECTIVE_ARENA_SIZE (1024)
+static uint8_t directive_arena_buffer[SAMPLE_DIRECTIVE_ARENA_SIZE];
+static directive_arena_t directive_arena;
+
+typedef alexaGadgetStateListener_StateUpdateDirectivePayloadProto_States state_proto_t;
+typedef alexaGadgetSpeechData_SpeechmarksDirectivePayloadProto_SpeechmarksData speechmark_proto_t;
+typedef alexaGadgetMusicData_TempoDirectivePayloadProto_TempoData tempo_proto_t;
+
+typedef struct {
+    alexaGadgetStateListener_StateUpdateDirectivePayloadProto proto;
+    directive_arena_list_t states;
+} state_update_t;
+
+static bool prepare_state(directive_arena_t* arena, void* item)
+{
+    state_proto_t* state = item;
+    return directive_arena_string_bind(arena, &state->name) && directive_arena_string_bind(arena, &state->value);
+}
+
+static void prepare_state_update(void* context, void* payload, directive_string_source_t const* source)
+{
+    state_update_t* state_update = context;
+    state_update->states.arena = &directive_arena;
+    state_update->states.fields = alexaGadgetStateListener_StateUpdateDirectivePayloadProto_States_fields;
+    state_update->states.item_size = sizeof(state_proto_t);
+    state_update->states.prepare = prepare_state;
+    directive_arena_list_bind(&state_update->proto.states, &state_update->states);
+}
+
+// Current StateListener states, read by run_sample_state_table().
+static state_table_t state_table;
+
+static void print_state_change(void* context, state_name_t name, bool active)
+{
+    static char const* const names[STATE_COUNT] = {"wakeword", "timers", "alarms", "reminders"};
+    printf("state %s is now %s\n", names[name], active ? "active" : "cleared");
+}
+
+static bool print_state_update(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    state_update_t const* state_update = context;
+    state_batch_t batch;
+    state_batch_init(&batch);
+    print_directive_header(header);
+    for (directive_arena_node_t const* node = state_update->states.head; node; node = node->next) {
+        state_proto_t const* state = (state_proto_t const*)node->item;
+        char const* name = directive_arena_string(&state->name);
+        char const* value = directive_arena_string(&state->value);
+        printf("state name: %s\n", name);
+        printf("state value: %s\n", value);
+        state_batch_add(&batch, name, strlen(name), value, strlen(value));
+    }
+    // Callbacks only run for the states that changed.
+    state_table_apply(&state_table, &batch);
+    return true;
+}
+
+typedef struct {
+    alexaGadgetSpeechData_SpeechmarksDirectivePayloadProto proto;
+    directive_arena_list_t speechmarks;
+} speechmarks_t;
+
+static bool prepare_speechmark(directive_arena_t* arena, void* item)
+{
+    speechmark_proto_t* speechmark = item;
+    return directive_arena_string_bind(arena, &speechmark->type)
+            && directive_arena_string_bind(arena, &speechmark->value);
+}
+
+static void prepare_speechmarks(void* context, void* payload, directive_string_source_t const* source)
+{
+    speechmarks_t* speechmarks = context;
+    speechmarks->speechmarks.arena = &directive_arena;
+    speechmarks->speechmarks.fields = alexaGadgetSpeechData_SpeechmarksDirectivePayloadProto_SpeechmarksData_fields;
+    speechmarks->speechmarks.item_size = sizeof(speechmark_proto_t);
+    speechmarks->speechmarks.prepare = prepare_speechmark;
+    directive_arena_list_bind(&speechmarks->proto.speechmarksData, &speechmarks->speechmarks);
+}
+
+// Microseconds of a monotonic clock.
+static uint64_t now_us()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000U + (uint64_t)now.tv_nsec / 1000U;
+}
+
+// Directives are decoded right after being encoded in this sample. On a gadget, use the measured delay from the Echo
+// device sending a directive to the gadget receiving it, about one BLE connection interval.
+#define SAMPLE_SPEECHMARKS_DELIVERY_DELAY_US (0)
+
+// Timeline of the speechmarks received, fired by run_sample_speechmarks_timeline().
+static speechmarks_scheduler_t speechmarks_scheduler;
+
+static bool print_speechmarks(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    speechmarks_t const* speechmarks = context;
+    uint64_t received_us = now_us();
+    print_directive_header(header);
+    printf("player offset: %d\n", speechmarks->proto.playerOffsetInMilliSeconds);
+    speechmarks_scheduler_anchor(&speechmarks_scheduler, received_us, speechmarks->proto.playerOffsetInMilliSeconds);
+    for (directive_arena_node_t const* node = speechmarks->speechmarks.head; node; node = node->next) {
+        speechmark_proto_t const* speechmark = (speechmark_proto_t const*)node->item;
+        printf("speechmark type: %s\n", directive_arena_string(&speechmark->type));
+        printf("speechmark value: %s\n", directive_arena_string(&speechmark->value));
+        printf("speechmark start offset: %d\n", speechmark->startOffsetInMilliSeconds);
+        // The scheduler copies the strings, the arena is reset once this handler returns.
+        speechmarks_scheduler_add(&speechmarks_scheduler, speechmark->startOffsetInMilliSeconds,
+                directive_arena_string(&speechmark->type), directive_arena_string(&speechmark->value));
+    }
+    return true;
+}
+
+typedef struct {
+    alexaGadgetMusicData_TempoDirectivePayloadProto proto;
+    directive_arena_list_t tempo;
+} tempo_t;
+
+static void prepare_tempo(void* context, void* payload, directive_string_source_t const* source)
+{
+    tempo_t* tempo = context;
+    tempo->tempo.arena = &directive_arena;
+    tempo->tempo.fields = alexaGadgetMusicData_TempoDirectivePayloadProto_TempoData_fields;
+    tempo->tempo.item_size = sizeof(tempo_proto_t);
+    tempo->tempo.prepare = NULL;
+    directive_arena_list_bind(&tempo->proto.tempoData, &tempo->tempo);
+}
+
+// See SAMPLE_SPEECHMARKS_DELIVERY_DELAY_US.
+#define SAMPLE_TEMPO_DELIVERY_DELAY_US (0)
+
+// Beat clock of the music played, queried by run_sample_beat_clock().
+static beat_clock_t beat_clock;
+
+static bool print_tempo(void* context, header_DirectiveHeaderProto const* header, void* payload)
+{
+    tempo_t const* tempo = context;
+    uint64_t received_us = now_us();
+    beat_clock_tempo_t changes[BEAT_CLOCK_MAX_TEMPO];
+    size_t change_count = 0;
+    print_directive_header(header);
+    printf("player offset: %d\n", tempo->proto.playerOffsetInMilliSeconds);
+    for (directive_arena_node_t const* node = tempo->tempo.head; node; node = node->next) {
+        tempo_proto_t const* tempo_data = (tempo_proto_t const*)node->item;
+        printf("tempo value: %d, start offset: %d\n", tempo_data->value, tempo_data->startOffsetInMilliSeconds);
+        if (change_count < BEAT_CLOCK_MAX_TEMPO) {
+            changes[change_count].start_offset_ms = tempo_data->startOffsetInMilliSeconds;
+            changes[change_count].bpm = tempo_data->value;
+            change_count++;
+        }
+    }
+    printf("%zu tempo entries, arena peak %zu bytes\n", tempo->tempo.count, directive_arena.peak);
+    beat_clock_update(&beat_clock, received_us, tempo->proto.playerOffsetInMilliSeconds, changes, change_count);
+    return true;
+}
+
+// Routes the directives that this sample can decode to the functions printing them out.
+static directive_router_t directive_router;
+
+static void register_sample_directive_routes()
+{
+    static set_indicator_t set_indicator;
+    static set_alert_t set_alert;
+    static alerts_DeleteAlertDirectivePayloadProto delete_alert;
+    static alexaDiscovery_DiscoverDirectivePayloadProto discover;
+    static state_update_t state_update;
+    static speechmarks_t speechmarks;
+    static tempo_t tempo;
+    directive_route_t const routes[] = {
+        {"Notifications", "SetIndicator", notifications_SetIndicatorDirectivePayloadProto_fields,
+                &set_indicator.proto, print_set_indicator, &set_indicator, prepare_set_indicator},
+        {"Alerts", "SetAlert", alerts_SetAlertDirectivePayloadProto_fields, &set_alert.proto, print_set_alert,
+                &set_alert, prepare_set_alert},
+        {"Alerts", "DeleteAlert", alerts_DeleteAlertDirectivePayloadProto_fields, &delete_alert, print_delete_alert,
+                NULL},
+        {"Alexa.Discovery", "Discover", alexaDiscovery_DiscoverDirectivePayloadProto_fields, &discover,
+                print_discover, NULL},
+        {"Alexa.Gadget.StateListener", "StateUpdate", alexaGadgetStateListener_StateUpdateDirectivePayloadProto_fields,
+                &state_update.proto, print_state_update, &state_update, prepare_state_update, &directive_arena},
+        {"Alexa.Gadget.SpeechData", "Speechmarks", alexaGadgetSpeechData_SpeechmarksDirectivePayloadProto_fields,
+                &speechmarks.proto, print_speechmarks, &speechmarks, prepare_speechmarks, &directive_arena},
+        {"Alexa.Gadget.MusicData", "Tempo", alexaGadgetMusicData_TempoDirectivePayloadProto_fields, &tempo.proto,
+                print_tempo, &tempo, prepare_tempo, &directive_arena},
+    };
+
+    directive_arena_init(&directive_arena, directive_arena_buffer, sizeof(directive_arena_buffer));
+    directive_router_init(&directive_router);
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); ++i) {
+        directive_router_register(&directive_router, &routes[i]);
+    }
+}
+
 // Decode proto buf encoded directive binary and print out the content.
+// Only the header is decoded to find the directive, then the payload is decoded once with the type of the directive.
 void decode_directive(uint8_t* buffer, int len)
 {
     printf("\nParsing Directive:\n");
-    pb_istream_t stream = pb_istream_from_buffer(buffer, len);
-    directive_DirectiveParserProto envelope = directive_DirectiveParserProto_init_default;
-
-    pb_decode(&stream, directive_DirectiveParserProto_fields, &envelope);
-
-    printf("name = %s, namespace=%s\n", envelope.directive.header.name, envelope.directive.header.namespace);
-
-    if (0 == strcmp(envelope.directive.header.name, "SetIndicator")
-            && (0 == strcmp(envelope.directive.header.namespace, "Notifications"))) {
-        // Parse the notification payload now
-        pb_istream_t stream_notification = pb_istream_from_buffer(buffer, len);
-        notifications_SetIndicatorDirectiveProto notifications_envelope = notifications_SetIndicatorDirectiveProto_init_default;
-        pb_decode(&stream_notification, notifications_SetIndicatorDirectiveProto_fields, &notifications_envelope);
-
-        printf("visualIndicator:%d, audioIndicator=%d, assetId=%s, url=%s\n",
-        notifications_envelope.directive.payload.persistVisualIndicator,
-        notifications_envelope.directive.payload.playAudioIndicator,
-        notifications_envelope.directive.payload.asset.assetId,
-        notifications_envelope.directive.payload.asset.url);
-    } else if (0 == strcmp(envelope.directive.header.name, "Discover")
-            && (0 == strcmp(envelope.directive.header.namespace, "Alexa.Discovery"))) {
-        pb_istream_t stream = pb_istream_from_buffer(buffer, len);
-        alexaDiscovery_DiscoverDirectiveProto envelope = alexaDiscovery_DiscoverDirectiveProto_init_default;
-        pb_decode(&stream, alexaDiscovery_DiscoverDirectiveProto_fields, &envelope);
-        printf("scope type: %s\n", envelope.directive.payload.scope.type);
-        printf("scope token: %s\n", envelope.directive.payload.scope.token);
-    } else if (0 == strcmp(envelope.directive.header.name, "StateUpdate")
-            && (0 == strcmp(envelope.directive.header.namespace, "Alexa.Gadget.StateListener"))) {
-        pb_istream_t stream = pb_istream_from_buffer(buffer, len);
-        alexaGadgetStateListener_StateUpdateDirectiveProto envelope = alexaGadgetStateListener_StateUpdateDirectiveProto_init_default;
-        pb_decode(&stream, alexaGadgetStateListener_StateUpdateDirectiveProto_fields, &envelope);
-        int states_count = envelope.directive.payload.states_count;
-        for (int i = 0; i < states_count; ++i) {
-            printf("state name: %s\n", envelope.directive.payload.states[i].name);
-            printf("state value: %s\n", envelope.directive.payload.states[i].value);
-        }
-    } else if (0 == strcmp(envelope.directive.header.name, "Speechmarks")
-            && (0 == strcmp(envelope.directive.header.namespace, "Alexa.Gadget.SpeechData"))) {
-        pb_istream_t stream = pb_istream_from_buffer(buffer, len);
-        alexaGadgetSpeechData_SpeechmarksDirectiveProto envelope = alexaGadgetSpeechData_SpeechmarksDirectiveProto_init_default;
-        pb_decode(&stream, alexaGadgetSpeechData_SpeechmarksDirectiveProto_fields, &envelope);
-        int speechmarks_count = envelope.directive.payload.speechmarksData_count;
-        printf("player offset: %d\n", envelope.directive.payload.playerOffsetInMilliSeconds);
-        for (int i = 0; i < speechmarks_count; ++i) {
-            printf("speechmark type: %s\n", envelope.directive.payload.speechmarksData[i].type);
-            printf("speechmark value: %s\n", envelope.directive.payload.speechmarksData[i].value);
-            printf("speechmark start offset: %d\n", envelope.directive.payload.speechmarksData[i].startOffsetInMilliSeconds);
-        }
-    } else {
+    header_DirectiveHeaderProto header;
+    directive_router_result_t result = directive_router_dispatch(&directive_router, buffer, len, &header);
+    if (result == DIRECTIVE_ROUTER_DECODE_ERROR) {
+        printf("Error: could not decode directive\n");
+    } else if (result == DIRECTIVE_ROUTER_UNKNOWN_DIRECTIVE) {
+        print_directive_header(&header);
         printf("Error: do not have parsing code for this directive, check directive name\n");
     }
 }
@@ -163,8 +489,10 @@ void encode_set_indicator_directive(BOOL audio, BOOL visual, char* assetId, char
 
     notifications_envelope.directive.payload.persistVisualIndicator = visual;
     notifications_envelope.directive.payload.playAudioIndicator = audio;
-    strcpy(notifications_envelope.directive.payload.asset.assetId, assetId);
-    strcpy(notifications_envelope.directive.payload.asset.url, url);
+    notifications_envelope.directive.payload.asset.assetId.funcs.encode = directive_string_encode;
+    notifications_envelope.directive.payload.asset.assetId.arg = assetId;
+    notifications_envelope.directive.payload.asset.url.funcs.encode = directive_string_encode;
+    notifications_envelope.directive.payload.asset.url.arg = url;
 
     BOOL status = pb_encode(&stream, notifications_SetIndicatorDirectiveProto_fields, &notifications_envelope);
     if (!status)
@@ -226,8 +554,6 @@ void encode_sample_discover_response_event()
     }
     */
     printf("\nCreating discover response event:\n");
-    uint8_t buffer[256];
-    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
     alexaDiscovery_DiscoverResponseEventProto discover_response_envelope =
            alexaDiscovery_DiscoverResponseEventProto_init_default;
 
@@ -254,21 +580,144 @@ void encode_sample_discover_response_event()
     strcpy(discover_response_envelope.event.payload.endpoints[0].additionalIdentification.modelName, "mock model name");
     strcpy(discover_response_envelope.event.payload.endpoints[0].additionalIdentification.radioAddress, "1234567890");
 
+    // The encoded size grows with the number of capabilities (up to 32 with the shipped .options), so size the
+    // message first and encode it into a buffer of exactly that size.
+    size_t encoded_size;
+    if (!pb_get_encoded_size(&encoded_size, alexaDiscovery_DiscoverResponseEventProto_fields, &discover_response_envelope))
+    {
+      printf("%s: Error sizing message\n", __FUNCTION__);
+      return;
+    }
+    uint8_t* buffer = malloc(encoded_size);
+    if (!buffer)
+    {
+      printf("%s: Error allocating %zu bytes\n", __FUNCTION__, encoded_size);
+      return;
+    }
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, encoded_size);
+
     BOOL status = pb_encode(&stream, alexaDiscovery_DiscoverResponseEventProto_fields, &discover_response_envelope);
     if (!status)
     {
       printf("%s: Error encoding message\n", __FUNCTION__);
+      free(buffer);
       return;
     }
 
     printf("bytes written:%zu\n", stream.bytes_written);
-    uint8_t index;
+    size_t index;
     for(index = 0; index < stream.bytes_written; index++)
     {
         printf("0x%02x ", buffer[index]);
     }
     printf("\n");
     decode_event(buffer, stream.bytes_written);
+    free(buffer);
+}
+
+// Bytes of stack painted, more than the fixed array Discover.Response uses.
+#define SAMPLE_STACK_PAINT_SIZE (32 * 1024)
+// Bytes left unpainted right below the bound, for the frames of paint_stack() and measure_stack() themselves.
+#define SAMPLE_STACK_PAINT_GAP (256)
+#define SAMPLE_STACK_PAINT_PATTERN (0xA5)
+
+// Fills the area of the stack that ends SAMPLE_STACK_PAINT_GAP bytes below bound with a pattern. Stacks grow
+// downwards, so the area is below the frame that bound belongs to. It is addressed from an integer, so that the
+// compiler makes no assumption about what it holds.
+static __attribute__((noinline)) void paint_stack(uintptr_t bound)
+{
+    uint8_t volatile* area = (uint8_t volatile*)(bound - SAMPLE_STACK_PAINT_GAP - SAMPLE_STACK_PAINT_SIZE);
+    for (size_t i = 0; i < SAMPLE_STACK_PAINT_SIZE; ++i) {
+        area[i] = SAMPLE_STACK_PAINT_PATTERN;
+    }
+}
+
+// Returns how many bytes below bound have been used since paint_stack(bound), down to the lowest painted byte that
+// does not hold the pattern anymore.
+static __attribute__((noinline)) size_t measure_stack(uintptr_t bound)
+{
+    uint8_t const volatile* area = (uint8_t const volatile*)(bound - SAMPLE_STACK_PAINT_GAP - SAMPLE_STACK_PAINT_SIZE);
+    size_t i = 0;
+    while (i < SAMPLE_STACK_PAINT_SIZE && area[i] == SAMPLE_STACK_PAINT_PATTERN) {
+        ++i;
+    }
+    return SAMPLE_STACK_PAINT_GAP + SAMPLE_STACK_PAINT_SIZE - i;
+}
+
+// Calls function and returns the stack high-water mark of the call. The painted area is bounded by the frame of this
+// function, which stays live until the area is measured.
+static __attribute__((noinline)) size_t measure_stack_high_water(void (*function)(void*), void* argument)
+{
+    uintptr_t bound = (uintptr_t)__builtin_frame_address(0);
+    paint_stack(bound);
+    function(argument);
+    return measure_stack(bound);
+}
+
+typedef alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints endpoint_proto_t;
+typedef alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities capability_proto_t;
+typedef alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities_Configuration configuration_proto_t;
+
+typedef struct {
+    size_t encoded_size;
+    bool encoded;
+} discover_response_encoding_t;
+
+// Fills and encodes the largest Discover.Response the shipped .options hold, the same endpoint as
+// runSampleDiscoveryFootprint() in ConnectionHelpers/BLE/Handshake. The event is a local, as on a gadget that builds
+// it when the Discover directive arrives.
+static void encode_largest_discover_response(void* argument)
+{
+    discover_response_encoding_t* encoding = argument;
+    alexaDiscovery_DiscoverResponseEventProto envelope = alexaDiscovery_DiscoverResponseEventProto_init_default;
+    strcpy(envelope.event.header.namespace, "Alexa.Discovery");
+    strcpy(envelope.event.header.name, "Discover.Response");
+    envelope.event.payload.endpoints_count = 1;
+    endpoint_proto_t* endpoint = &envelope.event.payload.endpoints[0];
+    strcpy(endpoint->endpointId, "test id");
+    strcpy(endpoint->friendlyName, "friendly name");
+    strcpy(endpoint->additionalIdentification.deviceToken, "xxxxxxxxx");
+    endpoint->capabilities_count = pb_arraysize(endpoint_proto_t, capabilities);
+    for (size_t i = 0; i < endpoint->capabilities_count; ++i) {
+        capability_proto_t* capability = &endpoint->capabilities[i];
+        strcpy(capability->type, "AlexaInterface");
+        strcpy(capability->interface, "Alexa.Gadget.StateListener");
+        strcpy(capability->version, "1.0");
+        capability->configuration.supportedTypes_count = pb_arraysize(configuration_proto_t, supportedTypes);
+        for (size_t j = 0; j < capability->configuration.supportedTypes_count; ++j) {
+            snprintf(capability->configuration.supportedTypes[j].name,
+                    sizeof(capability->configuration.supportedTypes[j].name), "type %zu", j);
+        }
+    }
+
+    encoding->encoded = false;
+    if (!pb_get_encoded_size(&encoding->encoded_size, alexaDiscovery_DiscoverResponseEventProto_fields, &envelope)) {
+        return;
+    }
+    uint8_t* buffer = malloc(encoding->encoded_size);
+    if (!buffer) {
+        return;
+    }
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, encoding->encoded_size);
+    encoding->encoded = pb_encode(&stream, alexaDiscovery_DiscoverResponseEventProto_fields, &envelope);
+    free(buffer);
+}
+
+// Prints the struct size and the stack high-water mark of the largest Discover.Response, generated from the shipped
+// .options. ConnectionHelpers/BLE/Handshake prints the same figures for its FT_CALLBACK .options.
+void run_sample_discover_response_footprint()
+{
+    discover_response_encoding_t encoding;
+    size_t stack_used = measure_stack_high_water(encode_largest_discover_response, &encoding);
+    if (!encoding.encoded) {
+        printf("%s: Error encoding message\n", __FUNCTION__);
+        return;
+    }
+    printf("%u capabilities of %u supported types, %zu bytes encoded\n",
+            (unsigned)pb_arraysize(endpoint_proto_t, capabilities),
+            (unsigned)pb_arraysize(configuration_proto_t, supportedTypes), encoding.encoded_size);
+    printf("event struct: %zu bytes, stack high-water: %zu bytes, event struct included\n",
+            sizeof(alexaDiscovery_DiscoverResponseEventProto), stack_used);
 }
 
 void encode_sample_discover_directive()
@@ -317,6 +766,148 @@ void encode_sample_discover_directive()
     decode_directive(buffer, stream.bytes_written);
 }
 
+// Encodes the assets of the sample SetAlert directive. arg is a NULL terminated array of {assetId, url} pairs.
+static bool encode_alert_assets(pb_ostream_t* stream, pb_field_t const* field, void* const* arg)
+{
+    for (char const* const* asset = *arg; asset[0]; asset += 2) {
+        alerts_SetAlertDirectivePayloadProto_Assets proto = alerts_SetAlertDirectivePayloadProto_Assets_init_default;
+        proto.assetId.funcs.encode = directive_string_encode;
+        proto.assetId.arg = (void*)asset[0];
+        proto.url.funcs.encode = directive_string_encode;
+        proto.url.arg = (void*)asset[1];
+        if (!pb_encode_tag_for_field(stream, field)
+                || !pb_encode_submessage(stream, alerts_SetAlertDirectivePayloadProto_Assets_fields, &proto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void encode_sample_set_alert_directive()
+{
+    /*
+    {
+        "directive": {
+            "header": {
+                "namespace": "Alerts",
+                "name": "SetAlert",
+                "messageId": ""
+            },
+            "payload": {
+                "token": "alertToken1",
+                "type": "TIMER",
+                "scheduledTime": "2019-12-03T10:15:30+0000",
+                "assets": [{
+                    "assetId": "alarmSound",
+                    "url": "https://example.com/alarm.mp3"
+                }],
+                "assetPlayOrder": ["alarmSound"],
+                "loopCount": 2,
+                "loopPauseInMilliSeconds": 500
+            }
+        }
+    }
+    */
+
+    printf("\nCreating set alert directive:\n");
+    uint8_t buffer[256];
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+    alerts_SetAlertDirectiveProto envelope = alerts_SetAlertDirectiveProto_init_default;
+    static char const* const assets[] = {"alarmSound", "https://example.com/alarm.mp3", NULL};
+
+    strcpy(envelope.directive.header.namespace, "Alerts");
+    strcpy(envelope.directive.header.name, "SetAlert");
+    envelope.directive.payload.token.funcs.encode = directive_string_encode;
+    envelope.directive.payload.token.arg = (void*)"alertToken1";
+    envelope.directive.payload.type.funcs.encode = directive_string_encode;
+    envelope.directive.payload.type.arg = (void*)"TIMER";
+    envelope.directive.payload.scheduledTime.funcs.encode = directive_string_encode;
+    envelope.directive.payload.scheduledTime.arg = (void*)"2019-12-03T10:15:30+0000";
+    envelope.directive.payload.assets.funcs.encode = encode_alert_assets;
+    envelope.directive.payload.assets.arg = (void*)assets;
+    envelope.directive.payload.assetPlayOrder.funcs.encode = directive_string_encode;
+    envelope.directive.payload.assetPlayOrder.arg = (void*)"alarmSound";
+    envelope.directive.payload.loopCount = 2;
+    envelope.directive.payload.loopPauseInMilliSeconds = 500;
+
+    BOOL status = pb_encode(&stream, alerts_SetAlertDirectiveProto_fields, &envelope);
+    if (!status)
+    {
+      printf("%s: Error encoding message\n", __FUNCTION__);
+      return;
+    }
+
+    printf("bytes written:%zu\n", stream.bytes_written);
+    uint8_t index;
+    for(index = 0; index < stream.bytes_written; index++)
+    {
+        printf("0x%02x ", buffer[index]);
+    }
+    printf("\n");
+    decode_directive(buffer, stream.bytes_written);
+}
+
+void encode_sample_delete_alert_directive(char const* token)
+{
+    /*
+    {
+        "directive": {
+            "header": {
+                "namespace": "Alerts",
+                "name": "DeleteAlert",
+                "messageId": ""
+            },
+            "payload": {
+                "token": "alertToken1"
+            }
+        }
+    }
+    */
+
+    printf("\nCreating delete alert directive:\n");
+    uint8_t buffer[128];
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+    alerts_DeleteAlertDirectiveProto envelope = alerts_DeleteAlertDirectiveProto_init_default;
+
+    strcpy(envelope.directive.header.namespace, "Alerts");
+    strcpy(envelope.directive.header.name, "DeleteAlert");
+    strncpy(envelope.directive.payload.token, token, sizeof(envelope.directive.payload.token) - 1);
+
+    BOOL status = pb_encode(&stream, alerts_DeleteAlertDirectiveProto_fields, &envelope);
+    if (!status)
+    {
+      printf("%s: Error encoding message\n", __FUNCTION__);
+      return;
+    }
+
+    printf("bytes written:%zu\n", stream.bytes_written);
+    uint8_t index;
+    for(index = 0; index < stream.bytes_written; index++)
+    {
+        printf("0x%02x ", buffer[index]);
+    }
+    printf("\n");
+    decode_directive(buffer, stream.bytes_written);
+}
+
+// Encodes the states of the sample StateUpdate directive. arg is a NULL terminated array of {name, value} pairs.
+static bool encode_states(pb_ostream_t* stream, pb_field_t const* field, void* const* arg)
+{
+    for (char const* const* state = *arg; state[0]; state += 2) {
+        state_proto_t proto = alexaGadgetStateListener_StateUpdateDirectivePayloadProto_States_init_default;
+        proto.name.funcs.encode = directive_string_encode;
+        proto.name.arg = (void*)state[0];
+        proto.value.funcs.encode = directive_string_encode;
+        proto.value.arg = (void*)state[1];
+        if (!pb_encode_tag_for_field(stream, field)
+                || !pb_encode_submessage(stream,
+                        alexaGadgetStateListener_StateUpdateDirectivePayloadProto_States_fields, &proto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void encode_sample_state_update_directive()
 {
     /*
@@ -331,6 +922,9 @@ void encode_sample_state_update_directive()
                 "states": [{
                     "name": "timers",
                     "value": "active"
+                }, {
+                    "name": "alarms",
+                    "value": "cleared"
                 }]
             }
         }
@@ -344,9 +938,9 @@ void encode_sample_state_update_directive()
 
     strcpy(envelope.directive.header.namespace, "Alexa.Gadget.StateListener");
     strcpy(envelope.directive.header.name, "StateUpdate");
-    envelope.directive.payload.states_count = 1;
-    strcpy(envelope.directive.payload.states[0].name, "timers");
-    strcpy(envelope.directive.payload.states[0].value, "active");
+    static char const* const states[] = {"timers", "active", "alarms", "cleared", NULL};
+    envelope.directive.payload.states.funcs.encode = encode_states;
+    envelope.directive.payload.states.arg = (void*)states;
 
     // discover directive has empty payload right now
     BOOL status = pb_encode(&stream, alexaGadgetStateListener_StateUpdateDirectiveProto_fields, &envelope);
@@ -366,6 +960,31 @@ void encode_sample_state_update_directive()
     decode_directive(buffer, stream.bytes_written);
 }
 
+typedef struct {
+    char const* type;
+    char const* value;
+    int32_t start_offset;
+} sample_speechmark_t;
+
+// Encodes the speechmarks of the sample Speechmarks directive. arg is an array ended by an entry with a NULL type.
+static bool encode_speechmarks(pb_ostream_t* stream, pb_field_t const* field, void* const* arg)
+{
+    for (sample_speechmark_t const* speechmark = *arg; speechmark->type; ++speechmark) {
+        speechmark_proto_t proto = alexaGadgetSpeechData_SpeechmarksDirectivePayloadProto_SpeechmarksData_init_default;
+        proto.type.funcs.encode = directive_string_encode;
+        proto.type.arg = (void*)speechmark->type;
+        proto.value.funcs.encode = directive_string_encode;
+        proto.value.arg = (void*)speechmark->value;
+        proto.startOffsetInMilliSeconds = speechmark->start_offset;
+        if (!pb_encode_tag_for_field(stream, field)
+                || !pb_encode_submessage(stream,
+                        alexaGadgetSpeechData_SpeechmarksDirectivePayloadProto_SpeechmarksData_fields, &proto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void encode_sample_speechmarks_directive()
 {
     /*
@@ -382,6 +1001,14 @@ void encode_sample_speechmarks_directive()
                     "type": "viseme",
                     "value": "s",
                     "startOffsetInMilliSeconds": 130
+                }, {
+                    "type": "viseme",
+                    "value": "t",
+                    "startOffsetInMilliSeconds": 250
+                }, {
+                    "type": "viseme",
+                    "value": "a",
+                    "startOffsetInMilliSeconds": 310
                 }]
             }
         }
@@ -396,10 +1023,14 @@ void encode_sample_speechmarks_directive()
     strcpy(envelope.directive.header.namespace, "Alexa.Gadget.SpeechData");
     strcpy(envelope.directive.header.name, "Speechmarks");
     envelope.directive.payload.playerOffsetInMilliSeconds = 0;
-    envelope.directive.payload.speechmarksData_count = 1;
-    strcpy(envelope.directive.payload.speechmarksData[0].type, "viseme");
-    strcpy(envelope.directive.payload.speechmarksData[0].value, "s");
-    envelope.directive.payload.speechmarksData[0].startOffsetInMilliSeconds = 130;
+    static sample_speechmark_t const speechmarks[] = {
+        {"viseme", "s", 130},
+        {"viseme", "t", 250},
+        {"viseme", "a", 310},
+        {NULL, NULL, 0},
+    };
+    envelope.directive.payload.speechmarksData.funcs.encode = encode_speechmarks;
+    envelope.directive.payload.speechmarksData.arg = (void*)speechmarks;
 
     // discover directive has empty payload right now
     BOOL status = pb_encode(&stream, alexaGadgetSpeechData_SpeechmarksDirectiveProto_fields, &envelope);
@@ -419,10 +1050,295 @@ void encode_sample_speechmarks_directive()
     decode_directive(buffer, stream.bytes_written);
 }
 
+// Encodes the tempo entries of the sample Tempo directive: a beat every 500ms, i.e. 120 BPM.
+static bool encode_tempo_data(pb_ostream_t* stream, pb_field_t const* field, void* const* arg)
+{
+    int32_t const count = *(int32_t const*)*arg;
+    for (int32_t i = 0; i < count; ++i) {
+        tempo_proto_t proto = alexaGadgetMusicData_TempoDirectivePayloadProto_TempoData_init_default;
+        proto.value = 120;
+        proto.startOffsetInMilliSeconds = 500 * i;
+        if (!pb_encode_tag_for_field(stream, field)
+                || !pb_encode_submessage(stream, alexaGadgetMusicData_TempoDirectivePayloadProto_TempoData_fields,
+                        &proto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void encode_sample_tempo_directive()
+{
+    /*
+    {
+        "directive": {
+            "header": {
+                "namespace": "Alexa.Gadget.MusicData",
+                "name": "Tempo",
+                "messageId": ""
+            },
+            "payload": {
+                "playerOffsetInMilliSeconds": 0
+                "tempoData": [{
+                    "value": 120,
+                    "startOffsetInMilliSeconds": 0
+                }, {
+                    "value": 120,
+                    "startOffsetInMilliSeconds": 500
+                }, ...]
+            }
+        }
+    }
+    */
+
+    printf("\nCreating tempo directive:\n");
+    uint8_t buffer[256];
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+    alexaGadgetMusicData_TempoDirectiveProto envelope = alexaGadgetMusicData_TempoDirectiveProto_init_default;
+    static int32_t const tempo_count = 16;
+
+    strcpy(envelope.directive.header.namespace, "Alexa.Gadget.MusicData");
+    strcpy(envelope.directive.header.name, "Tempo");
+    envelope.directive.payload.playerOffsetInMilliSeconds = 0;
+    envelope.directive.payload.tempoData.funcs.encode = encode_tempo_data;
+    envelope.directive.payload.tempoData.arg = (void*)&tempo_count;
+
+    BOOL status = pb_encode(&stream, alexaGadgetMusicData_TempoDirectiveProto_fields, &envelope);
+    if (!status)
+    {
+      printf("%s: Error encoding message\n", __FUNCTION__);
+      return;
+    }
+
+    printf("bytes written:%zu\n", stream.bytes_written);
+    uint8_t index;
+    for(index = 0; index < stream.bytes_written; index++)
+    {
+        printf("0x%02x ", buffer[index]);
+    }
+    printf("\n");
+    decode_directive(buffer, stream.bytes_written);
+}
+
+typedef struct {
+    uint64_t start_us;
+    int64_t max_late_us;
+    int64_t total_late_us;
+} sample_timeline_stats_t;
+
+static void fire_speechmark(void* context, speechmark_event_t const* event, int64_t late_us)
+{
+    sample_timeline_stats_t* stats = context;
+    printf("%8.3fms: %s %s (offset %dms, %lldus late)\n", (double)(now_us() - stats->start_us) / 1000.0,
+            event->type == SPEECHMARK_VISEME ? "viseme" : event->type == SPEECHMARK_WORD ? "word" : "speechmark",
+            event->value, event->start_offset_ms, (long long)late_us);
+    if (late_us > stats->max_late_us) {
+        stats->max_late_us = late_us;
+    }
+    stats->total_late_us += late_us;
+}
+
+// Fires the speechmarks scheduled by print_speechmarks(). The loop sleeps until shortly before the next speechmark,
+// then spins until it is due: a sleep per speechmark would add the wake up latency of the OS to every one of them.
+void run_sample_speechmarks_timeline()
+{
+    static uint64_t const spin_us = 1000;
+    sample_timeline_stats_t* stats = speechmarks_scheduler.context;
+    stats->start_us = now_us();
+    uint64_t deadline_us;
+    while (speechmarks_scheduler_next_deadline(&speechmarks_scheduler, now_us(), &deadline_us)) {
+        uint64_t current_us = now_us();
+        if (deadline_us > current_us + spin_us) {
+            uint64_t sleep_us = deadline_us - current_us - spin_us;
+            struct timespec sleep = {(time_t)(sleep_us / 1000000U), (long)(sleep_us % 1000000U) * 1000};
+            nanosleep(&sleep, NULL);
+        }
+        while (now_us() < deadline_us) {
+        }
+        speechmarks_scheduler_poll(&speechmarks_scheduler, now_us());
+    }
+    if (speechmarks_scheduler.fired_count > 0) {
+        printf("%zu speechmarks fired, %zu dropped, lateness avg %lldus max %lldus\n",
+                speechmarks_scheduler.fired_count, speechmarks_scheduler.dropped_count,
+                (long long)(stats->total_late_us / (int64_t)speechmarks_scheduler.fired_count),
+                (long long)stats->max_late_us);
+    }
+}
+
+typedef struct {
+    size_t events[ALERT_EVENT_EXPIRED + 1];
+} sample_alert_stats_t;
+
+static void play_alert(void* context, alert_t const* alert, alert_event_t event, int64_t due_ms)
+{
+    static char const* const names[] = {"loop started", "finished", "stopped", "expired"};
+    sample_alert_stats_t* stats = context;
+    stats->events[event]++;
+    // The sample alert, the timers added by run_sample_alerts() are only counted.
+    if (0 == strcmp(alert->token, "alertToken1")) {
+        printf("%lldms: %s %s", (long long)due_ms, alert->token, names[event]);
+        if (event == ALERT_EVENT_LOOP_STARTED) {
+            printf(", loop %d of %d", alert->loop + 1, alert->loop_count);
+        }
+        printf("\n");
+    }
+}
+
+// Fills the alert store with timers, as a user setting dozens of timers and reminders would, and plays them in
+// simulated time: the gadget only wakes up when an alert is due, rather than checking every alert on every tick.
+void run_sample_alerts()
+{
+    static size_t const timer_count = ALERT_STORE_MAX_ALERTS - 1;
+    sample_alert_stats_t* stats = alert_store.context;
+    int64_t start_ms;
+    char const scheduled_time[] = "2019-12-03T10:15:30+0000";
+    alert_time_parse(scheduled_time, sizeof(scheduled_time) - 1, &start_ms);
+
+    uint64_t set_start_us = now_us();
+    for (size_t i = 0; i < timer_count; ++i) {
+        char token[ALERT_TOKEN_SIZE];
+        int size = snprintf(token, sizeof(token), "timer-%zu", i);
+        // Spread over the next hour, out of order.
+        int64_t scheduled_ms = start_ms + (int64_t)((i * 7919) % timer_count) * 60 * 1000 * 2;
+        alert_store_set(&alert_store, token, (size_t)size, ALERT_TYPE_TIMER, scheduled_ms, 2, 1000);
+    }
+    uint64_t set_us = now_us() - set_start_us;
+    printf("%zu alerts set in %lluus\n", alert_store.count, (unsigned long long)set_us);
+
+    size_t wakeups = 0;
+    uint64_t poll_start_us = now_us();
+    int64_t deadline_ms;
+    while (alert_store_next_deadline(&alert_store, &deadline_ms)) {
+        wakeups++;
+        alert_store_poll(&alert_store, deadline_ms);
+    }
+    uint64_t poll_us = now_us() - poll_start_us;
+    printf("%zu loops started, %zu alerts finished in %zu wake ups (%lluus), instead of %lld ticks of a second\n",
+            stats->events[ALERT_EVENT_LOOP_STARTED], stats->events[ALERT_EVENT_FINISHED], wakeups,
+            (unsigned long long)poll_us, (long long)((deadline_ms - start_ms) / 1000));
+}
+
+// Measures what a StateUpdate costs once interned: the states of a directive go into a batch, the table is updated
+// with a single store, and the LED loops read it with a single load.
+void run_sample_state_table()
+{
+    static size_t const update_count = 100000;
+    static char const* const states[][2] = {
+        {"wakeword", "active"}, {"timers", "active"}, {"alarms", "cleared"}, {"reminders", "cleared"},
+        {"wakeword", "cleared"},
+    };
+    // The callbacks print, they would make up most of the time measured.
+    for (size_t i = 0; i < STATE_COUNT; ++i) {
+        state_table_on_change(&state_table, (state_name_t)i, NULL, NULL);
+    }
+
+    uint64_t start_us = now_us();
+    for (size_t i = 0; i < update_count; ++i) {
+        state_batch_t batch;
+        state_batch_init(&batch);
+        // Odd updates stop before the last state, so that the wakeword goes active and cleared in turn.
+        size_t count = (i & 1U) ? 4 : 5;
+        for (size_t j = 0; j < count; ++j) {
+            state_batch_add(&batch, states[j][0], strlen(states[j][0]), states[j][1], strlen(states[j][1]));
+        }
+        state_table_apply(&state_table, &batch);
+    }
+    uint64_t update_us = now_us() - start_us;
+
+    size_t active_count = 0;
+    start_us = now_us();
+    for (size_t i = 0; i < update_count; ++i) {
+        active_count += state_table_is_active(&state_table, STATE_TIMERS);
+    }
+    uint64_t read_us = now_us() - start_us;
+    printf("state update of 4-5 pairs: %.1fns, state read: %.1fns (%zu reads active)\n",
+            (double)update_us * 1000.0 / update_count, (double)read_us * 1000.0 / update_count, active_count);
+
+    for (size_t i = 0; i < STATE_COUNT; ++i) {
+        state_table_on_change(&state_table, (state_name_t)i, print_state_change, NULL);
+    }
+}
+
+// Drives a 1 kHz loop from the beat clock, as an LED or motor loop of a gadget would, for a few beats. Halfway through,
+// a Tempo directive is received with the player 4ms ahead of the clock, as if the local clock ran slow: the clock
+// takes half of the error at once and the rest through its rate.
+void run_sample_beat_clock()
+{
+    static uint64_t const tick_us = 1000;
+    static uint64_t const run_us = 3000000;
+    static size_t const query_count = 1000000;
+    uint64_t const start_us = now_us();
+    bool corrected = false;
+    size_t beat_count = 0;
+    uint64_t max_late_us = 0;
+    beat_t next;
+    if (!beat_clock_next_beat(&beat_clock, start_us, &next)) {
+        return;
+    }
+    for (uint64_t tick = 1; now_us() - start_us < run_us; ++tick) {
+        uint64_t deadline_us = start_us + tick * tick_us;
+        uint64_t current_us = now_us();
+        if (deadline_us > current_us) {
+            uint64_t sleep_us = deadline_us - current_us;
+            struct timespec sleep = {0, (long)sleep_us * 1000};
+            nanosleep(&sleep, NULL);
+        }
+        current_us = now_us();
+        if (!corrected && current_us - start_us >= run_us / 2) {
+            // Same tempo as the sample Tempo directive, sent when the player was at the song position of the clock.
+            beat_t before;
+            beat_t after;
+            beat_clock_tempo_t const tempo = {0, 120};
+            int32_t player_offset_ms = (int32_t)((current_us - start_us) / 1000) + 4;
+            beat_clock_next_beat(&beat_clock, current_us, &before);
+            beat_clock_update(&beat_clock, current_us, player_offset_ms, &tempo, 1);
+            beat_clock_next_beat(&beat_clock, current_us, &after);
+            printf("%8.3fms: tempo update 4ms ahead, rate %dppm, next beat moved by %lldus\n",
+                    (double)(current_us - start_us) / 1000.0, beat_clock.timeline.rate_ppm,
+                    (long long)(after.local_us - before.local_us));
+            next = after;
+            corrected = true;
+        }
+        if (current_us >= next.local_us) {
+            uint64_t late_us = current_us - next.local_us;
+            if (late_us > max_late_us) {
+                max_late_us = late_us;
+            }
+            printf("%8.3fms: beat at %d BPM (%lluus late)\n", (double)(current_us - start_us) / 1000.0, next.bpm,
+                    (unsigned long long)late_us);
+            beat_count++;
+            // Half a period on, so that the beat just played is not found again.
+            beat_clock_next_beat(&beat_clock, next.local_us + next.period_us / 2, &next);
+        }
+    }
+    printf("%zu beats, max %lluus late\n", beat_count, (unsigned long long)max_late_us);
+
+    uint64_t query_start_us = now_us();
+    uint64_t checksum = 0;
+    for (size_t i = 0; i < query_count; ++i) {
+        beat_t beat;
+        beat_clock_next_beat(&beat_clock, query_start_us + i, &beat);
+        checksum += beat.local_us;
+    }
+    printf("next beat query: %.1fns (checksum %llu)\n", (double)(now_us() - query_start_us) * 1000.0 / query_count,
+            (unsigned long long)checksum);
+}
 
 // Sample byte array that represents a serialized protobuf message
 int main(int argc, char** argv)
 {
+    static sample_timeline_stats_t timeline_stats;
+    static sample_alert_stats_t alert_stats;
+    speechmarks_scheduler_init(&speechmarks_scheduler, SAMPLE_SPEECHMARKS_DELIVERY_DELAY_US, fire_speechmark,
+            &timeline_stats);
+    beat_clock_init(&beat_clock, SAMPLE_TEMPO_DELIVERY_DELAY_US);
+    state_table_init(&state_table);
+    for (size_t i = 0; i < STATE_COUNT; ++i) {
+        state_table_on_change(&state_table, (state_name_t)i, print_state_change, NULL);
+    }
+    alert_store_init(&alert_store, SAMPLE_ALERT_LOOP_DURATION_MS, play_alert, &alert_stats);
+    register_sample_directive_routes();
+
     printf("\nNotifications - SetIndicator Example\n");
     // decoding and encoding of notifcation - set indicator directive
     uint8_t notification_binary[] = {
@@ -437,17 +1353,32 @@ int main(int argc, char** argv)
     // creating sample set indicator directive
     encode_set_indicator_directive(1, 1, "assetID1", "url1");
 
+    printf("\nAlerts - SetAlert Example\n");
+    encode_sample_set_alert_directive();
+    run_sample_alerts();
+
+    printf("\nAlerts - DeleteAlert Example\n");
+    encode_sample_set_alert_directive();
+    encode_sample_delete_alert_directive("alertToken1");
+
     printf("\nAlexa.Discovery - Discover.Response Example\n");
     encode_sample_discover_response_event();
+    run_sample_discover_response_footprint();
 
     printf("\nAlexa.Discovery - Discover Example\n");
     encode_sample_discover_directive();
 
     printf("\nAlexa.Gadget.StateListener - StateUpdate Example\n");
     encode_sample_state_update_directive();
+    run_sample_state_table();
 
     printf("\nAlexa.Gadget.SpeechData - Speechmarks Example\n");
     encode_sample_speechmarks_directive();
+    run_sample_speechmarks_timeline();
+
+    printf("\nAlexa.Gadget.MusicData - Tempo Example\n");
+    encode_sample_tempo_directive();
+    run_sample_beat_clock();
 
     return 0;
 }
@@ -0,0 +1,189 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <string.h>
+#include "speechmarks_scheduler.h"
+
+#define WHEEL_MASK (SPEECHMARKS_SCHEDULER_WHEEL_SLOTS - 1)
+
+// Millisecond of speech of a time in microseconds of speech, rounded down.
+static int64_t media_ms(int64_t media_us)
+{
+    return media_us >= 0 ? media_us / 1000 : -((999 - media_us) / 1000);
+}
+
+static speechmark_event_t** slot_of(speechmarks_scheduler_t* scheduler, int64_t ms)
+{
+    return &scheduler->slots[(uint64_t)ms & WHEEL_MASK];
+}
+
+// Position of the speech at local time now_us, extrapolated from the anchor.
+static int64_t media_now_us(speechmarks_scheduler_t const* scheduler, uint64_t now_us)
+{
+    return scheduler->anchor_media_us + (int64_t)(now_us - scheduler->anchor_local_us);
+}
+
+static speechmark_type_t parse_type(char const* type)
+{
+    if (0 == strcmp(type, "viseme")) {
+        return SPEECHMARK_VISEME;
+    }
+    if (0 == strcmp(type, "word")) {
+        return SPEECHMARK_WORD;
+    }
+    return SPEECHMARK_OTHER;
+}
+
+void speechmarks_scheduler_init(speechmarks_scheduler_t* scheduler, uint32_t delivery_delay_us,
+        speechmark_callback_t callback, void* context)
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    for (size_t i = 0; i < SPEECHMARKS_SCHEDULER_MAX_EVENTS; ++i) {
+        scheduler->events[i].next = scheduler->free_events;
+        scheduler->free_events = &scheduler->events[i];
+    }
+    scheduler->last_fired_ms = INT64_MIN;
+    scheduler->delivery_delay_us = delivery_delay_us;
+    scheduler->callback = callback;
+    scheduler->context = context;
+}
+
+void speechmarks_scheduler_clear(speechmarks_scheduler_t* scheduler)
+{
+    for (size_t i = 0; i < SPEECHMARKS_SCHEDULER_WHEEL_SLOTS; ++i) {
+        while (scheduler->slots[i]) {
+            speechmark_event_t* event = scheduler->slots[i];
+            scheduler->slots[i] = event->next;
+            event->next = scheduler->free_events;
+            scheduler->free_events = event;
+        }
+    }
+    scheduler->pending = 0;
+    scheduler->anchored = false;
+    scheduler->last_fired_ms = INT64_MIN;
+}
+
+void speechmarks_scheduler_anchor(speechmarks_scheduler_t* scheduler, uint64_t now_us,
+        int32_t player_offset_ms)
+{
+    // The player was at player_offset_ms when the directive was sent, it has moved on by the delivery delay since.
+    int64_t media_us = (int64_t)player_offset_ms * 1000 + scheduler->delivery_delay_us;
+    if (scheduler->anchored && media_us < media_now_us(scheduler, now_us) - SPEECHMARKS_SCHEDULER_RESYNC_US) {
+        speechmarks_scheduler_clear(scheduler);
+    }
+    if (!scheduler->anchored) {
+        scheduler->cursor_ms = media_ms(media_us) - 1;
+        scheduler->anchored = true;
+    }
+    // Later batches correct the drift between the local clock and the player.
+    scheduler->anchor_media_us = media_us;
+    scheduler->anchor_local_us = now_us;
+}
+
+bool speechmarks_scheduler_add(speechmarks_scheduler_t* scheduler, int32_t start_offset_ms, char const* type,
+        char const* value)
+{
+    if (!scheduler->anchored) {
+        return false;
+    }
+    // Batches follow the speech, so a speechmark not after the last one fired is a resent one.
+    if (start_offset_ms <= scheduler->last_fired_ms) {
+        return true;
+    }
+    speechmark_type_t speechmark_type = parse_type(type);
+    // A speechmark already due goes in the next slot to process, to fire as soon as possible.
+    int64_t slot_ms = start_offset_ms > scheduler->cursor_ms ? start_offset_ms : scheduler->cursor_ms + 1;
+    speechmark_event_t** slot = slot_of(scheduler, slot_ms);
+    for (speechmark_event_t const* event = *slot; event; event = event->next) {
+        if (event->start_offset_ms == start_offset_ms && event->type == speechmark_type
+                && 0 == strncmp(event->value, value, SPEECHMARK_VALUE_SIZE - 1)) {
+            return true;
+        }
+    }
+
+    speechmark_event_t* event = scheduler->free_events;
+    if (!event) {
+        scheduler->dropped_count++;
+        return false;
+    }
+    scheduler->free_events = event->next;
+    event->due_us = (int64_t)start_offset_ms * 1000;
+    event->start_offset_ms = start_offset_ms;
+    event->type = speechmark_type;
+    strncpy(event->value, value, SPEECHMARK_VALUE_SIZE - 1);
+    event->value[SPEECHMARK_VALUE_SIZE - 1] = '\0';
+
+    // Slots hold a few speechmarks at most, a sorted insert keeps the earliest at the head.
+    while (*slot && (*slot)->due_us <= event->due_us) {
+        slot = &(*slot)->next;
+    }
+    event->next = *slot;
+    *slot = event;
+    scheduler->pending++;
+    return true;
+}
+
+// Fires the speechmarks of a slot that are due at now_media_us.
+static void fire_slot(speechmarks_scheduler_t* scheduler, int64_t ms, int64_t now_media_us)
+{
+    speechmark_event_t** slot = slot_of(scheduler, ms);
+    while (*slot && (*slot)->due_us <= now_media_us) {
+        speechmark_event_t* event = *slot;
+        *slot = event->next;
+        scheduler->pending--;
+        scheduler->last_fired_ms = event->start_offset_ms;
+        int64_t late_us = now_media_us - event->due_us;
+        if (late_us > SPEECHMARKS_SCHEDULER_MAX_LATE_US) {
+            scheduler->dropped_count++;
+        } else {
+            scheduler->fired_count++;
+            scheduler->callback(scheduler->context, event, late_us);
+        }
+        event->next = scheduler->free_events;
+        scheduler->free_events = event;
+    }
+}
+
+void speechmarks_scheduler_poll(speechmarks_scheduler_t* scheduler, uint64_t now_us)
+{
+    if (!scheduler->anchored) {
+        return;
+    }
+    int64_t now_media_us = media_now_us(scheduler, now_us);
+    int64_t now_ms = media_ms(now_media_us);
+    // After a long stall every slot is visited once, each holding the speechmarks of a single past millisecond
+    // modulo the wheel size, so the order across slots only matters for speechmarks too late to fire anyway.
+    int64_t first_ms = scheduler->cursor_ms + 1;
+    if (first_ms < now_ms - (int64_t)WHEEL_MASK) {
+        first_ms = now_ms - (int64_t)WHEEL_MASK;
+    }
+    for (int64_t ms = first_ms; ms <= now_ms; ++ms) {
+        fire_slot(scheduler, ms, now_media_us);
+    }
+    // The current millisecond may still have speechmarks due later in it.
+    if (now_ms - 1 > scheduler->cursor_ms) {
+        scheduler->cursor_ms = now_ms - 1;
+    }
+}
+
+bool speechmarks_scheduler_next_deadline(speechmarks_scheduler_t const* scheduler, uint64_t now_us,
+        uint64_t* deadline_us)
+{
+    if (!scheduler->anchored || scheduler->pending == 0) {
+        return false;
+    }
+    // Slots are sorted, so the earliest speechmark is the earliest head.
+    int64_t due_us = INT64_MAX;
+    for (size_t i = 0; i < SPEECHMARKS_SCHEDULER_WHEEL_SLOTS; ++i) {
+        if (scheduler->slots[i] && scheduler->slots[i]->due_us < due_us) {
+            due_us = scheduler->slots[i]->due_us;
+        }
+    }
+    int64_t wait_us = due_us - media_now_us(scheduler, now_us);
+    *deadline_us = wait_us > 0 ? now_us + (uint64_t)wait_us : now_us;
+    return true;
+}
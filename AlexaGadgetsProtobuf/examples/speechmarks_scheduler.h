@@ -0,0 +1,103 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_SPEECHMARKS_SCHEDULER_H
+#define ALEXA_GADGETS_SAMPLE_CODE_SPEECHMARKS_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of speechmarks that can be pending at once.
+#define SPEECHMARKS_SCHEDULER_MAX_EVENTS (64U)
+// Slots of the timer wheel, one per millisecond of speech. A power of two.
+#define SPEECHMARKS_SCHEDULER_WHEEL_SLOTS (256U)
+// Size of the value of a speechmark, NUL included. Longer values, e.g. long words, are truncated.
+#define SPEECHMARK_VALUE_SIZE (16U)
+// Speechmarks later than this are dropped rather than fired: the mouth would move after the sound.
+#define SPEECHMARKS_SCHEDULER_MAX_LATE_US (50000)
+// A batch whose player offset is this much behind the timeline restarts it, e.g. after a seek or a new speech.
+#define SPEECHMARKS_SCHEDULER_RESYNC_US (100000)
+
+typedef enum {
+    SPEECHMARK_VISEME = 0,
+    SPEECHMARK_WORD,
+    SPEECHMARK_OTHER
+} speechmark_type_t;
+
+typedef struct speechmark_event_s {
+    struct speechmark_event_s* next;
+    // When the speechmark is due, in microseconds of speech.
+    int64_t due_us;
+    int32_t start_offset_ms;
+    speechmark_type_t type;
+    char value[SPEECHMARK_VALUE_SIZE];
+} speechmark_event_t;
+
+// Called when a speechmark is due. late_us is how late the poll that fired it was.
+typedef void (*speechmark_callback_t)(void* context, speechmark_event_t const* event, int64_t late_us);
+
+// Timeline of the speechmarks of the speech being played, anchored to the player offset of the latest batch.
+// Times are given by the caller in microseconds of a monotonic clock, so the scheduler does not depend on a platform.
+typedef struct {
+    speechmark_event_t events[SPEECHMARKS_SCHEDULER_MAX_EVENTS];
+    speechmark_event_t* free_events;
+    // Pending speechmarks by millisecond of speech modulo the wheel size, sorted by due time.
+    speechmark_event_t* slots[SPEECHMARKS_SCHEDULER_WHEEL_SLOTS];
+    size_t pending;
+    // Speech position anchor_media_us was reached at local time anchor_local_us.
+    bool anchored;
+    int64_t anchor_media_us;
+    uint64_t anchor_local_us;
+    // Last millisecond of speech whose slot has been fully processed.
+    int64_t cursor_ms;
+    // Start offset of the last speechmark fired or dropped. Earlier speechmarks have been played already.
+    int64_t last_fired_ms;
+    // Time from the player offset being sent to the batch being received, e.g. the BLE connection interval.
+    uint32_t delivery_delay_us;
+    speechmark_callback_t callback;
+    void* context;
+    size_t fired_count;
+    size_t dropped_count;
+} speechmarks_scheduler_t;
+
+// Initializes an empty timeline.
+void speechmarks_scheduler_init(speechmarks_scheduler_t* scheduler, uint32_t delivery_delay_us,
+        speechmark_callback_t callback, void* context);
+
+// Anchors the timeline to the player offset of a Speechmarks directive received at now_us. Call it before adding the
+// speechmarks of the directive. Pending speechmarks are kept, unless the player went back in time.
+void speechmarks_scheduler_anchor(speechmarks_scheduler_t* scheduler, uint64_t now_us,
+        int32_t player_offset_ms);
+
+// Adds a speechmark to the timeline. A speechmark already in the timeline or played, e.g. from an overlapping batch,
+// is skipped. A speechmark already due is fired by the next poll.
+// Returns false if the timeline is full or not anchored.
+bool speechmarks_scheduler_add(speechmarks_scheduler_t* scheduler, int32_t start_offset_ms, char const* type,
+        char const* value);
+
+// Fires the speechmarks due at now_us, and drops those too late to be fired.
+void speechmarks_scheduler_poll(speechmarks_scheduler_t* scheduler, uint64_t now_us);
+
+// Returns the local time the next speechmark is due at in *deadline_us, for the caller to wait until then and poll.
+// Returns false if the timeline is empty.
+bool speechmarks_scheduler_next_deadline(speechmarks_scheduler_t const* scheduler, uint64_t now_us,
+        uint64_t* deadline_us);
+
+// Drops all pending speechmarks, e.g. when the speech is interrupted.
+void speechmarks_scheduler_clear(speechmarks_scheduler_t* scheduler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_SPEECHMARKS_SCHEDULER_H
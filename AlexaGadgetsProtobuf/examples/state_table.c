@@ -0,0 +1,113 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+#include <string.h>
+#include "state_table.h"
+
+#define ACTIVE_MASK (STATE_KNOWN_BIT(0) - 1)
+
+static struct {
+    char const* name;
+    size_t size;
+} const state_names[STATE_COUNT] = {
+    [STATE_WAKEWORD] = {"wakeword", sizeof("wakeword") - 1},
+    [STATE_TIMERS] = {"timers", sizeof("timers") - 1},
+    [STATE_ALARMS] = {"alarms", sizeof("alarms") - 1},
+    [STATE_REMINDERS] = {"reminders", sizeof("reminders") - 1},
+};
+
+void state_table_init(state_table_t* table)
+{
+    atomic_init(&table->bits, 0);
+    for (size_t i = 0; i < STATE_COUNT; ++i) {
+        table->callbacks[i] = NULL;
+        table->contexts[i] = NULL;
+    }
+}
+
+void state_table_on_change(state_table_t* table, state_name_t name, state_callback_t callback, void* context)
+{
+    table->callbacks[name] = callback;
+    table->contexts[name] = context;
+}
+
+bool state_name_intern(char const* name, size_t size, state_name_t* interned)
+{
+    // Comparing the sizes first rules out most names without reading them.
+    for (size_t i = 0; i < STATE_COUNT; ++i) {
+        if (state_names[i].size == size && 0 == memcmp(state_names[i].name, name, size)) {
+            *interned = (state_name_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Interns a state value. "active" and "cleared" have different sizes, so the size tells which one to compare with.
+static bool state_value_intern(char const* value, size_t size, bool* active)
+{
+    if (size == sizeof("active") - 1 && 0 == memcmp(value, "active", size)) {
+        *active = true;
+        return true;
+    }
+    if (size == sizeof("cleared") - 1 && 0 == memcmp(value, "cleared", size)) {
+        *active = false;
+        return true;
+    }
+    return false;
+}
+
+void state_batch_init(state_batch_t* batch)
+{
+    batch->mask = 0;
+    batch->active = 0;
+    batch->unknown_count = 0;
+}
+
+bool state_batch_add(state_batch_t* batch, char const* name, size_t name_size, char const* value,
+        size_t value_size)
+{
+    state_name_t interned;
+    bool active;
+    if (!state_name_intern(name, name_size, &interned) || !state_value_intern(value, value_size, &active)) {
+        batch->unknown_count++;
+        return false;
+    }
+    batch->mask |= STATE_KNOWN_BIT(interned);
+    if (active) {
+        batch->active |= STATE_ACTIVE_BIT(interned);
+    } else {
+        batch->active &= ~STATE_ACTIVE_BIT(interned);
+    }
+    return true;
+}
+
+void state_table_apply(state_table_t* table, state_batch_t const* batch)
+{
+    // Only this thread writes the bits, so the old value cannot change under it.
+    uint32_t old_bits = atomic_load_explicit(&table->bits, memory_order_relaxed);
+    uint32_t updated = batch->mask >> 16;
+    uint32_t new_bits = (old_bits & ~updated) | (batch->active & updated) | batch->mask;
+    atomic_store_explicit(&table->bits, new_bits, memory_order_release);
+
+    uint32_t changed = (old_bits ^ new_bits) & ACTIVE_MASK;
+    for (size_t i = 0; changed != 0; ++i, changed >>= 1) {
+        if ((changed & 1U) && table->callbacks[i]) {
+            table->callbacks[i](table->contexts[i], (state_name_t)i, (new_bits & STATE_ACTIVE_BIT(i)) != 0);
+        }
+    }
+}
+
+uint32_t state_table_snapshot(state_table_t const* table)
+{
+    return atomic_load_explicit(&table->bits, memory_order_acquire);
+}
+
+bool state_table_is_active(state_table_t const* table, state_name_t name)
+{
+    return (state_table_snapshot(table) & STATE_ACTIVE_BIT(name)) != 0;
+}
@@ -0,0 +1,84 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_STATE_TABLE_H
+#define ALEXA_GADGETS_SAMPLE_CODE_STATE_TABLE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The StateListener states whose value is "active" or "cleared". Others, e.g. timeinfo, are not interned.
+typedef enum {
+    STATE_WAKEWORD = 0,
+    STATE_TIMERS,
+    STATE_ALARMS,
+    STATE_REMINDERS,
+    STATE_COUNT
+} state_name_t;
+
+// Bit of a state in a snapshot, set while the state is active.
+#define STATE_ACTIVE_BIT(name) (1UL << (name))
+// Bit of a state in a snapshot, set once a value was received for it. States start as cleared.
+#define STATE_KNOWN_BIT(name) (1UL << (16 + (name)))
+
+// Called when a state becomes active or cleared. Not called when a StateUpdate repeats the current value.
+typedef void (*state_callback_t)(void* context, state_name_t name, bool active);
+
+// The states of a StateUpdate directive, interned.
+typedef struct {
+    // Known bits of the states in the directive, and active bits of those that are active.
+    uint32_t mask;
+    uint32_t active;
+    // States whose name or value was not recognized.
+    size_t unknown_count;
+} state_batch_t;
+
+// Current value of the states, packed in a word. It is updated by a single thread, the one handling the directives,
+// and read from any thread or interrupt with a single atomic load, e.g. by an LED loop.
+typedef struct {
+    atomic_uint_least32_t bits;
+    state_callback_t callbacks[STATE_COUNT];
+    void* contexts[STATE_COUNT];
+} state_table_t;
+
+// Initializes a table with all states cleared and unknown, and no callbacks.
+void state_table_init(state_table_t* table);
+
+// Sets the function called on the transitions of a state, or removes it with NULL.
+void state_table_on_change(state_table_t* table, state_name_t name, state_callback_t callback, void* context);
+
+// Interns a state name. Returns false if the state is not one of state_name_t.
+bool state_name_intern(char const* name, size_t size, state_name_t* interned);
+
+void state_batch_init(state_batch_t* batch);
+
+// Adds a (name, value) pair of a StateUpdate directive to a batch. A later pair for the same state wins.
+// Returns false, and counts the pair as unknown, if the name or the value is not recognized.
+bool state_batch_add(state_batch_t* batch, char const* name, size_t name_size, char const* value,
+        size_t value_size);
+
+// Publishes the states of a batch, then calls the callbacks of the states that changed.
+void state_table_apply(state_table_t* table, state_batch_t const* batch);
+
+// Returns the STATE_ACTIVE_BIT and STATE_KNOWN_BIT bits of all states at once. Lock-free.
+uint32_t state_table_snapshot(state_table_t const* table);
+
+// Returns whether a state is active. Lock-free.
+bool state_table_is_active(state_table_t const* table, state_name_t name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_STATE_TABLE_H
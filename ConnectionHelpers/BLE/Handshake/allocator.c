@@ -0,0 +1,84 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+static void *heapAlloc(void *context, size_t size) {
+    return malloc(size);
+}
+
+static void heapFree(void *context, void *ptr) {
+    free(ptr);
+}
+
+static gadget_allocator_t const heapAllocator = {heapAlloc, heapFree, NULL};
+static gadget_allocator_t const *defaultAllocator = &heapAllocator;
+
+void GadgetAllocator_setDefault(gadget_allocator_t const *const allocator) {
+    defaultAllocator = allocator ? allocator : &heapAllocator;
+}
+
+void *GadgetAllocator_alloc(gadget_allocator_t const *allocator, size_t size) {
+    if (!allocator) allocator = defaultAllocator;
+    return allocator->alloc(allocator->context, size);
+}
+
+void GadgetAllocator_free(gadget_allocator_t const *allocator, void *const ptr) {
+    if (!ptr) return;
+    if (!allocator) allocator = defaultAllocator;
+    allocator->free(allocator->context, ptr);
+}
+
+void GadgetAllocator_releasePacket(void *const context, uint8_t *const data) {
+    GadgetAllocator_free(context, data);
+}
+
+static void *arenaAlloc(void *context, size_t size) {
+    gadget_arena_t *const arena = context;
+    size_t const alignment = _Alignof(max_align_t);
+    uintptr_t const base = (uintptr_t) arena->buffer;
+    size_t offset = ((base + arena->used + alignment - 1) & ~(uintptr_t) (alignment - 1)) - base;
+    if (offset > arena->size || size > arena->size - offset) {
+        arena->failedCount++;
+        return NULL;
+    }
+    arena->used = offset + size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    arena->allocCount++;
+    return &arena->buffer[offset];
+}
+
+static void arenaFree(void *context, void *ptr) {
+    // Memory is released by GadgetArena_reset().
+}
+
+void GadgetArena_init(gadget_arena_t *const arena, void *const buffer, size_t size) {
+    arena->buffer = buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->allocCount = 0;
+    arena->failedCount = 0;
+    arena->allocator.alloc = arenaAlloc;
+    arena->allocator.free = arenaFree;
+    arena->allocator.context = arena;
+}
+
+gadget_allocator_t const *GadgetArena_getAllocator(gadget_arena_t *const arena) {
+    return &arena->allocator;
+}
+
+void GadgetArena_reset(gadget_arena_t *const arena) {
+    arena->used = 0;
+    arena->allocCount = 0;
+    arena->failedCount = 0;
+}
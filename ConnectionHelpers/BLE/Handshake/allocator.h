@@ -0,0 +1,103 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_ALLOCATOR_H
+#define ALEXA_GADGETS_SAMPLE_CODE_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Memory allocator used by the gadget protocol code, similar to mbedtls_platform_set_calloc_free().
+ * @sa GadgetAllocator_setDefault().
+ * @sa GadgetSession_setAllocator().
+ */
+typedef struct {
+    /// Returns \p size bytes aligned for any type, or NULL if the memory is exhausted.
+    void *(*alloc)(void *context, size_t size);
+    /// Releases memory returned by alloc. \p ptr is never NULL.
+    void (*free)(void *context, void *ptr);
+    void *context;
+} gadget_allocator_t;
+
+/**
+ * Sets the allocator used when no session allocator applies, e.g. for packet queue nodes.
+ * It must be set before any memory is allocated, since memory is always returned to the allocator it came from.
+ * @param allocator the allocator, or NULL to use malloc() and free(). It must stay valid while in use.
+ */
+void GadgetAllocator_setDefault(gadget_allocator_t const *allocator);
+
+/**
+ * Allocates memory.
+ * @param allocator the allocator to use, or NULL for the default allocator.
+ * @param size the number of bytes.
+ * @return the memory, or NULL if the allocation failed.
+ */
+void *GadgetAllocator_alloc(gadget_allocator_t const *allocator, size_t size);
+
+/**
+ * Releases memory returned by GadgetAllocator_alloc().
+ * @param allocator the allocator the memory came from, or NULL for the default allocator.
+ * @param ptr the memory to release. NULL is ignored.
+ */
+void GadgetAllocator_free(gadget_allocator_t const *allocator, void *ptr);
+
+/**
+ * A packet_release_t that returns the data of a packet to the gadget_allocator_t passed as context.
+ */
+void GadgetAllocator_releasePacket(void *context, uint8_t *data);
+
+/**
+ * A bump allocator over a caller-provided buffer.
+ * Memory is released all at once with GadgetArena_reset(), e.g. once a handshake is complete, and individual frees
+ * are ignored. The arena keeps statistics so that the memory used by a handshake can be measured.
+ * @sa GadgetArena_init().
+ * @sa GadgetArena_getAllocator().
+ */
+typedef struct {
+    uint8_t *buffer;
+    size_t size;
+    size_t used;
+    /// Largest number of bytes in use since the arena was initialized.
+    size_t peak;
+    /// Number of allocations since the arena was last reset.
+    size_t allocCount;
+    /// Number of allocations that did not fit since the arena was last reset.
+    size_t failedCount;
+    gadget_allocator_t allocator;
+} gadget_arena_t;
+
+/**
+ * Initializes an arena.
+ * @param arena the arena to initialize.
+ * @param buffer the memory to allocate from. It must outlive the arena.
+ * @param size the size of \p buffer in bytes.
+ */
+void GadgetArena_init(gadget_arena_t *arena, void *buffer, size_t size);
+
+/**
+ * Returns the allocator interface of the arena, for GadgetSession_setAllocator().
+ * @param arena an initialized arena.
+ */
+gadget_allocator_t const *GadgetArena_getAllocator(gadget_arena_t *arena);
+
+/**
+ * Releases all memory allocated from the arena. No memory allocated from it may be in use anymore.
+ * @param arena the arena to reset.
+ */
+void GadgetArena_reset(gadget_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_ALLOCATOR_H
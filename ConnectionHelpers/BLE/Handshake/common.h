@@ -14,8 +14,13 @@
 #include "config.h"
 
 #define ADV_DATA_LEN (31U)
+// ATT opcode and handle in front of each notification or write: a packet holds at most the ATT MTU less this.
+#define ATT_HEADER_SIZE (3U)
+#define ATT_MTU_MAX (517U)
+#define ATT_MTU_MIN (23U)
 #define BLE_AD_TYPE (0x06) // LE General discoverable mode, BT/EDR not supported.
 #define CONTROL_PACKET_LENGTH (6)
+#define NUM_STREAMS (3U)
 #define PROTOCOL_IDENTIFIER (0xFE03U)
 #define PROTOCOL_VERSION_MAJOR (3U)
 #define PROTOCOL_VERSION_MINOR (0U)
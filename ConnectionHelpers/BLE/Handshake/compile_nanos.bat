@@ -39,3 +39,15 @@ for /R  %INPUT_ROOT%\ConnectionHelpers\BLE\Proto %%G in (*.proto) do (
 	echo Compiling %%G
 	%PROTO_COMMAND% -I%INPUT_ROOT%\AlexaGadgetsProtobuf\common;. --nanopb_out=%OUTPUT_PATH% %%~nG%%~xG
 )
+
+REM The Alexa events that the sample builds at runtime.
+cd %INPUT_ROOT%\AlexaGadgetsProtobuf\common
+echo Compiling eventHeader.proto
+%PROTO_COMMAND% -I. --nanopb_out=%OUTPUT_PATH% eventHeader.proto
+
+REM Compiled from this folder, so that the .options files found here take precedence over the shipped ones.
+cd %OUTPUT_PATH%
+set DISCOVER_RESPONSE_PATH=%INPUT_ROOT%\AlexaGadgetsProtobuf\Alexa.Discovery\Discover.Response
+echo Compiling Discover.Response
+%PROTO_COMMAND% -I%INPUT_ROOT%\AlexaGadgetsProtobuf\common;%DISCOVER_RESPONSE_PATH% --nanopb_out=%OUTPUT_PATH% ^
+    alexaDiscoveryDiscoverResponseEvent.proto alexaDiscoveryDiscoverResponseEventPayload.proto
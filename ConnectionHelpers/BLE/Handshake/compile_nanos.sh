@@ -24,7 +24,11 @@ NANOPB_OUT='--nanopb_out=-I'
 COLON_SEP=':'
 CURRENT_FOLDER='.'
 
-all_proto_files="$(find ../. -name "accessories.proto")"
+# The gadget protocol messages, and the Alexa events that the sample builds at runtime.
+# protoc runs from this folder, so .options files found here take precedence over the ones next to the .proto files.
+all_proto_files="$(find ../. -name "accessories.proto") \
+$(find ../../../AlexaGadgetsProtobuf/common -name "eventHeader.proto") \
+$(find ../../../AlexaGadgetsProtobuf -name "alexaDiscoveryDiscoverResponseEvent.proto")"
 #echo $all_proto_files
 
 for file in $all_proto_files; do
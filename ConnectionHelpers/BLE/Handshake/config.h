@@ -12,4 +12,14 @@
 #define SAMPLE_MAX_TRANSACTION_SIZE (5000U)
 #define SAMPLE_NEGOTIATED_MTU       (128U)
 
+// Set to 1 to reassemble RX transactions in buffers preallocated in each gadget_session_t instead of on the heap.
+#define SAMPLE_STATIC_RX_BUFFERS    (0U)
+
+// Number of TX buffers in a fragment_pool_t. Each buffer holds a whole packet.
+#define SAMPLE_TX_POOL_SIZE         (32U)
+
+// Size of the writes to the OTA flash backend, e.g. the program page of the flash. OTA data is written through a
+// single buffer of this size instead of being reassembled.
+#define SAMPLE_OTA_WRITE_BLOCK_SIZE (256U)
+
 #endif //ALEXA_GADGETS_SAMPLE_CODE_CONFIG_H
@@ -0,0 +1,228 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "directive_stream.h"
+#include "helpers.h"
+#include "pb.h"
+
+// Field numbers from directiveParser.proto and directiveHeader.proto.
+#define DIRECTIVE_FIELD (1U)
+#define DIRECTIVE_HEADER_FIELD (1U)
+#define DIRECTIVE_PAYLOAD_FIELD (2U)
+#define HEADER_NAMESPACE_FIELD (1U)
+#define HEADER_NAME_FIELD (2U)
+#define HEADER_MESSAGE_ID_FIELD (3U)
+#define HEADER_DIALOG_REQUEST_ID_FIELD (4U)
+
+static bool setError(directive_stream_t *const stream, char const *const message) {
+    fprintf(stderr, "Directive decode failed at [%zu] :: %s\n", stream->position, message);
+    stream->state = DIRECTIVE_STREAM_ERROR;
+    return false;
+}
+
+static void deliverHeader(directive_stream_t *const stream) {
+    if (stream->headerComplete) return;
+    stream->headerComplete = true;
+    if (stream->handler && stream->handler->onHeader) {
+        stream->handler->onHeader(stream->context, &stream->header);
+    }
+}
+
+static char *getHeaderString(directive_header_t *const header, uint32_t fieldNumber) {
+    switch (fieldNumber) {
+        case HEADER_NAMESPACE_FIELD:
+            return header->nameSpace;
+        case HEADER_NAME_FIELD:
+            return header->name;
+        case HEADER_MESSAGE_ID_FIELD:
+            return header->messageId;
+        case HEADER_DIALOG_REQUEST_ID_FIELD:
+            return header->dialogRequestId;
+        default:
+            return NULL;
+    }
+}
+
+static bool isInHeader(directive_stream_t const *const stream) {
+    return stream->depth == 2 && stream->messageField[1] == DIRECTIVE_HEADER_FIELD;
+}
+
+// Decides what to do with a length-delimited field once its length is known.
+static bool startLengthDelimitedField(directive_stream_t *const stream, size_t length) {
+    if (length > stream->messageEnd[stream->depth] - stream->position) {
+        return setError(stream, "field exceeds its message");
+    }
+    stream->fieldRemaining = length;
+
+    if ((stream->depth == 0 && stream->fieldNumber == DIRECTIVE_FIELD) ||
+        (stream->depth == 1 && stream->fieldNumber == DIRECTIVE_HEADER_FIELD)) {
+        // Descend into the directive and its header.
+        stream->messageField[stream->depth] = stream->fieldNumber;
+        stream->depth++;
+        stream->messageEnd[stream->depth] = stream->position + length;
+        stream->state = DIRECTIVE_STREAM_TAG;
+    } else if (isInHeader(stream) && getHeaderString(&stream->header, stream->fieldNumber) != NULL) {
+        stream->string = getHeaderString(&stream->header, stream->fieldNumber);
+        stream->stringLength = 0;
+        stream->state = DIRECTIVE_STREAM_HEADER_STRING;
+    } else if (stream->depth == 1 && stream->fieldNumber == DIRECTIVE_PAYLOAD_FIELD) {
+        // The header is encoded before the payload, so it is known before the first payload byte.
+        deliverHeader(stream);
+        stream->state = DIRECTIVE_STREAM_PAYLOAD;
+    } else {
+        stream->state = DIRECTIVE_STREAM_SKIP;
+    }
+    return true;
+}
+
+static bool handleVarint(directive_stream_t *const stream) {
+    switch (stream->state) {
+        case DIRECTIVE_STREAM_TAG:
+            stream->fieldNumber = (uint32_t) (stream->varint >> 3U);
+            switch (stream->varint & 0x07U) {
+                case PB_WT_VARINT:
+                    stream->state = DIRECTIVE_STREAM_VARINT;
+                    break;
+                case PB_WT_64BIT:
+                    stream->fieldRemaining = 8;
+                    stream->state = DIRECTIVE_STREAM_SKIP;
+                    break;
+                case PB_WT_32BIT:
+                    stream->fieldRemaining = 4;
+                    stream->state = DIRECTIVE_STREAM_SKIP;
+                    break;
+                case PB_WT_STRING:
+                    stream->state = DIRECTIVE_STREAM_LENGTH;
+                    break;
+                default:
+                    return setError(stream, "invalid wire type");
+            }
+            if (stream->fieldNumber == 0) {
+                return setError(stream, "invalid field number");
+            }
+            return true;
+        case DIRECTIVE_STREAM_LENGTH:
+            return startLengthDelimitedField(stream, stream->varint);
+        case DIRECTIVE_STREAM_VARINT:
+            // None of the decoded fields are varints.
+            stream->state = DIRECTIVE_STREAM_TAG;
+            return true;
+        default:
+            return setError(stream, "unexpected varint");
+    }
+}
+
+void DirectiveStream_init(directive_stream_t *const stream, size_t transactionSize,
+                          directive_handler_t const *const handler, void *const context) {
+    memset(stream, 0, sizeof(*stream));
+    stream->handler = handler;
+    stream->context = context;
+    stream->state = DIRECTIVE_STREAM_TAG;
+    stream->messageEnd[0] = transactionSize;
+}
+
+bool DirectiveStream_feed(directive_stream_t *const stream, uint8_t const *data, size_t size) {
+    if (stream->state == DIRECTIVE_STREAM_ERROR) return false;
+    if (size > stream->messageEnd[0] - stream->position) {
+        return setError(stream, "data exceeds the transaction");
+    }
+
+    while (size > 0) {
+        if (stream->state == DIRECTIVE_STREAM_TAG) {
+            // Close the nested messages that end at this field boundary.
+            while (stream->depth > 0 && stream->position == stream->messageEnd[stream->depth]) {
+                if (isInHeader(stream)) {
+                    deliverHeader(stream);
+                }
+                stream->depth--;
+            }
+        }
+
+        switch (stream->state) {
+            case DIRECTIVE_STREAM_TAG:
+            case DIRECTIVE_STREAM_LENGTH:
+            case DIRECTIVE_STREAM_VARINT: {
+                if (stream->position >= stream->messageEnd[stream->depth]) {
+                    return setError(stream, "truncated varint");
+                }
+                uint8_t byte = *data++;
+                size--;
+                stream->position++;
+                if (stream->varintShift >= 64) {
+                    return setError(stream, "varint overflow");
+                }
+                stream->varint |= (uint64_t) (byte & 0x7FU) << stream->varintShift;
+                stream->varintShift += 7;
+                if ((byte & 0x80U) == 0) {
+                    bool status = handleVarint(stream);
+                    stream->varint = 0;
+                    stream->varintShift = 0;
+                    if (!status) return false;
+                }
+            }
+                break;
+            case DIRECTIVE_STREAM_SKIP:
+            case DIRECTIVE_STREAM_HEADER_STRING:
+            case DIRECTIVE_STREAM_PAYLOAD: {
+                size_t chunkSize = MIN(size, stream->fieldRemaining);
+                if (stream->state == DIRECTIVE_STREAM_HEADER_STRING) {
+                    // Truncate to the field size like the fixed size nanopb strings, keeping the null terminator.
+                    size_t copySize = MIN(chunkSize, DIRECTIVE_HEADER_FIELD_SIZE - 1 - stream->stringLength);
+                    memcpy(&stream->string[stream->stringLength], data, copySize);
+                    stream->stringLength += copySize;
+                    stream->string[stream->stringLength] = '\0';
+                } else if (stream->state == DIRECTIVE_STREAM_PAYLOAD && chunkSize > 0) {
+                    if (stream->handler && stream->handler->onPayload) {
+                        stream->handler->onPayload(stream->context, data, chunkSize);
+                    }
+                }
+                data += chunkSize;
+                size -= chunkSize;
+                stream->position += chunkSize;
+                stream->fieldRemaining -= chunkSize;
+                if (stream->fieldRemaining == 0) {
+                    stream->state = DIRECTIVE_STREAM_TAG;
+                }
+            }
+                break;
+            default:
+                return false;
+        }
+    }
+    // An empty field is complete as soon as its length is known.
+    if (stream->fieldRemaining == 0 && (stream->state == DIRECTIVE_STREAM_SKIP ||
+                                        stream->state == DIRECTIVE_STREAM_HEADER_STRING ||
+                                        stream->state == DIRECTIVE_STREAM_PAYLOAD)) {
+        stream->state = DIRECTIVE_STREAM_TAG;
+    }
+    return true;
+}
+
+bool DirectiveStream_finish(directive_stream_t *const stream) {
+    if (stream->state != DIRECTIVE_STREAM_TAG || stream->position != stream->messageEnd[0]) {
+        return setError(stream, "incomplete directive");
+    }
+    while (stream->depth > 0) {
+        if (stream->position != stream->messageEnd[stream->depth]) {
+            return setError(stream, "incomplete message");
+        }
+        if (isInHeader(stream)) {
+            deliverHeader(stream);
+        }
+        stream->depth--;
+    }
+    // A directive without a payload still has a header.
+    deliverHeader(stream);
+    if (stream->handler && stream->handler->onComplete) {
+        stream->handler->onComplete(stream->context, &stream->header);
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_STREAM_H
+#define ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same as the max_size of the string fields in directiveHeader.options.
+#define DIRECTIVE_HEADER_FIELD_SIZE (32U)
+#define DIRECTIVE_STREAM_MAX_DEPTH (2U)
+
+/**
+ * The header of an Alexa directive, as defined in directiveHeader.proto.
+ */
+typedef struct {
+    char nameSpace[DIRECTIVE_HEADER_FIELD_SIZE];
+    char name[DIRECTIVE_HEADER_FIELD_SIZE];
+    char messageId[DIRECTIVE_HEADER_FIELD_SIZE];
+    char dialogRequestId[DIRECTIVE_HEADER_FIELD_SIZE];
+} directive_header_t;
+
+/**
+ * Callbacks of an application that handles Alexa directives while they are being received.
+ * @sa GadgetSession_setDirectiveHandler().
+ */
+typedef struct {
+    /// Called as soon as the directive header is complete, before any of the payload is received.
+    void (*onHeader)(void *context, directive_header_t const *header);
+    /// Called with each chunk of the encoded directive payload, in order, as the packets carrying it arrive.
+    /// The payload is not decoded: the chunks are the protobuf encoding of the payload message routed by the header,
+    /// split at arbitrary byte boundaries.
+    void (*onPayload)(void *context, uint8_t const *data, size_t size);
+    /// Called once the last packet of the directive has been received and decoded.
+    void (*onComplete)(void *context, directive_header_t const *header);
+} directive_handler_t;
+
+typedef enum {
+    DIRECTIVE_STREAM_TAG,
+    DIRECTIVE_STREAM_LENGTH,
+    DIRECTIVE_STREAM_VARINT,
+    DIRECTIVE_STREAM_SKIP,
+    DIRECTIVE_STREAM_HEADER_STRING,
+    DIRECTIVE_STREAM_PAYLOAD,
+    DIRECTIVE_STREAM_ERROR
+} directive_stream_state_t;
+
+/**
+ * Resumable decoder of an encoded directive (see directiveParser.proto) that is fed one packet payload at a time.
+ * It decodes the header into a directive_header_t and passes the payload bytes through to the handler,
+ * so that the directive never has to be buffered as a whole.
+ * Only the header is decoded incrementally. nanopb cannot suspend pb_decode() when a packet ends and resume it with
+ * the next one, so the payload is left encoded: a handler that needs the payload message buffers the chunks of the
+ * directives it routes, up to the size of their payload type, and decodes them with pb_decode() from onComplete.
+ * @sa DirectiveStream_init().
+ * @sa DirectiveStream_feed().
+ * @sa DirectiveStream_finish().
+ */
+typedef struct {
+    directive_handler_t const *handler;
+    void *context;
+    directive_stream_state_t state;
+    /// Number of bytes of the transaction consumed so far.
+    size_t position;
+    /// End position of the transaction and of each nested message that is open.
+    size_t messageEnd[DIRECTIVE_STREAM_MAX_DEPTH + 1];
+    /// Field number of each nested message that is open.
+    uint32_t messageField[DIRECTIVE_STREAM_MAX_DEPTH];
+    size_t depth;
+    uint64_t varint;
+    uint8_t varintShift;
+    uint32_t fieldNumber;
+    size_t fieldRemaining;
+    char *string;
+    size_t stringLength;
+    bool headerComplete;
+    directive_header_t header;
+} directive_stream_t;
+
+/**
+ * Starts decoding a new directive.
+ * @param stream the decoder state.
+ * @param transactionSize the total size of the encoded directive, from the INITIAL packet.
+ * @param handler the application callbacks. All callbacks are optional.
+ * @param context passed as is to the callbacks.
+ */
+void DirectiveStream_init(directive_stream_t *stream, size_t transactionSize, directive_handler_t const *handler,
+                          void *context);
+
+/**
+ * Decodes the next chunk of the encoded directive.
+ * @param stream the decoder state.
+ * @param data the chunk, typically the payload of one packet.
+ * @param size the chunk size in bytes.
+ * @return false if the directive is malformed. The decoder then ignores any further data.
+ */
+bool DirectiveStream_feed(directive_stream_t *stream, uint8_t const *data, size_t size);
+
+/**
+ * Completes decoding once all of the directive has been fed, and calls the onComplete callback.
+ * @param stream the decoder state.
+ * @return false if the directive is malformed or incomplete.
+ */
+bool DirectiveStream_finish(directive_stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_DIRECTIVE_STREAM_H
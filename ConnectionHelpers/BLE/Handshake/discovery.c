@@ -0,0 +1,181 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "alexaDiscoveryDiscoverResponseEvent.pb.h"
+#include "allocator.h"
+#include "discovery.h"
+#include "mbedtls/sha256.h"
+#include "pb.h"
+#include "pb_encode.h"
+
+typedef alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints endpoint_proto_t;
+typedef alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities capability_proto_t;
+typedef alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities_Configuration_SupportedTypes
+        supported_type_proto_t;
+
+#define capability_proto_fields alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities_fields
+#define capability_proto_init_default \
+    alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities_init_default
+#define supported_type_proto_fields \
+    alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities_Configuration_SupportedTypes_fields
+#define supported_type_proto_init_default \
+    alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_Capabilities_Configuration_SupportedTypes_init_default
+
+bool DiscoveryEndpoint_computeDeviceToken(char const *const endpointId, char const *const deviceSecret,
+                                          char token[DEVICE_TOKEN_SIZE]) {
+    mbedtls_sha256_context context;
+    uint8_t digest[32];
+
+    mbedtls_sha256_init(&context);
+    bool status = mbedtls_sha256_starts_ret(&context, 0) == 0
+                  && mbedtls_sha256_update_ret(&context, (uint8_t const *) endpointId, strlen(endpointId)) == 0
+                  && mbedtls_sha256_update_ret(&context, (uint8_t const *) deviceSecret, strlen(deviceSecret)) == 0
+                  && mbedtls_sha256_finish_ret(&context, digest) == 0;
+    mbedtls_sha256_free(&context);
+    if (!status) {
+        fprintf(stderr, "Error calculating sha-256 of the device token\n");
+        return false;
+    }
+
+    static char const hexDigits[] = "0123456789abcdef";
+    for (size_t index = 0; index < sizeof(digest); index++) {
+        token[2 * index] = hexDigits[digest[index] >> 4U];
+        token[2 * index + 1] = hexDigits[digest[index] & 0x0FU];
+    }
+    token[DEVICE_TOKEN_SIZE - 1] = '\0';
+    return true;
+}
+
+// Copies an optional string into a fixed size field of the generated struct.
+static bool copyField(char *const dst, size_t dstSize, char const *const src, char const *const name) {
+    if (!src) {
+        dst[0] = '\0';
+        return true;
+    }
+    size_t length = strlen(src);
+    if (length >= dstSize) {
+        fprintf(stderr, "%s: %s is %zu bytes long, at most %zu are supported\n", __FUNCTION__, name, length,
+                dstSize - 1);
+        return false;
+    }
+    memcpy(dst, src, length + 1);
+    return true;
+}
+
+#define COPY_FIELD(dst, src) copyField((dst), sizeof(dst), (src), #src)
+
+// Encodes the supported types of a capability straight from the endpoint's table.
+static bool encodeSupportedTypes(pb_ostream_t *const stream, pb_field_t const *const field, void *const *const arg) {
+    discovery_capability_t const *const capability = *arg;
+    for (size_t index = 0; index < capability->numSupportedTypes; index++) {
+        supported_type_proto_t proto = supported_type_proto_init_default;
+        if (!COPY_FIELD(proto.name, capability->supportedTypes[index])) {
+            PB_RETURN_ERROR(stream, "supported type too long");
+        }
+        if (!pb_encode_tag_for_field(stream, field)
+            || !pb_encode_submessage(stream, supported_type_proto_fields, &proto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Encodes the capabilities straight from the endpoint's table. Only the capability being encoded is held in RAM.
+static bool encodeCapabilities(pb_ostream_t *const stream, pb_field_t const *const field, void *const *const arg) {
+    discovery_endpoint_t const *const endpoint = *arg;
+    for (size_t index = 0; index < endpoint->numCapabilities; index++) {
+        discovery_capability_t const *const capability = &endpoint->capabilities[index];
+        capability_proto_t proto = capability_proto_init_default;
+        if (!COPY_FIELD(proto.type, capability->type) || !COPY_FIELD(proto.interface, capability->interface)
+            || !COPY_FIELD(proto.version, capability->version)) {
+            PB_RETURN_ERROR(stream, "capability string too long");
+        }
+        // Without a callback, the configuration is empty and is left out of the event.
+        if (capability->numSupportedTypes > 0) {
+            proto.configuration.supportedTypes.funcs.encode = encodeSupportedTypes;
+            proto.configuration.supportedTypes.arg = (void *) capability;
+        }
+        if (!pb_encode_tag_for_field(stream, field) || !pb_encode_submessage(stream, capability_proto_fields, &proto)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DiscoveryResponse_fill(discovery_endpoint_t const *const endpoint,
+                            alexaDiscovery_DiscoverResponseEventProto *const event) {
+    if (endpoint->numCapabilities > DISCOVERY_MAX_CAPABILITIES) {
+        fprintf(stderr, "%s: %zu capabilities, at most %u are supported\n", __FUNCTION__, endpoint->numCapabilities,
+                DISCOVERY_MAX_CAPABILITIES);
+        return false;
+    }
+    for (size_t index = 0; index < endpoint->numCapabilities; index++) {
+        if (endpoint->capabilities[index].numSupportedTypes > DISCOVERY_MAX_SUPPORTED_TYPES) {
+            fprintf(stderr, "%s: %zu supported types, at most %u are supported\n", __FUNCTION__,
+                    endpoint->capabilities[index].numSupportedTypes, DISCOVERY_MAX_SUPPORTED_TYPES);
+            return false;
+        }
+    }
+
+    // Same as alexaDiscovery_DiscoverResponseEventProto_init_default: all strings empty and no callbacks.
+    memset(event, 0, sizeof(*event));
+    strcpy(event->event.header.namespace, "Alexa.Discovery");
+    strcpy(event->event.header.name, "Discover.Response");
+
+    event->event.payload.endpoints_count = 1;
+    endpoint_proto_t *const proto = &event->event.payload.endpoints[0];
+    if (!COPY_FIELD(proto->endpointId, endpoint->endpointId)
+        || !COPY_FIELD(proto->friendlyName, endpoint->friendlyName)
+        || !COPY_FIELD(proto->description, endpoint->description)
+        || !COPY_FIELD(proto->manufacturerName, endpoint->manufacturerName)) {
+        return false;
+    }
+    proto->capabilities.funcs.encode = encodeCapabilities;
+    proto->capabilities.arg = (void *) endpoint;
+
+    alexaDiscovery_DiscoverResponseEventPayloadProto_Endpoints_AdditionalIdentification *const identification =
+            &proto->additionalIdentification;
+    return COPY_FIELD(identification->firmwareVersion, endpoint->firmwareVersion)
+           && COPY_FIELD(identification->deviceToken, endpoint->deviceToken)
+           && COPY_FIELD(identification->deviceTokenEncryptionType, endpoint->deviceTokenEncryptionType)
+           && COPY_FIELD(identification->amazonDeviceType, endpoint->amazonDeviceType)
+           && COPY_FIELD(identification->modelName, endpoint->modelName)
+           && COPY_FIELD(identification->radioAddress, endpoint->radioAddress);
+}
+
+uint8_t *DiscoveryResponse_encode(discovery_endpoint_t const *const endpoint,
+                                  gadget_allocator_t const *const allocator, size_t *const encodedSize) {
+    *encodedSize = 0;
+    alexaDiscovery_DiscoverResponseEventProto event;
+    size_t size;
+    if (!DiscoveryResponse_fill(endpoint, &event)) {
+        return NULL;
+    }
+    // Size the message first, so that the buffer is neither a worst case guess nor too small for many capabilities.
+    if (!pb_get_encoded_size(&size, alexaDiscovery_DiscoverResponseEventProto_fields, &event)) {
+        fprintf(stderr, "%s: Error sizing message\n", __FUNCTION__);
+        return NULL;
+    }
+    uint8_t *const buffer = GadgetAllocator_alloc(allocator, size);
+    if (!buffer) {
+        fprintf(stderr, "%s: Failed to allocate %zu bytes\n", __FUNCTION__, size);
+        return NULL;
+    }
+    pb_ostream_t stream = pb_ostream_from_buffer(buffer, size);
+    if (!pb_encode(&stream, alexaDiscovery_DiscoverResponseEventProto_fields, &event)) {
+        fprintf(stderr, "%s: Error encoding message: %s\n", __FUNCTION__, PB_GET_ERROR(&stream));
+        GadgetAllocator_free(allocator, buffer);
+        return NULL;
+    }
+    *encodedSize = size;
+    return buffer;
+}
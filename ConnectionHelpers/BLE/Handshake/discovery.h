@@ -0,0 +1,103 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_DISCOVERY_H
+#define ALEXA_GADGETS_SAMPLE_CODE_DISCOVERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alexaDiscoveryDiscoverResponseEvent.pb.h"
+#include "allocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Maximum number of capabilities of an endpoint, as supported on Echo devices.
+#define DISCOVERY_MAX_CAPABILITIES (32U)
+/// Maximum number of supported types of a capability, as supported on Echo devices.
+#define DISCOVERY_MAX_SUPPORTED_TYPES (10U)
+
+/// Size of a device token: the SHA-256 of the endpoint id and the device secret in lower case hex, NUL terminated.
+#define DEVICE_TOKEN_SIZE (65U)
+
+/**
+ * An Alexa interface supported by the gadget, as announced in the Discover.Response event.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/alexa-discovery-interface.html#capabilities
+ */
+typedef struct {
+    char const *type;
+    char const *interface;
+    char const *version;
+    /// Names of the supported types of the interface configuration, or NULL if the interface has no configuration.
+    char const *const *supportedTypes;
+    size_t numSupportedTypes;
+} discovery_capability_t;
+
+/**
+ * Description of the gadget, from which the Discover.Response event is built.
+ * The capabilities are encoded straight from this table, so an endpoint can be a const table in flash and the
+ * encoder only holds one capability in RAM at a time. NULL strings are left out of the event.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/alexa-discovery-interface.html#discover-response-event
+ */
+typedef struct {
+    char const *endpointId;
+    char const *friendlyName;
+    char const *description;
+    char const *manufacturerName;
+    discovery_capability_t const *capabilities;
+    size_t numCapabilities;
+    char const *firmwareVersion;
+    /// Computed once with DiscoveryEndpoint_computeDeviceToken(), or provisioned with the device secret.
+    char const *deviceToken;
+    char const *deviceTokenEncryptionType;
+    char const *amazonDeviceType;
+    char const *modelName;
+    char const *radioAddress;
+} discovery_endpoint_t;
+
+/**
+ * Computes the device token of an endpoint: the SHA-256 of the endpoint id followed by the device secret, in hex.
+ * The token does not change for the lifetime of the gadget, so compute it once, e.g. at boot, and reference it from
+ * discovery_endpoint_t::deviceToken. See ConnectionHelpers/DeviceSecret.
+ * @param endpointId the endpoint id, i.e. the serial number of the gadget.
+ * @param deviceSecret the device secret received from the developer portal when the gadget was registered.
+ * @param token receives the token.
+ * @return false if the hash could not be computed.
+ */
+bool DiscoveryEndpoint_computeDeviceToken(char const *endpointId, char const *deviceSecret,
+                                          char token[DEVICE_TOKEN_SIZE]);
+
+/**
+ * Fills a Discover.Response event from an endpoint descriptor.
+ * The capabilities and supported types are FT_CALLBACK fields in this folder's .options file: they are not copied into
+ * the event, but encoded from the endpoint by nanopb callbacks, so the event is only a few hundred bytes.
+ * @param endpoint the endpoint. It must outlive the encoding of the event.
+ * @param event the event to fill.
+ * @return false if the endpoint has more capabilities or supported types than Echo devices support, or if a string
+ * is longer than the event can hold. Capability strings are checked while the event is encoded.
+ */
+bool DiscoveryResponse_fill(discovery_endpoint_t const *endpoint, alexaDiscovery_DiscoverResponseEventProto *event);
+
+/**
+ * Encodes a Discover.Response event into a buffer allocated with the exact encoded size.
+ * @param endpoint the endpoint.
+ * @param allocator allocates the returned buffer. NULL for the default allocator.
+ * @param encodedSize receives the size of the returned buffer.
+ * @return the encoded event, to be released with GadgetAllocator_free(), or NULL on failure.
+ */
+uint8_t *DiscoveryResponse_encode(discovery_endpoint_t const *endpoint, gadget_allocator_t const *allocator,
+                                  size_t *encodedSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_DISCOVERY_H
@@ -0,0 +1,134 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define fsync _commit
+#else
+#include <unistd.h>
+#endif
+
+#include "flash_backend.h"
+
+#define FILE_FLASH_PATH_SIZE (256U)
+// Component names cannot start with a '.', so the journal never collides with a component.
+#define FILE_FLASH_JOURNAL_NAME ".ota_journal"
+
+static bool fileFlashOpen(void *context, char const *componentName, bool erase) {
+    file_flash_t *const flash = context;
+    // The name comes from the peer, so it must not reach outside of the directory, with either path separator.
+    if (componentName[0] == '\0' || componentName[0] == '.' || strchr(componentName, '/') != NULL ||
+        strchr(componentName, '\\') != NULL) {
+        fprintf(stderr, "Invalid component name [%s]\n", componentName);
+        return false;
+    }
+    char path[FILE_FLASH_PATH_SIZE];
+    int length = snprintf(path, sizeof(path), "%s/%s", flash->directory, componentName);
+    if (length < 0 || (size_t) length >= sizeof(path)) {
+        fprintf(stderr, "Component path too long [%s]\n", componentName);
+        return false;
+    }
+    FileFlash_close(flash);
+    // Truncate the file when the component starts over, so a smaller component does not keep the tail of the previous
+    // one. Otherwise keep the data already written, as a flash partition does.
+    flash->file = erase ? NULL : fopen(path, "r+b");
+    if (!flash->file) {
+        flash->file = fopen(path, "w+b");
+    }
+    if (!flash->file) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+static bool fileFlashWrite(void *context, uint32_t offset, uint8_t const *data, size_t size) {
+    file_flash_t *const flash = context;
+    if (!flash->file || fseek(flash->file, (long) offset, SEEK_SET) != 0) {
+        return false;
+    }
+    return fwrite(data, 1, size, flash->file) == size;
+}
+
+static bool fileFlashSync(void *context) {
+    file_flash_t *const flash = context;
+    if (!flash->file) {
+        return false;
+    }
+    return fflush(flash->file) == 0 && fsync(fileno(flash->file)) == 0;
+}
+
+static bool fileFlashSaveJournal(void *context, uint8_t const *data, size_t size) {
+    file_flash_t *const flash = context;
+    char path[FILE_FLASH_PATH_SIZE], newPath[FILE_FLASH_PATH_SIZE];
+    int length = snprintf(path, sizeof(path), "%s/" FILE_FLASH_JOURNAL_NAME, flash->directory);
+    int newLength = snprintf(newPath, sizeof(newPath), "%s/" FILE_FLASH_JOURNAL_NAME ".new", flash->directory);
+    if (length < 0 || (size_t) length >= sizeof(path) || newLength < 0 || (size_t) newLength >= sizeof(newPath)) {
+        return false;
+    }
+    if (size == 0) {
+        return remove(path) == 0 || errno == ENOENT;
+    }
+    // Write the new journal aside and rename it over the previous one, so that a power loss leaves one of them whole.
+    FILE *file = fopen(newPath, "wb");
+    if (!file) {
+        perror(newPath);
+        return false;
+    }
+    bool written = fwrite(data, 1, size, file) == size && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = fclose(file) == 0 && written;
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    remove(path);
+#endif
+    if (!written || rename(newPath, path) != 0) {
+        perror(path);
+        remove(newPath);
+        return false;
+    }
+    return true;
+}
+
+static bool fileFlashLoadJournal(void *context, uint8_t *data, size_t size) {
+    file_flash_t *const flash = context;
+    char path[FILE_FLASH_PATH_SIZE];
+    int length = snprintf(path, sizeof(path), "%s/" FILE_FLASH_JOURNAL_NAME, flash->directory);
+    if (length < 0 || (size_t) length >= sizeof(path)) {
+        return false;
+    }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    // Read one more byte to reject a journal of another size.
+    uint8_t extra;
+    bool read = fread(data, 1, size, file) == size && fread(&extra, 1, 1, file) == 0;
+    fclose(file);
+    return read;
+}
+
+void FileFlash_init(file_flash_t *const flash, char const *const directory) {
+    flash->directory = directory;
+    flash->file = NULL;
+    flash->backend = (flash_backend_t) {fileFlashOpen, fileFlashWrite, fileFlashSync, fileFlashSaveJournal,
+                                        fileFlashLoadJournal, flash};
+}
+
+flash_backend_t const *FileFlash_getBackend(file_flash_t *const flash) {
+    return &flash->backend;
+}
+
+void FileFlash_close(file_flash_t *const flash) {
+    if (flash->file) {
+        fclose(flash->file);
+        flash->file = NULL;
+    }
+}
@@ -0,0 +1,83 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_FLASH_BACKEND_H
+#define ALEXA_GADGETS_SAMPLE_CODE_FLASH_BACKEND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Storage the firmware components received over OTA are written to, e.g. the update partition of the gadget flash.
+ * Offsets are relative to the start of the component. A NOR flash backend erases each sector as the first write
+ * reaches it.
+ * The journal callbacks are optional. When set, the receiver records its progress in a small journal after each
+ * segment, so that an interrupted update resumes where it stopped. A NOR flash backend typically alternates between
+ * two journal sectors.
+ * @sa OtaReceiver_init().
+ * @sa FileFlash_getBackend().
+ */
+typedef struct {
+    /// Selects the storage of a component before it is written. If \p erase is set, the component is written from its
+    /// start and the data already stored for it, including past the end of the new data, is dropped. Otherwise that
+    /// data is kept, to resume an update.
+    bool (*open)(void *context, char const *componentName, bool erase);
+    /// Programs \p size bytes at \p offset of the open component.
+    bool (*write)(void *context, uint32_t offset, uint8_t const *data, size_t size);
+    /// Makes the data written so far persistent.
+    bool (*sync)(void *context);
+    /// Replaces the journal with \p size bytes, or erases it if \p size is 0. After a power loss, the journal read back
+    /// is either the previous one or the new one.
+    bool (*saveJournal)(void *context, uint8_t const *data, size_t size);
+    /// Reads the journal into \p data. Returns false if there is none, or if it is not \p size bytes.
+    bool (*loadJournal)(void *context, uint8_t *data, size_t size);
+    void *context;
+} flash_backend_t;
+
+/**
+ * A flash_backend_t that stores each component in a file named after it, to test OTA updates on Linux. The journal is
+ * stored in the .ota_journal file, replaced by renaming a new file over it.
+ * @sa FileFlash_init().
+ * @sa FileFlash_getBackend().
+ */
+typedef struct {
+    char const *directory;
+    FILE *file;
+    flash_backend_t backend;
+} file_flash_t;
+
+/**
+ * Initializes a file backed flash.
+ * @param flash the flash to initialize.
+ * @param directory the directory the component files are created in. It must outlive the flash.
+ */
+void FileFlash_init(file_flash_t *flash, char const *directory);
+
+/**
+ * Returns the flash_backend_t interface of the file backed flash, for OtaReceiver_init().
+ * @param flash an initialized flash.
+ */
+flash_backend_t const *FileFlash_getBackend(file_flash_t *flash);
+
+/**
+ * Closes the file of the open component, if any.
+ * @param flash the flash.
+ */
+void FileFlash_close(file_flash_t *flash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_FLASH_BACKEND_H
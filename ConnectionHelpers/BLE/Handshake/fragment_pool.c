@@ -0,0 +1,148 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "fragment_pool.h"
+
+#define FRAGMENT_POOL_MAP_WORDS ((SAMPLE_TX_POOL_SIZE + 31U) / 32U)
+
+struct fragment_pool_s {
+    gadget_allocator_t const *allocator;
+    size_t bufferSize;
+    /// Bit i of word i / 32 is set while buffer i is free.
+    atomic_uint_least32_t freeMap[FRAGMENT_POOL_MAP_WORDS];
+    atomic_size_t inUse;
+    atomic_size_t highWaterMark;
+    atomic_size_t allocCount;
+    atomic_size_t exhaustedCount;
+    /// SAMPLE_TX_POOL_SIZE buffers of bufferSize bytes, back to back.
+    uint8_t buffers[];
+};
+
+// Returns the index of the lowest set bit of a non-zero word.
+static size_t getLowestBitIndex(uint_least32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (size_t) __builtin_ctzl((unsigned long) bits);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, (unsigned long) bits);
+    return (size_t) index;
+#else
+    size_t index = 0;
+    while ((bits & 1U) == 0) {
+        bits >>= 1U;
+        index++;
+    }
+    return index;
+#endif
+}
+
+static void updateHighWaterMark(fragment_pool_t *const pool, size_t inUse) {
+    size_t highWaterMark = atomic_load_explicit(&pool->highWaterMark, memory_order_relaxed);
+    while (inUse > highWaterMark &&
+           !atomic_compare_exchange_weak_explicit(&pool->highWaterMark, &highWaterMark, inUse, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+fragment_pool_t *FragmentPool_create(gadget_allocator_t const *const allocator, size_t bufferSize) {
+    if (bufferSize == 0) {
+        return NULL;
+    }
+    fragment_pool_t *const pool = GadgetAllocator_alloc(allocator,
+                                                        sizeof(fragment_pool_t) + SAMPLE_TX_POOL_SIZE * bufferSize);
+    if (!pool) {
+        fprintf(stderr, "%s: Failed to allocate %u buffers of %zu bytes\n", __FUNCTION__, SAMPLE_TX_POOL_SIZE,
+                bufferSize);
+        return NULL;
+    }
+    pool->allocator = allocator;
+    pool->bufferSize = bufferSize;
+    for (size_t word = 0; word < FRAGMENT_POOL_MAP_WORDS; word++) {
+        size_t numBuffers = MIN(SAMPLE_TX_POOL_SIZE - word * 32U, 32U);
+        uint_least32_t freeBits = (numBuffers == 32U) ? UINT32_MAX : ((UINT32_C(1) << numBuffers) - 1U);
+        atomic_init(&pool->freeMap[word], freeBits);
+    }
+    atomic_init(&pool->inUse, 0);
+    atomic_init(&pool->highWaterMark, 0);
+    atomic_init(&pool->allocCount, 0);
+    atomic_init(&pool->exhaustedCount, 0);
+    return pool;
+}
+
+void FragmentPool_destroy(fragment_pool_t *const pool) {
+    if (!pool) return;
+    if (atomic_load_explicit(&pool->inUse, memory_order_relaxed) != 0) {
+        fprintf(stderr, "%s: buffers of the pool are still in use\n", __FUNCTION__);
+    }
+    GadgetAllocator_free(pool->allocator, pool);
+}
+
+uint8_t *FragmentPool_alloc(fragment_pool_t *const pool) {
+    for (size_t word = 0; word < FRAGMENT_POOL_MAP_WORDS; word++) {
+        uint_least32_t freeBits = atomic_load_explicit(&pool->freeMap[word], memory_order_relaxed);
+        while (freeBits != 0) {
+            uint_least32_t bit = freeBits & (~freeBits + 1U); // Lowest free buffer.
+            // Acquire pairs with the release in FragmentPool_free(), so the previous user is done with the buffer.
+            if (atomic_compare_exchange_weak_explicit(&pool->freeMap[word], &freeBits, freeBits & ~bit,
+                                                      memory_order_acquire, memory_order_relaxed)) {
+                size_t index = word * 32U + getLowestBitIndex(bit);
+                size_t inUse = atomic_fetch_add_explicit(&pool->inUse, 1, memory_order_relaxed) + 1;
+                updateHighWaterMark(pool, inUse);
+                atomic_fetch_add_explicit(&pool->allocCount, 1, memory_order_relaxed);
+                return &pool->buffers[index * pool->bufferSize];
+            }
+            // freeBits was reloaded by the failed exchange.
+        }
+    }
+    atomic_fetch_add_explicit(&pool->exhaustedCount, 1, memory_order_relaxed);
+    return NULL;
+}
+
+void FragmentPool_free(void *const context, uint8_t *const buffer) {
+    fragment_pool_t *const pool = context;
+    uint8_t const *const first = pool->buffers;
+    if (buffer < first || buffer >= first + SAMPLE_TX_POOL_SIZE * pool->bufferSize ||
+        (size_t) (buffer - first) % pool->bufferSize != 0) {
+        fprintf(stderr, "%s: buffer does not belong to the pool\n", __FUNCTION__);
+        return;
+    }
+    size_t index = (size_t) (buffer - first) / pool->bufferSize;
+    atomic_fetch_sub_explicit(&pool->inUse, 1, memory_order_relaxed);
+    atomic_fetch_or_explicit(&pool->freeMap[index / 32U], UINT32_C(1) << (index % 32U), memory_order_release);
+}
+
+bool FragmentPool_allocPacket(fragment_pool_t *const pool, packet_t *const packet, size_t dataSize) {
+    if (dataSize > pool->bufferSize) {
+        return false;
+    }
+    uint8_t *const buffer = FragmentPool_alloc(pool);
+    if (!buffer) {
+        return false;
+    }
+    packet->data = buffer;
+    packet->dataSize = dataSize;
+    packet->release = FragmentPool_free;
+    packet->releaseContext = pool;
+    return true;
+}
+
+void FragmentPool_getStats(fragment_pool_t *const pool, fragment_pool_stats_t *const stats) {
+    stats->capacity = SAMPLE_TX_POOL_SIZE;
+    stats->bufferSize = pool->bufferSize;
+    stats->inUse = atomic_load_explicit(&pool->inUse, memory_order_relaxed);
+    stats->highWaterMark = atomic_load_explicit(&pool->highWaterMark, memory_order_relaxed);
+    stats->allocCount = atomic_load_explicit(&pool->allocCount, memory_order_relaxed);
+    stats->exhaustedCount = atomic_load_explicit(&pool->exhaustedCount, memory_order_relaxed);
+}
@@ -0,0 +1,103 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_FRAGMENT_POOL_H
+#define ALEXA_GADGETS_SAMPLE_CODE_FRAGMENT_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "common.h"
+#include "helpers.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A pool of SAMPLE_TX_POOL_SIZE buffers for TX packets, each sized for a whole packet of the connections using it.
+ * Buffers are taken from and returned to a bitmap of free buffers with atomic operations only, so buffers can be
+ * allocated on the protocol thread and released from the BLE stack's TX complete callback or interrupt without
+ * locking. The pool also keeps statistics to help size SAMPLE_TX_POOL_SIZE.
+ * The pool is opaque so that its atomic state stays out of this header, which C++ code can include as well.
+ * @sa FragmentPool_create().
+ * @sa GadgetSession_setTxPool().
+ */
+typedef struct fragment_pool_s fragment_pool_t;
+
+/**
+ * Statistics of a fragment_pool_t.
+ */
+typedef struct {
+    /// Number of buffers in the pool.
+    size_t capacity;
+    /// Size of each buffer in bytes.
+    size_t bufferSize;
+    /// Number of buffers currently allocated.
+    size_t inUse;
+    /// Largest number of buffers allocated at the same time.
+    size_t highWaterMark;
+    /// Number of successful allocations.
+    size_t allocCount;
+    /// Number of allocations that failed because every buffer was in use.
+    size_t exhaustedCount;
+} fragment_pool_stats_t;
+
+/**
+ * Creates a pool with all of its buffers free, in a single allocation.
+ * @param allocator the allocator of the pool, or NULL for the default gadget allocator.
+ * @param bufferSize the size of each buffer: the largest maxPacketSize of the sessions using the pool, i.e. their
+ * ATT MTU less ATT_HEADER_SIZE. Larger packets are allocated from the session allocator instead.
+ * @return the pool, to be released with FragmentPool_destroy(), or NULL if the allocation failed.
+ */
+fragment_pool_t *FragmentPool_create(gadget_allocator_t const *allocator, size_t bufferSize);
+
+/**
+ * Releases a pool. None of its buffers may still be in use.
+ * @param pool the pool to release. NULL is ignored.
+ */
+void FragmentPool_destroy(fragment_pool_t *pool);
+
+/**
+ * Takes a free buffer from the pool.
+ * @param pool the pool to allocate from.
+ * @return a buffer of the size the pool was created with, or NULL if all buffers are in use.
+ */
+uint8_t *FragmentPool_alloc(fragment_pool_t *pool);
+
+/**
+ * Returns a buffer to the pool. It has the signature of a packet_release_t, with the pool as context.
+ * @param context the pool the buffer was allocated from.
+ * @param buffer a buffer returned by FragmentPool_alloc().
+ */
+void FragmentPool_free(void *context, uint8_t *buffer);
+
+/**
+ * Allocates the data of a TX packet from the pool and sets the packet's release hook, so that freePacket() returns
+ * the buffer to the pool.
+ * @param pool the pool to allocate from.
+ * @param packet the packet to set up.
+ * @param dataSize the packet size, at most the buffer size of the pool.
+ * @return false if the packet is too large or the pool is exhausted. The packet is left unchanged in that case.
+ */
+bool FragmentPool_allocPacket(fragment_pool_t *pool, packet_t *packet, size_t dataSize);
+
+/**
+ * Reads the statistics of the pool.
+ * @param pool the pool.
+ * @param stats receives the statistics.
+ */
+void FragmentPool_getStats(fragment_pool_t *pool, fragment_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_FRAGMENT_POOL_H
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "allocator.h"
 #include "common.h"
 #include "helpers.h"
 
@@ -35,49 +36,56 @@ void printHexBuffer(uint8_t const *const buf, size_t const bufSize, int const in
     }
 }
 
-packet_list_t *PacketList_addToTail(packet_list_t *const list, packet_t const *const packet) {
-    if (packet == NULL) return list;
+bool PacketQueue_push(packet_queue_t *const queue, packet_t const *const packet) {
+    if (packet == NULL) return true;
     if (packet->data == NULL)
-        return list;
-    packet_list_t *node = malloc(sizeof(packet_list_t));
+        return true;
+    packet_list_t *node = GadgetAllocator_alloc(NULL, sizeof(packet_list_t));
     if (!node) {
-        return list;
+        packet_t released = *packet;
+        freePacket(&released);
+        return false;
     }
     node->packet = *packet;
     node->next = NULL;
 
-    packet_list_t *tail = list;
-    while (tail && tail->next) {
-        tail = tail->next;
-    }
-    if (tail) {
-        tail->next = node;
-        return list;
+    if (queue->tail) {
+        queue->tail->next = node;
     } else {
-        return node;
+        queue->head = node;
     }
+    queue->tail = node;
+    queue->size++;
+    return true;
 }
 
-packet_list_t *PacketList_appendList(packet_list_t *dst, packet_list_t *src) {
-    if (src == NULL) return dst;
-    if (dst == NULL) return src;
-
-    packet_list_t *tail = dst;
-    while (tail->next != NULL) {
-        tail = tail->next;
+void PacketQueue_append(packet_queue_t *const dst, packet_queue_t *const src) {
+    if (src->head == NULL) return;
+    if (dst->tail) {
+        dst->tail->next = src->head;
+    } else {
+        dst->head = src->head;
     }
-    // Append the src list.
-    tail->next = src;
-    return dst;
+    dst->tail = src->tail;
+    dst->size += src->size;
+    src->head = NULL;
+    src->tail = NULL;
+    src->size = 0;
+}
+
+void PacketQueue_free(packet_queue_t *const queue) {
+    PacketList_freeList(queue->head);
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->size = 0;
 }
 
 void PacketList_freeList(packet_list_t *list) {
     while (list) {
         packet_list_t *temp = list;
         list = list->next;
-        if (temp->packet.data)
-            free(temp->packet.data);
-        free(temp);
+        freePacket(&temp->packet);
+        GadgetAllocator_free(NULL, temp);
     }
 }
 
@@ -103,7 +111,11 @@ void PacketList_PrintAll(packet_list_t const *const list) {
 
 void freePacket(packet_t *packet) {
     if (packet->data != NULL) {
-        free(packet->data);
+        if (packet->release) {
+            packet->release(packet->releaseContext, packet->data);
+        } else {
+            GadgetAllocator_free(NULL, packet->data);
+        }
         packet->data = NULL;
         packet->dataSize = 0;
     }
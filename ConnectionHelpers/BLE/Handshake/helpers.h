@@ -9,6 +9,7 @@
 #ifndef ALEXA_GADGETS_SAMPLE_CODE_HELPERS_H
 #define ALEXA_GADGETS_SAMPLE_CODE_HELPERS_H
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "common.h"
@@ -21,20 +22,50 @@ extern "C" {
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #define ARRAY_SIZE(a) (sizeof((a))/sizeof((a)[0]))
 
+/**
+ * Returns the data of a packet to the allocator it came from.
+ * @param context the releaseContext of the packet.
+ * @param data the data of the packet.
+ */
+typedef void (*packet_release_t)(void *context, uint8_t *data);
+
 /**
  * Represents a single packet that is exchanged between Echo device and the gadget.
- * The data member need to be malloced on the heap and can be freed using freePacket().
+ * The data member need to be allocated with the default gadget allocator (see allocator.h), or come with a release
+ * hook, and can be freed using freePacket().
  * @sa freePacket().
  */
 typedef struct {
     size_t dataSize;
     uint8_t *data;
+    /// Called by freePacket() to release the data. NULL if the data came from the default gadget allocator.
+    packet_release_t release;
+    void *releaseContext;
 } packet_t;
 
+/**
+ * Maximum size of a stream packet header: 2 bytes of stream, transaction and sequence bits, 3 bytes carried by
+ * INITIAL packets only (reserved and total transaction length) and up to 2 bytes of payload length.
+ */
+#define STREAM_PACKET_HEADER_MAX_SIZE (7U)
+
+/**
+ * Describes a single stream packet without copying its payload, so that it can be handed to a BLE stack that
+ * supports gather writes. The packet on air is the \p headerSize bytes of \p header followed by the
+ * \p payloadSize bytes at \p payload. The payload pointer refers to the caller's encoded buffer and is only valid
+ * for as long as that buffer is.
+ * @sa StreamFragmenter_next().
+ */
+typedef struct {
+    uint8_t header[STREAM_PACKET_HEADER_MAX_SIZE];
+    size_t headerSize;
+    uint8_t const *payload;
+    size_t payloadSize;
+} fragment_t;
+
 /**
  * A linked list of packets.
- * @sa PacketList_addToTail.
- * @sa PacketList_appendList.
+ * @sa packet_queue_t.
  * @sa PacketList_PrintAll.
  * @sa PacketList_freeList.
  */
@@ -44,25 +75,42 @@ typedef struct packet_list_s {
 } packet_list_t;
 
 /**
- * Creates (or appends a packet to) a linked list of packet.
- * @param list set to NULL to create a new list, otherwise it appends to the tail of the linked list
- * pointed to by \p list.
+ * A FIFO queue of packets, backed by a packet_list_t with a tail pointer so that appending is O(1).
+ * A zero-initialized queue is empty. The queue owns the data of the packets pushed to it.
+ * @sa PacketQueue_push.
+ * @sa PacketQueue_append.
+ * @sa PacketQueue_free.
+ */
+typedef struct {
+    packet_list_t *head;
+    packet_list_t *tail;
+    size_t size;
+} packet_queue_t;
+
+/**
+ * Appends a packet to the tail of the queue.
+ * @param queue the queue to append to.
  * @param packet a pointer to a packet structure. This can be allocated on the stack.
- * A copy of the content of the packet structure is duplicated and saved in the list.
- * The data pointer of the packet structure must be malloced on the heap and it is not duplicated.
- * @return  returns a pointer to the new list head if a new list has been created, or the same value as
- * \p list value if the a new \p packet was appended. If \p packet is NULL, the value of \p list is returned as is.
+ * A copy of the content of the packet structure is duplicated and saved in the queue.
+ * The data pointer of the packet structure must come from the default gadget allocator, or come with a release hook,
+ * and it is not duplicated. A packet without data is ignored.
+ * @return false if the queue node could not be allocated. The packet data is freed in that case, so the caller
+ * never keeps ownership of it.
+ */
+bool PacketQueue_push(packet_queue_t *queue, packet_t const *packet);
+
+/**
+ * Moves all packets of the \p src queue to the tail of the \p dst queue.
+ * @param dst the destination queue.
+ * @param src the source queue. It is empty afterwards.
  */
-packet_list_t *PacketList_addToTail(packet_list_t *list, packet_t const *packet);
+void PacketQueue_append(packet_queue_t *dst, packet_queue_t *src);
 
 /**
- * Appends the \p src packet list to the tail of the \p dst packet list.
- * @param dst the dst packet list.
- * @param src the source list.
- * @return if src is NULL it returns dst. If dst is a NULL list, it returns the src list,
- * otherwise, it appends the src list to the dst list.
+ * Frees all packets in the queue along with their underlying data buffers, and leaves the queue empty.
+ * @param queue the queue to free.
  */
-packet_list_t *PacketList_appendList(packet_list_t *dst, packet_list_t *src);
+void PacketQueue_free(packet_queue_t *queue);
 
 /**
  * Prints hexdump of the contents of all packets in the list.
@@ -83,7 +131,7 @@ void PacketList_freeList(packet_list_t *list);
 size_t PacketList_getSize(packet_list_t const *list);
 
 /**
- * Free a single packet along with its data buffer.
+ * Free a single packet along with its data buffer, through the packet's release hook if it has one.
  * @param packet the packet to free.
  */
 void freePacket(packet_t *packet);
@@ -96,7 +144,7 @@ void freePacket(packet_t *packet);
 void printPacket(packet_t const *packet, int indentSize);
 
 /**
- * Maps a Gadgets stream id to a continuous array index.
+ * Maps a Gadgets stream id to a continuous array index in [0, NUM_STREAMS).
  * @param streamId value as enumerated in stream_id_t.
  * @return the array index value or -1 if the \p streamId value is not valid.
  */
@@ -0,0 +1,338 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "helpers.h"
+#include "ota.h"
+
+#define OTA_JOURNAL_MAGIC (0x4A41544FU)
+
+void OtaReceiver_init(ota_receiver_t *const receiver, flash_backend_t const *const flash) {
+    memset(receiver, 0, sizeof(*receiver));
+    receiver->flash = flash;
+    mbedtls_sha256_init(&receiver->componentHash);
+    mbedtls_sha256_init(&receiver->segmentHash);
+    mbedtls_sha256_init(&receiver->segmentStartHash);
+}
+
+static int hexDigitValue(char digit) {
+    if (digit >= '0' && digit <= '9') return digit - '0';
+    if (digit >= 'a' && digit <= 'f') return digit - 'a' + 10;
+    if (digit >= 'A' && digit <= 'F') return digit - 'A' + 10;
+    return -1;
+}
+
+// Parses a signature, the SHA-256 in hex.
+static bool parseSignature(char const *const signature, uint8_t digest[OTA_DIGEST_SIZE]) {
+    if (strnlen(signature, OTA_SIGNATURE_SIZE) != 2 * OTA_DIGEST_SIZE) {
+        return false;
+    }
+    for (size_t index = 0; index < OTA_DIGEST_SIZE; index++) {
+        int high = hexDigitValue(signature[2 * index]);
+        int low = hexDigitValue(signature[2 * index + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        digest[index] = (uint8_t) (high << 4U | low);
+    }
+    return true;
+}
+
+static ota_result_t writeFlash(ota_receiver_t *const receiver, uint8_t const *data, size_t size) {
+    if (!receiver->flash->write(receiver->flash->context, receiver->blockOffset, data, size)) {
+        fprintf(stderr, "OTA flash write failed :: Component [%s] :: Offset [%u] :: Size [%zu]\n",
+                receiver->componentName, receiver->blockOffset, size);
+        return OTA_RESULT_FLASH_ERROR;
+    }
+    receiver->writeCount++;
+    receiver->blockOffset += size;
+    return OTA_RESULT_OK;
+}
+
+static ota_result_t flushBlock(ota_receiver_t *const receiver) {
+    if (receiver->blockSize == 0) {
+        return OTA_RESULT_OK;
+    }
+    ota_result_t result = writeFlash(receiver, receiver->block, receiver->blockSize);
+    receiver->blockSize = 0;
+    return result;
+}
+
+static void putUint32(uint8_t *const data, uint32_t value) {
+    data[0] = (uint8_t) value;
+    data[1] = (uint8_t) (value >> 8U);
+    data[2] = (uint8_t) (value >> 16U);
+    data[3] = (uint8_t) (value >> 24U);
+}
+
+static uint32_t getUint32(uint8_t const *const data) {
+    return (uint32_t) data[0] | (uint32_t) data[1] << 8U | (uint32_t) data[2] << 16U | (uint32_t) data[3] << 24U;
+}
+
+static uint32_t computeCrc32(uint8_t const *data, size_t size) {
+    uint32_t crc = 0xFFFFFFFFU;
+    while (size-- > 0) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1U) ^ (0xEDB88320U & -(crc & 1U));
+        }
+    }
+    return ~crc;
+}
+
+// Records the component received so far, once its data is persistent, so that a journal never covers data that a
+// power loss could drop.
+static ota_result_t saveJournal(ota_receiver_t *const receiver) {
+    flash_backend_t const *const flash = receiver->flash;
+    if (!flash->saveJournal) {
+        return OTA_RESULT_OK;
+    }
+    mbedtls_sha256_context const *const hash = &receiver->componentHash;
+    uint8_t journal[OTA_JOURNAL_SIZE];
+    uint8_t *cursor = journal;
+    putUint32(cursor, OTA_JOURNAL_MAGIC);
+    cursor += 4;
+    strncpy((char *) cursor, receiver->componentName, OTA_COMPONENT_NAME_SIZE);
+    cursor += OTA_COMPONENT_NAME_SIZE;
+    putUint32(cursor, receiver->componentReceived);
+    cursor += 4;
+    for (size_t index = 0; index < 2; index++, cursor += 4) {
+        putUint32(cursor, hash->total[index]);
+    }
+    for (size_t index = 0; index < 8; index++, cursor += 4) {
+        putUint32(cursor, hash->state[index]);
+    }
+    memcpy(cursor, hash->buffer, sizeof(hash->buffer));
+    cursor += sizeof(hash->buffer);
+    putUint32(cursor, computeCrc32(journal, (size_t) (cursor - journal)));
+    if (!flash->sync(flash->context) || !flash->saveJournal(flash->context, journal, sizeof(journal))) {
+        fprintf(stderr, "OTA journal not saved :: Component [%s] :: Offset [%u]\n", receiver->componentName,
+                receiver->componentReceived);
+        return OTA_RESULT_FLASH_ERROR;
+    }
+    receiver->journalCount++;
+    return OTA_RESULT_OK;
+}
+
+bool OtaReceiver_resume(ota_receiver_t *const receiver) {
+    flash_backend_t const *const flash = receiver->flash;
+    uint8_t journal[OTA_JOURNAL_SIZE];
+    if (!flash->loadJournal || !flash->loadJournal(flash->context, journal, sizeof(journal))) {
+        return false;
+    }
+    if (getUint32(journal) != OTA_JOURNAL_MAGIC ||
+        getUint32(&journal[OTA_JOURNAL_SIZE - 4]) != computeCrc32(journal, OTA_JOURNAL_SIZE - 4)) {
+        fprintf(stderr, "OTA journal corrupted\n");
+        return false;
+    }
+    uint8_t const *cursor = &journal[4];
+    char componentName[OTA_COMPONENT_NAME_SIZE];
+    memcpy(componentName, cursor, sizeof(componentName));
+    cursor += OTA_COMPONENT_NAME_SIZE;
+    uint32_t componentReceived = getUint32(cursor);
+    cursor += 4;
+    // The hash covers the whole component received, which is less than 4 GB.
+    if (strnlen(componentName, sizeof(componentName)) == sizeof(componentName) ||
+        getUint32(cursor) != componentReceived || getUint32(cursor + 4) != 0) {
+        fprintf(stderr, "OTA journal invalid\n");
+        return false;
+    }
+    mbedtls_sha256_context *const hash = &receiver->componentHash;
+    if (mbedtls_sha256_starts_ret(hash, 0) != 0) {
+        return false;
+    }
+    for (size_t index = 0; index < 2; index++, cursor += 4) {
+        hash->total[index] = getUint32(cursor);
+    }
+    for (size_t index = 0; index < 8; index++, cursor += 4) {
+        hash->state[index] = getUint32(cursor);
+    }
+    memcpy(hash->buffer, cursor, sizeof(hash->buffer));
+
+    receiver->segmentActive = false;
+    receiver->componentOpen = false;
+    if (!flash->open(flash->context, componentName, false)) {
+        return false;
+    }
+    memcpy(receiver->componentName, componentName, sizeof(componentName));
+    receiver->componentOpen = true;
+    receiver->componentReceived = componentReceived;
+    // The segment before the resume point cannot be sent again: its start hash was not recorded.
+    receiver->segmentOffset = componentReceived;
+    receiver->resumePending = true;
+    printf("OTA resumed :: Component [%s] :: Offset [%u]\n", componentName, componentReceived);
+    return true;
+}
+
+// Drops the data of the current segment, which is then sent again from its start.
+static void abandonSegment(ota_receiver_t *const receiver) {
+    if (!receiver->segmentActive) return;
+    mbedtls_sha256_clone(&receiver->componentHash, &receiver->segmentStartHash);
+    receiver->componentReceived = receiver->segmentOffset;
+    receiver->segmentActive = false;
+}
+
+ota_result_t OtaReceiver_startSegment(ota_receiver_t *const receiver, char const *const componentName,
+                                      uint32_t componentOffset, uint32_t segmentSize,
+                                      char const *const segmentSignature) {
+    printf("OTA segment :: Component [%s] :: Offset [%u] :: Size [%u]\n", componentName, componentOffset,
+           segmentSize);
+    abandonSegment(receiver);
+    size_t nameLength = strnlen(componentName, OTA_COMPONENT_NAME_SIZE);
+    uint8_t segmentDigest[OTA_DIGEST_SIZE];
+    if (segmentSize == 0 || nameLength == OTA_COMPONENT_NAME_SIZE ||
+        (uint64_t) componentOffset + segmentSize > UINT32_MAX || !parseSignature(segmentSignature, segmentDigest)) {
+        return OTA_RESULT_INVALID;
+    }
+    bool sameComponent = receiver->componentOpen && strcmp(receiver->componentName, componentName) == 0;
+    if (receiver->resumePending) {
+        receiver->resumePending = false;
+        if (sameComponent && componentOffset != receiver->componentReceived) {
+            printf("OTA resume point :: Component [%s] :: Offset [%u]\n", componentName, receiver->componentReceived);
+            return OTA_RESULT_RESUME;
+        }
+    }
+    if (componentOffset == 0) {
+        // A new component, or the same one from the start: the data stored for it is dropped.
+        receiver->componentOpen = false;
+        if (!receiver->flash->open(receiver->flash->context, componentName, true)) {
+            return OTA_RESULT_FLASH_ERROR;
+        }
+        memcpy(receiver->componentName, componentName, nameLength + 1);
+        receiver->componentOpen = true;
+        if (mbedtls_sha256_starts_ret(&receiver->componentHash, 0) != 0) {
+            return OTA_RESULT_INVALID;
+        }
+        receiver->componentReceived = 0;
+        // The data of a previous update is overwritten from now on.
+        if (receiver->flash->saveJournal && !receiver->flash->saveJournal(receiver->flash->context, NULL, 0)) {
+            return OTA_RESULT_FLASH_ERROR;
+        }
+    } else if (sameComponent && componentOffset < receiver->componentReceived &&
+               componentOffset == receiver->segmentOffset) {
+        // The last segment is sent again: hash the component from its start again. Its data is about to be
+        // overwritten, so the journal must not cover it anymore.
+        mbedtls_sha256_clone(&receiver->componentHash, &receiver->segmentStartHash);
+        receiver->componentReceived = componentOffset;
+        ota_result_t result = saveJournal(receiver);
+        if (result != OTA_RESULT_OK) {
+            return result;
+        }
+    } else if (!sameComponent || componentOffset != receiver->componentReceived) {
+        fprintf(stderr, "OTA segment does not follow :: Offset [%u] :: Received [%u]\n", componentOffset,
+                sameComponent ? receiver->componentReceived : 0);
+        return OTA_RESULT_INVALID;
+    }
+    if (mbedtls_sha256_starts_ret(&receiver->segmentHash, 0) != 0) {
+        return OTA_RESULT_INVALID;
+    }
+    mbedtls_sha256_clone(&receiver->segmentStartHash, &receiver->componentHash);
+    memcpy(receiver->segmentDigest, segmentDigest, sizeof(segmentDigest));
+    receiver->segmentActive = true;
+    receiver->segmentOffset = componentOffset;
+    receiver->segmentSize = segmentSize;
+    receiver->segmentReceived = 0;
+    receiver->blockSize = 0;
+    receiver->blockOffset = componentOffset;
+    return OTA_RESULT_OK;
+}
+
+ota_result_t OtaReceiver_write(ota_receiver_t *const receiver, uint8_t const *data, size_t size) {
+    if (!receiver->segmentActive) {
+        fprintf(stderr, "OTA data without a segment [%zu]\n", size);
+        return OTA_RESULT_NOT_FOUND;
+    }
+    if (size > receiver->segmentSize - receiver->segmentReceived) {
+        fprintf(stderr, "OTA data exceeds the segment :: Received [%u/%u] :: Data [%zu]\n",
+                receiver->segmentReceived, receiver->segmentSize, size);
+        abandonSegment(receiver);
+        return OTA_RESULT_INVALID;
+    }
+    receiver->segmentReceived += size;
+    // Hash the data while it is at hand rather than reading it back from the flash later.
+    if (mbedtls_sha256_update_ret(&receiver->segmentHash, data, size) != 0 ||
+        mbedtls_sha256_update_ret(&receiver->componentHash, data, size) != 0) {
+        abandonSegment(receiver);
+        return OTA_RESULT_INVALID;
+    }
+    ota_result_t result = OTA_RESULT_OK;
+    while (size > 0 && result == OTA_RESULT_OK) {
+        if (receiver->blockSize == 0 && size >= SAMPLE_OTA_WRITE_BLOCK_SIZE) {
+            // Whole blocks are written straight from the packet.
+            size_t directSize = size - size % SAMPLE_OTA_WRITE_BLOCK_SIZE;
+            result = writeFlash(receiver, data, directSize);
+            data += directSize;
+            size -= directSize;
+            continue;
+        }
+        size_t copySize = MIN(SAMPLE_OTA_WRITE_BLOCK_SIZE - receiver->blockSize, size);
+        memcpy(&receiver->block[receiver->blockSize], data, copySize);
+        receiver->blockSize += copySize;
+        data += copySize;
+        size -= copySize;
+        if (receiver->blockSize == SAMPLE_OTA_WRITE_BLOCK_SIZE) {
+            result = flushBlock(receiver);
+        }
+    }
+    if (result == OTA_RESULT_OK && receiver->segmentReceived == receiver->segmentSize) {
+        result = flushBlock(receiver);
+        uint8_t digest[OTA_DIGEST_SIZE];
+        if (result == OTA_RESULT_OK && (mbedtls_sha256_finish_ret(&receiver->segmentHash, digest) != 0 ||
+                                        memcmp(digest, receiver->segmentDigest, sizeof(digest)) != 0)) {
+            fprintf(stderr, "OTA segment signature mismatch :: Component [%s] :: Offset [%u]\n",
+                    receiver->componentName, receiver->segmentOffset);
+            result = OTA_RESULT_SIGNATURE_MISMATCH;
+        }
+        if (result == OTA_RESULT_OK) {
+            receiver->componentReceived = receiver->segmentOffset + receiver->segmentSize;
+            receiver->segmentCount++;
+            receiver->segmentActive = false;
+            // The segment stays received if the journal is not saved: a resume starts before it at worst.
+            result = saveJournal(receiver);
+        }
+    }
+    if (result != OTA_RESULT_OK) {
+        abandonSegment(receiver);
+    }
+    return result;
+}
+
+ota_result_t OtaReceiver_finish(ota_receiver_t *const receiver, char const *const componentName,
+                                uint32_t componentSize, char const *const componentSignature) {
+    if (!receiver->componentOpen || receiver->segmentActive || strcmp(receiver->componentName, componentName) != 0 ||
+        receiver->componentReceived != componentSize) {
+        fprintf(stderr, "OTA component not received :: Component [%s] :: Received [%u/%u]\n", componentName,
+                receiver->componentOpen ? receiver->componentReceived : 0, componentSize);
+        return OTA_RESULT_NOT_FOUND;
+    }
+    // The component was hashed as it arrived, so only the padding is left to hash.
+    uint8_t expected[OTA_DIGEST_SIZE], digest[OTA_DIGEST_SIZE];
+    mbedtls_sha256_context componentHash;
+    mbedtls_sha256_init(&componentHash);
+    mbedtls_sha256_clone(&componentHash, &receiver->componentHash);
+    bool verified = parseSignature(componentSignature, expected) &&
+                    mbedtls_sha256_finish_ret(&componentHash, digest) == 0 &&
+                    memcmp(digest, expected, sizeof(digest)) == 0;
+    mbedtls_sha256_free(&componentHash);
+    if (!verified) {
+        fprintf(stderr, "OTA component signature mismatch :: Component [%s]\n", componentName);
+        return OTA_RESULT_SIGNATURE_MISMATCH;
+    }
+    if (!receiver->flash->sync(receiver->flash->context)) {
+        return OTA_RESULT_FLASH_ERROR;
+    }
+    receiver->resumePending = false;
+    if (receiver->flash->saveJournal && !receiver->flash->saveJournal(receiver->flash->context, NULL, 0)) {
+        fprintf(stderr, "OTA journal not erased :: Component [%s]\n", componentName);
+    }
+    printf("OTA component complete :: Component [%s] :: Size [%u] :: Segments [%zu] :: Flash writes [%zu]\n",
+           componentName, componentSize, receiver->segmentCount, receiver->writeCount);
+    return OTA_RESULT_OK;
+}
@@ -0,0 +1,153 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_OTA_H
+#define ALEXA_GADGETS_SAMPLE_CODE_OTA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "flash_backend.h"
+#include "mbedtls/sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same as the max_size of UpdateComponentSegment.component_name and FirmwareComponent.name in firmware.options.
+#define OTA_COMPONENT_NAME_SIZE (16U)
+// Size of a signature: the SHA-256 in hex, NUL terminated. Same as the max_size of the signatures in firmware.options.
+#define OTA_SIGNATURE_SIZE (65U)
+#define OTA_DIGEST_SIZE (32U)
+// Size of the journal record: magic, component name, component offset, SHA-256 byte count, state and pending block,
+// and CRC-32.
+#define OTA_JOURNAL_SIZE (4U + OTA_COMPONENT_NAME_SIZE + 4U + 8U + 32U + 64U + 4U)
+
+typedef enum {
+    OTA_RESULT_OK = 0,
+    /// The segment or the data does not follow what was received so far.
+    OTA_RESULT_INVALID,
+    /// No segment is being received, or the component to apply is not the one received.
+    OTA_RESULT_NOT_FOUND,
+    /// The flash backend failed.
+    OTA_RESULT_FLASH_ERROR,
+    /// The SHA-256 of the segment or of the component is not the one of its signature.
+    OTA_RESULT_SIGNATURE_MISMATCH,
+    /// The component was received up to componentReceived before a reconnect: the segment is not received, and the
+    /// component is sent again from there.
+    OTA_RESULT_RESUME
+} ota_result_t;
+
+/**
+ * Receives firmware components sent over OTA: the segments announced with UpdateComponentSegment commands, and their
+ * data sent on OTA_STREAM.
+ * The data is written to the flash backend as the packets arrive, through a single buffer of
+ * SAMPLE_OTA_WRITE_BLOCK_SIZE bytes, so neither the segments nor the OTA_STREAM transactions are held in RAM.
+ * The data is hashed as it arrives as well: the SHA-256 of a segment is checked against its signature as soon as its
+ * last byte is received, and the SHA-256 of the component is ready as soon as its last segment is, so the flash is
+ * never read back to verify an update.
+ * The segments of a component must be sent in order. The last segment received can be sent again, and a segment that
+ * was not received completely or whose signature does not match is sent again from its start.
+ * When the flash backend has a journal, the offset of the component verified so far and the state of its SHA-256 are
+ * recorded after each segment, once the segment is persistent. After a reboot or a reconnect, OtaReceiver_resume()
+ * restores them, and the first segment sent answers with that resume point so only the missing segments are sent.
+ * Answering with the resume point is a convention of this sample that needs a matching peer, see
+ * createResponseUpdateComponentSegmentResume().
+ * @sa OtaReceiver_init().
+ * @sa OtaReceiver_resume().
+ * @sa GadgetSession_setOtaReceiver().
+ */
+typedef struct {
+    flash_backend_t const *flash;
+    /// Component being received, and whether the flash backend has it open.
+    char componentName[OTA_COMPONENT_NAME_SIZE];
+    bool componentOpen;
+    /// Bytes of the component received and verified so far, from offset 0.
+    uint32_t componentReceived;
+    /// Set by OtaReceiver_resume() until the next segment, which is answered with the resume point.
+    bool resumePending;
+    /// Segment being received if segmentActive is set, or last segment received.
+    bool segmentActive;
+    uint32_t segmentOffset;
+    uint32_t segmentSize;
+    uint32_t segmentReceived;
+    uint8_t segmentDigest[OTA_DIGEST_SIZE];
+    /// SHA-256 of the data received, of the component and of the segment.
+    mbedtls_sha256_context componentHash;
+    mbedtls_sha256_context segmentHash;
+    /// SHA-256 of the component up to segmentOffset, to go back to if the segment is sent again.
+    mbedtls_sha256_context segmentStartHash;
+    /// Data not written yet, that goes at blockOffset of the component.
+    uint8_t block[SAMPLE_OTA_WRITE_BLOCK_SIZE];
+    size_t blockSize;
+    uint32_t blockOffset;
+    /// Number of writes to the flash backend, of segments received, and of journals saved.
+    size_t writeCount;
+    size_t segmentCount;
+    size_t journalCount;
+} ota_receiver_t;
+
+/**
+ * Initializes a receiver.
+ * @param receiver the receiver to initialize.
+ * @param flash the flash backend the components are written to. It must outlive the receiver.
+ */
+void OtaReceiver_init(ota_receiver_t *receiver, flash_backend_t const *flash);
+
+/**
+ * Restores the progress recorded in the journal of the flash backend, typically after a reboot.
+ * The component is then open, and received up to componentReceived.
+ * @param receiver an initialized receiver.
+ * @return true if an update was resumed, false if the backend has no valid journal.
+ */
+bool OtaReceiver_resume(ota_receiver_t *receiver);
+
+/**
+ * Starts receiving a segment, from an UpdateComponentSegment command.
+ * A segment that was not received completely is abandoned.
+ * @param receiver the receiver.
+ * @param componentName the name of the component. A new name starts a new component.
+ * @param componentOffset the offset of the segment in the component.
+ * @param segmentSize the segment size in bytes.
+ * @param segmentSignature the SHA-256 of the segment in hex.
+ * @return OTA_RESULT_INVALID if the segment does not follow what was received so far or the signature is malformed,
+ * and OTA_RESULT_RESUME if it is the first segment of the resumed component but does not start at its resume point.
+ */
+ota_result_t OtaReceiver_startSegment(ota_receiver_t *receiver, char const *componentName, uint32_t componentOffset,
+                                      uint32_t segmentSize, char const *segmentSignature);
+
+/**
+ * Writes the next chunk of data of the current segment, typically the payload of one OTA_STREAM packet.
+ * @param receiver the receiver.
+ * @param data the chunk.
+ * @param size the chunk size in bytes.
+ * @return OTA_RESULT_NOT_FOUND if no segment is being received, OTA_RESULT_INVALID if the chunk exceeds the segment,
+ * and OTA_RESULT_SIGNATURE_MISMATCH if the chunk completes a segment that does not match its signature.
+ */
+ota_result_t OtaReceiver_write(ota_receiver_t *receiver, uint8_t const *data, size_t size);
+
+/**
+ * Completes a component before it is applied, from an ApplyFirmware command, and makes it persistent. The journal is
+ * erased, since the update is over.
+ * @param receiver the receiver.
+ * @param componentName the name of the component to apply.
+ * @param componentSize the size of the component, from its FirmwareComponent.
+ * @param componentSignature the SHA-256 of the component in hex, from its FirmwareComponent.
+ * @return OTA_RESULT_NOT_FOUND if the component was not received completely, OTA_RESULT_SIGNATURE_MISMATCH if it does
+ * not match its signature.
+ */
+ota_result_t OtaReceiver_finish(ota_receiver_t *receiver, char const *componentName, uint32_t componentSize,
+                                char const *componentSignature);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_OTA_H
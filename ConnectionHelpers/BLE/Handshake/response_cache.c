@@ -0,0 +1,211 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "response_cache.h"
+#include "tx.h"
+
+/**
+ * The packets of one response encoded for one MTU.
+ * The image holds the packets back to back, each preceded by its size as 2 big endian bytes.
+ */
+typedef struct {
+    response_cache_id_t id;
+    uint16_t mtu;
+    stream_id_t streamId;
+    /// Total size of the encoded message, as carried by the INITIAL packet.
+    size_t transactionSize;
+    size_t numPackets;
+    size_t imageSize;
+    uint8_t *image;
+} response_cache_entry_t;
+
+struct response_cache_s {
+    response_cache_entry_t entries[RESPONSE_CACHE_MAX_ENTRIES];
+    size_t numEntries;
+    atomic_size_t hits;
+    atomic_size_t misses;
+};
+
+static message_builder_t const responseBuilders[RESPONSE_CACHE_NUM_RESPONSES] = {
+        [RESPONSE_CACHE_DEVICE_INFORMATION] = createResponseGetDeviceInformation,
+        [RESPONSE_CACHE_DEVICE_FEATURES] = createResponseGetDeviceFeatures,
+        [RESPONSE_CACHE_DISCOVERY_RESPONSE] = createSampleDiscoveryResponseMessage,
+};
+
+static response_cache_entry_t *findEntry(response_cache_t *const cache, response_cache_id_t id, uint16_t mtu) {
+    for (size_t i = 0; i < cache->numEntries; i++) {
+        if (cache->entries[i].id == id && cache->entries[i].mtu == mtu) {
+            return &cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Replays only differ from the cached packets in the transaction id and the sequence number.
+static void patchPacketHeader(uint8_t *const data, transaction_id_t transactionId, uint8_t seqNum) {
+    data[0] &= ~(TRANSACTION_ID_MASK << TRANSACTION_ID_SHIFT);
+    data[0] |= (transactionId & TRANSACTION_ID_MASK) << TRANSACTION_ID_SHIFT;
+    data[1] &= ~(SEQ_NUM_ID_MASK << SEQ_NUM_ID_SHIFT);
+    data[1] |= (seqNum & SEQ_NUM_ID_MASK) << SEQ_NUM_ID_SHIFT;
+}
+
+// Encodes a response on a scratch session and flattens its packets into a cache entry.
+static bool encodeEntry(response_cache_entry_t *const entry, response_cache_id_t id, uint16_t mtu) {
+    // The scratch session keeps the transaction ids of the real sessions untouched.
+    gadget_session_t *const scratchSession = GadgetAllocator_alloc(NULL, sizeof(gadget_session_t));
+    if (!scratchSession) {
+        return false;
+    }
+    GadgetSession_init(scratchSession, mtu);
+    // Key the entry with the MTU the session ended up with, as sessions do.
+    mtu = scratchSession->mtu;
+    packet_queue_t packets = {};
+    bool status = responseBuilders[id](scratchSession, &packets) && packets.head != NULL;
+    GadgetSession_deinit(scratchSession);
+    GadgetAllocator_free(NULL, scratchSession);
+    if (!status) {
+        PacketQueue_free(&packets);
+        return false;
+    }
+
+    size_t imageSize = 0;
+    for (packet_list_t const *node = packets.head; node != NULL; node = node->next) {
+        imageSize += 2 + node->packet.dataSize;
+    }
+    uint8_t *const image = GadgetAllocator_alloc(NULL, imageSize);
+    if (!image) {
+        PacketQueue_free(&packets);
+        return false;
+    }
+    uint8_t *dst = image;
+    for (packet_list_t const *node = packets.head; node != NULL; node = node->next) {
+        *dst++ = (uint8_t) (node->packet.dataSize >> 8U);
+        *dst++ = (uint8_t) (node->packet.dataSize >> 0U);
+        memcpy(dst, node->packet.data, node->packet.dataSize);
+        dst += node->packet.dataSize;
+    }
+
+    // The first packet is the INITIAL one: stream and transaction ids, sequence and type bits, reserved byte, then
+    // the total transaction length.
+    uint8_t const *const initial = packets.head->packet.data;
+    entry->id = id;
+    entry->mtu = mtu;
+    entry->streamId = (initial[0] >> STREAM_ID_SHIFT) & STREAM_ID_MASK;
+    entry->transactionSize = (initial[3] << 8U) | initial[4];
+    entry->numPackets = packets.size;
+    entry->imageSize = imageSize;
+    entry->image = image;
+    PacketQueue_free(&packets);
+    return true;
+}
+
+response_cache_t *ResponseCache_create() {
+    response_cache_t *const cache = GadgetAllocator_alloc(NULL, sizeof(response_cache_t));
+    if (!cache) {
+        fprintf(stderr, "%s: Failed to allocate the cache\n", __FUNCTION__);
+        return NULL;
+    }
+    cache->numEntries = 0;
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    return cache;
+}
+
+void ResponseCache_destroy(response_cache_t *const cache) {
+    if (!cache) return;
+    ResponseCache_clear(cache);
+    GadgetAllocator_free(NULL, cache);
+}
+
+bool ResponseCache_prepare(response_cache_t *const cache, uint16_t mtu) {
+    printf("Inside %s\n", __FUNCTION__);
+    for (response_cache_id_t id = 0; id < RESPONSE_CACHE_NUM_RESPONSES; id++) {
+        response_cache_entry_t entry;
+        if (!encodeEntry(&entry, id, mtu)) {
+            fprintf(stderr, "%s: Failed to encode response [%d]\n", __FUNCTION__, id);
+            return false;
+        }
+        response_cache_entry_t *slot = findEntry(cache, id, entry.mtu);
+        if (slot) {
+            GadgetAllocator_free(NULL, slot->image);
+        } else if (cache->numEntries < RESPONSE_CACHE_MAX_ENTRIES) {
+            slot = &cache->entries[cache->numEntries++];
+        } else {
+            fprintf(stderr, "%s: Cache full\n", __FUNCTION__);
+            GadgetAllocator_free(NULL, entry.image);
+            return false;
+        }
+        *slot = entry;
+        printf("Cached response [%d] :: MTU [%u] :: Packets [%zu] :: Size [%zu]\n", id, entry.mtu, entry.numPackets,
+               entry.imageSize);
+    }
+    return true;
+}
+
+bool ResponseCache_replay(gadget_session_t *const session, response_cache_id_t id, packet_queue_t *const queue) {
+    response_cache_t *const cache = session->responseCache;
+    if (!cache) {
+        return false;
+    }
+    response_cache_entry_t const *const entry = findEntry(cache, id, session->mtu);
+    if (!entry || entry->transactionSize > session->peerMaxTransactionSize) {
+        atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+        return false;
+    }
+
+    transaction_id_t transactionId = getNextTransactionId(session, entry->streamId);
+    packet_queue_t packets = {};
+    uint8_t const *image = entry->image;
+    for (size_t seqNum = 0; seqNum < entry->numPackets; seqNum++) {
+        size_t packetSize = (image[0] << 8U) | image[1];
+        image += 2;
+        if (session->txSink) {
+            uint8_t sinkBuffer[ATT_MTU_MAX];
+            memcpy(sinkBuffer, image, packetSize);
+            patchPacketHeader(sinkBuffer, transactionId, seqNum);
+            session->txSink(session->txSinkContext, sinkBuffer, packetSize);
+        } else {
+            packet_t packet = {};
+            if (!allocTxPacket(session, &packet, packetSize)) {
+                PacketQueue_free(&packets);
+                return false;
+            }
+            memcpy(packet.data, image, packetSize);
+            patchPacketHeader(packet.data, transactionId, seqNum);
+            if (!PacketQueue_push(&packets, &packet)) {
+                PacketQueue_free(&packets);
+                return false;
+            }
+        }
+        image += packetSize;
+    }
+    PacketQueue_append(queue, &packets);
+    atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+    printf("Replayed cached response [%d] :: Stream [%d] :: Transaction [%d] :: Packets [%zu]\n", id, entry->streamId,
+           transactionId, entry->numPackets);
+    return true;
+}
+
+void ResponseCache_clear(response_cache_t *const cache) {
+    for (size_t i = 0; i < cache->numEntries; i++) {
+        GadgetAllocator_free(NULL, cache->entries[i].image);
+        cache->entries[i].image = NULL;
+    }
+    cache->numEntries = 0;
+}
+
+void ResponseCache_getStats(response_cache_t *const cache, response_cache_stats_t *const stats) {
+    stats->numEntries = cache->numEntries;
+    stats->hits = atomic_load_explicit(&cache->hits, memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&cache->misses, memory_order_relaxed);
+}
@@ -0,0 +1,109 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_RESPONSE_CACHE_H
+#define ALEXA_GADGETS_SAMPLE_CODE_RESPONSE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "helpers.h"
+#include "session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of (response, MTU) pairs a cache can hold.
+#define RESPONSE_CACHE_MAX_ENTRIES (8U)
+
+/**
+ * The responses whose content is fixed for the life of the device, and can thus be cached.
+ */
+typedef enum {
+    RESPONSE_CACHE_DEVICE_INFORMATION,
+    RESPONSE_CACHE_DEVICE_FEATURES,
+    RESPONSE_CACHE_DISCOVERY_RESPONSE,
+    RESPONSE_CACHE_NUM_RESPONSES
+} response_cache_id_t;
+
+/**
+ * Ready-to-send packets of the responses in response_cache_id_t, keyed by response and MTU.
+ * The responses are encoded once with ResponseCache_prepare(), at boot or when the device configuration changes,
+ * and each request is then answered by copying the packets and patching their transaction id and sequence bits.
+ * A cache can be shared by several sessions with GadgetSession_setResponseCache(). Replays only read the cache, so
+ * they can run concurrently, but ResponseCache_prepare() and ResponseCache_clear() must not run during a replay.
+ * The cache is opaque so that its atomic statistics stay out of this header, which C++ code can include as well.
+ * @sa ResponseCache_create().
+ */
+typedef struct response_cache_s response_cache_t;
+
+/**
+ * Statistics of a response_cache_t.
+ */
+typedef struct {
+    /// Number of (response, MTU) pairs cached.
+    size_t numEntries;
+    /// Number of responses sent from the cache.
+    size_t hits;
+    /// Number of responses that were not cached for the session, and were encoded instead.
+    size_t misses;
+} response_cache_stats_t;
+
+/**
+ * Creates an empty cache.
+ * @return the cache, to be released with ResponseCache_destroy(), or NULL if the allocation failed.
+ */
+response_cache_t *ResponseCache_create();
+
+/**
+ * Releases a cache and all of its cached responses. No session may still use it.
+ * @param cache the cache to release. NULL is ignored.
+ */
+void ResponseCache_destroy(response_cache_t *cache);
+
+/**
+ * Encodes all responses of response_cache_id_t for \p mtu and stores their packets, replacing the ones already
+ * stored for that MTU. Call it again after the device configuration changed, or call ResponseCache_clear().
+ * @param cache the cache.
+ * @param mtu the MTU of the connections the packets are for.
+ * @return false if the cache is full or a response could not be encoded.
+ */
+bool ResponseCache_prepare(response_cache_t *cache, uint16_t mtu);
+
+/**
+ * Sends a cached response on the session, through its TX sink or by appending the packets to \p queue.
+ * The packets get the next transaction id of the stream, as if the response had been encoded.
+ * @param session the session to send on. Its response cache is used, see GadgetSession_setResponseCache().
+ * @param id the response to send.
+ * @param queue receives the packets.
+ * @return false if the session has no cache or the response is not cached for the session MTU and peer limits.
+ * Nothing is sent in that case, and the caller should encode the response.
+ */
+bool ResponseCache_replay(gadget_session_t *session, response_cache_id_t id, packet_queue_t *queue);
+
+/**
+ * Releases all cached responses.
+ * @param cache the cache to clear.
+ */
+void ResponseCache_clear(response_cache_t *cache);
+
+/**
+ * Reads the statistics of the cache.
+ * @param cache the cache.
+ * @param stats receives the statistics.
+ */
+void ResponseCache_getStats(response_cache_t *cache, response_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_RESPONSE_CACHE_H
@@ -10,29 +10,57 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "accessories.pb.h"
+#include "allocator.h"
 #include "common.h"
+#include "directive_stream.h"
 #include "helpers.h"
+#include "ota.h"
 #include "pb.h"
 #include "pb_decode.h"
+#include "response_cache.h"
 #include "rx.h"
+#include "session.h"
 #include "tx.h"
+#include "wakeword_matcher.h"
+
+
+static rx_buffer_t *allocRxBuffer(gadget_session_t *const session, size_t rxBufferIndex, size_t transactionLength,
+                                  bool streamed) {
+    if (streamed) {
+        // Streamed transactions are handled as they arrive, so only the transaction state is needed.
+        transactionLength = 0;
+    } else if (transactionLength > session->maxTransactionSize) {
+        // The peer did not respect the advertised limit. Try to receive the transaction anyway.
+        fprintf(stderr, "Transaction exceeds advertised size [%zu/%u], using heap\n", transactionLength,
+                session->maxTransactionSize);
+    }
+#if SAMPLE_STATIC_RX_BUFFERS
+    if (transactionLength <= session->maxTransactionSize) {
+        rx_buffer_t *rxBuffer = &session->rxStaticBuffers[rxBufferIndex];
+        rxBuffer->data = streamed ? NULL : session->rxStaticData[rxBufferIndex];
+        rxBuffer->isStatic = true;
+        rxBuffer->isStreamed = streamed;
+        return rxBuffer;
+    }
+#endif
+    rx_buffer_t *rxBuffer = GadgetAllocator_alloc(session->allocator, sizeof(rx_buffer_t) + transactionLength);
+    if (rxBuffer) {
+        rxBuffer->data = streamed ? NULL : (uint8_t *) (rxBuffer + 1);
+        rxBuffer->isStatic = false;
+        rxBuffer->isStreamed = streamed;
+    }
+    return rxBuffer;
+}
 
-
-typedef struct rx_buffer_s {
-    transaction_id_t transactionId;
-    stream_id_t streamId;
-    uint8_t seqNum;
-    size_t bufferSize;
-    size_t dataSize;
-    uint8_t data[];
-} rx_buffer_t;
-
-static void freeRxBufferPtr(rx_buffer_t **ppRxBuffer) {
+static void freeRxBufferPtr(gadget_session_t *const session, rx_buffer_t **ppRxBuffer) {
     if (!ppRxBuffer) return;
     if (*ppRxBuffer != NULL) {
-        free(*ppRxBuffer);
+        if (!(*ppRxBuffer)->isStatic) {
+            GadgetAllocator_free(session->allocator, *ppRxBuffer);
+        }
         *ppRxBuffer = NULL;
     }
 }
@@ -56,7 +84,22 @@ static void handleDeviceFeaturesReceived(DeviceFeatures const *const devicefeatu
     printf("attributes         : %llu\n", devicefeatures->device_attributes);
 }
 
-static packet_list_t *handleReceivedResponse(packet_list_t *rspPacketList, ControlEnvelope *controlEnvelope) {
+static void handleFirmwareComponentReceived(gadget_session_t *session, FirmwareComponent const *const component) {
+    printf("Inside %s\n", __FUNCTION__);
+    printf("Resume point :: Component [%s] :: Offset [%u]\n", component->name, component->size);
+    session->peerOtaResumeOffset = component->size;
+}
+
+// Sends a fixed response from the session's response cache, and encodes it if it is not cached.
+static void sendFixedResponse(gadget_session_t *session, packet_queue_t *rspQueue, response_cache_id_t id,
+                              message_builder_t createResponse) {
+    if (!ResponseCache_replay(session, id, rspQueue)) {
+        createResponse(session, rspQueue);
+    }
+}
+
+static void handleReceivedResponse(gadget_session_t *session, packet_queue_t *rspQueue,
+                                   ControlEnvelope *controlEnvelope) {
     printf("Inside %s\n", __FUNCTION__);
     printf("Received response for command: %s\n", commandToString(controlEnvelope->command));
     switch (controlEnvelope->payload.response.which_payload) {
@@ -66,13 +109,31 @@ static packet_list_t *handleReceivedResponse(packet_list_t *rspPacketList, Contr
         case Response_device_features_tag:
             handleDeviceFeaturesReceived(&controlEnvelope->payload.response.payload.device_features);
             break;
+        case Response_firmware_component_tag:
+            handleFirmwareComponentReceived(session, &controlEnvelope->payload.response.payload.firmware_component);
+            break;
         default:
             break;
     }
-    return rspPacketList;
 }
 
-packet_list_t *handleCommandUpdateComponentSegment(packet_list_t *rspPacketList, UpdateComponentSegment *message) {
+static ErrorCode otaResultToErrorCode(ota_result_t result) {
+    switch (result) {
+        case OTA_RESULT_OK:
+            return ErrorCode_SUCCESS;
+        case OTA_RESULT_INVALID:
+        case OTA_RESULT_SIGNATURE_MISMATCH:
+        case OTA_RESULT_RESUME:
+            return ErrorCode_INVALID;
+        case OTA_RESULT_NOT_FOUND:
+            return ErrorCode_NOT_FOUND;
+        default:
+            return ErrorCode_INTERNAL;
+    }
+}
+
+void handleCommandUpdateComponentSegment(gadget_session_t *session, packet_queue_t *rspQueue,
+                                         UpdateComponentSegment *message) {
     printf("Inside %s\n", __FUNCTION__);
     printf("Segment size = %u\n", message->segment_size);
     printf("Component name = %s\n", message->component_name);
@@ -80,11 +141,24 @@ packet_list_t *handleCommandUpdateComponentSegment(packet_list_t *rspPacketList,
     int indentSize = printf("signature = ");
     printHexBuffer((uint8_t *) &message->segment_signature[0], sizeof(message->segment_signature), indentSize);
 
-    rspPacketList = PacketList_appendList(rspPacketList, createResponseUpdateComponentSegment());
-    return rspPacketList;
+    if (session->otaReceiver) {
+        ota_result_t result = OtaReceiver_startSegment(session->otaReceiver, message->component_name,
+                                                       message->component_offset, message->segment_size,
+                                                       message->segment_signature);
+        if (result == OTA_RESULT_RESUME) {
+            createResponseUpdateComponentSegmentResume(session, session->otaReceiver->componentName,
+                                                       session->otaReceiver->componentReceived, rspQueue);
+            return;
+        }
+        if (result != OTA_RESULT_OK) {
+            createResponseError(session, Command_UPDATE_COMPONENT_SEGMENT, otaResultToErrorCode(result), 0, rspQueue);
+            return;
+        }
+    }
+    createResponseUpdateComponentSegment(session, rspQueue);
 }
 
-packet_list_t *handleCommandApplyFirmware(packet_list_t *rspPacketList, ApplyFirmware *applyFirmware) {
+void handleCommandApplyFirmware(gadget_session_t *session, packet_queue_t *rspQueue, ApplyFirmware *applyFirmware) {
     printf("Inside %s\n", __FUNCTION__);
     printf("restart_required = %s\n", applyFirmware->restart_required ? "true" : "false");
     printf("Firmware information is:\n");
@@ -101,117 +175,133 @@ packet_list_t *handleCommandApplyFirmware(packet_list_t *rspPacketList, ApplyFir
         printHexBuffer((uint8_t *) &applyFirmware->firmware_information.components[0].signature[0],
                        sizeof(applyFirmware->firmware_information.components[0].signature), indentSize);
     }
-    rspPacketList = PacketList_appendList(rspPacketList, createResponseApplyFirmware());
-    return rspPacketList;
+    if (session->otaReceiver) {
+        ota_result_t result = OTA_RESULT_NOT_FOUND;
+        if (applyFirmware->firmware_information.components_count > 0) {
+            FirmwareComponent const *const component = &applyFirmware->firmware_information.components[0];
+            result = OtaReceiver_finish(session->otaReceiver, component->name, component->size, component->signature);
+        }
+        if (result != OTA_RESULT_OK) {
+            createResponseError(session, Command_APPLY_FIRMWARE, otaResultToErrorCode(result), 0, rspQueue);
+            return;
+        }
+    }
+    createResponseApplyFirmware(session, rspQueue);
 }
 
-packet_list_t *handleReceivedCommand(packet_list_t *rspPacketList, ControlEnvelope *controlEnvelope) {
+void handleReceivedCommand(gadget_session_t *session, packet_queue_t *rspQueue, ControlEnvelope *controlEnvelope) {
     switch (controlEnvelope->command) {
         case Command_GET_DEVICE_INFORMATION:
-            rspPacketList = PacketList_appendList(rspPacketList, createResponseGetDeviceInformation());
+            sendFixedResponse(session, rspQueue, RESPONSE_CACHE_DEVICE_INFORMATION, createResponseGetDeviceInformation);
             break;
         case Command_GET_DEVICE_FEATURES:
-            rspPacketList = PacketList_appendList(rspPacketList, createResponseGetDeviceFeatures());
+            sendFixedResponse(session, rspQueue, RESPONSE_CACHE_DEVICE_FEATURES, createResponseGetDeviceFeatures);
             break;
         case Command_UPDATE_COMPONENT_SEGMENT:
-            rspPacketList = handleCommandUpdateComponentSegment(rspPacketList,
-                                                                &controlEnvelope->payload.update_component_segment);
+            handleCommandUpdateComponentSegment(session, rspQueue, &controlEnvelope->payload.update_component_segment);
             break;
         case Command_APPLY_FIRMWARE:
-            rspPacketList = handleCommandApplyFirmware(rspPacketList, &controlEnvelope->payload.apply_firmware);
+            handleCommandApplyFirmware(session, rspQueue, &controlEnvelope->payload.apply_firmware);
             break;
         default:
-            rspPacketList = PacketList_appendList(rspPacketList,
-                                                  createResponseError(controlEnvelope->command,
-                                                                      ErrorCode_UNSUPPORTED,
-                                                                      0));
+            createResponseError(session, controlEnvelope->command, ErrorCode_UNSUPPORTED, 0, rspQueue);
             break;
     }
-    return rspPacketList;
 }
 
-packet_list_t *handleControlMessage(packet_list_t *rspPacketList, uint8_t *buffer, size_t bufferSize) {
+void handleControlMessage(gadget_session_t *session, packet_queue_t *rspQueue, uint8_t *buffer, size_t bufferSize) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     pb_istream_t stream = pb_istream_from_buffer(buffer, bufferSize);
     if (!pb_decode(&stream, ControlEnvelope_fields, &controlEnvelope)) {
         fprintf(stderr, "%s: pb_decode Failed :: %s\n", __FUNCTION__, PB_GET_ERROR(&stream));
-        return rspPacketList;
+        return;
     }
     if (controlEnvelope.which_payload == ControlEnvelope_response_tag) {
-        rspPacketList = handleReceivedResponse(rspPacketList, &controlEnvelope);
+        handleReceivedResponse(session, rspQueue, &controlEnvelope);
     } else {
-        rspPacketList = handleReceivedCommand(rspPacketList, &controlEnvelope);
+        handleReceivedCommand(session, rspQueue, &controlEnvelope);
     }
-    return rspPacketList;
 }
 
-packet_list_t *handleAlexaDirective(packet_list_t *rspPacketList, uint8_t *buffer, size_t buffersize) {
+void handleAlexaDirective(gadget_session_t *session, packet_queue_t *rspQueue, uint8_t *buffer, size_t buffersize) {
     printf("Inside %s\n", __FUNCTION__);
 
     // For parsing this message, check out the sample code in AlexaGadgetsProtobuf/examples folder.
     int indentSize = printf("Received Alexa directive: ");
     printHexBuffer(buffer, buffersize, indentSize);
 
-    rspPacketList = PacketList_appendList(rspPacketList, createSampleDiscoveryResponseMessage());
-    return rspPacketList;
+    sendFixedResponse(session, rspQueue, RESPONSE_CACHE_DISCOVERY_RESPONSE, createSampleDiscoveryResponseMessage);
+}
+
+static void handleStreamedAlexaDirective(gadget_session_t *session, packet_queue_t *rspQueue,
+                                         transaction_id_t transactionId, bool ack) {
+    printf("Inside %s\n", __FUNCTION__);
+    directive_stream_t *const directiveStream = &session->directiveStream;
+    bool decoded = DirectiveStream_finish(directiveStream);
+    sendControlAckPacket(session, ALEXA_STREAM, transactionId, ack,
+                         decoded ? CONTROL_PACKET_RESULT_SUCCESS : CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+    if (decoded && strcmp(directiveStream->header.nameSpace, "Alexa.Discovery") == 0 &&
+        strcmp(directiveStream->header.name, "Discover") == 0) {
+        sendFixedResponse(session, rspQueue, RESPONSE_CACHE_DISCOVERY_RESPONSE, createSampleDiscoveryResponseMessage);
+    }
 }
 
-static packet_list_t *handleAlexaEvent(packet_list_t *rspPacketList, uint8_t *buffer, size_t buffersize) {
+static void handleAlexaEvent(gadget_session_t *session, packet_queue_t *rspQueue, uint8_t *buffer, size_t buffersize) {
     printf("Inside %s\n", __FUNCTION__);
 
     // For parsing this message, check out the sample code in AlexaGadgetsProtobuf/examples folder.
     int indentSize = printf("Received Alexa event: ");
 
     printHexBuffer(buffer, buffersize, indentSize);
-    return rspPacketList;
 }
 
-static packet_list_t *handleDataReceived(role_t role, packet_list_t *rspPacketList, stream_id_t streamId,
-                                         transaction_id_t transactionId, uint8_t *buffer, size_t bufferSize, bool ack) {
+static void handleDataReceived(gadget_session_t *session, role_t role, packet_queue_t *rspQueue,
+                               stream_id_t streamId, transaction_id_t transactionId, uint8_t *buffer,
+                               size_t bufferSize, bool ack) {
     switch (streamId) {
         case CONTROL_STREAM: {
             if (role == ROLE_GADGET) {
-                packet_t controlAck = createControlAckPacket(streamId, transactionId, ack,
-                                                             CONTROL_PACKET_RESULT_SUCCESS);
-                rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_SUCCESS, rspQueue);
             }
-            rspPacketList = handleControlMessage(rspPacketList, buffer, bufferSize);
+            handleControlMessage(session, rspQueue, buffer, bufferSize);
         }
             break;
         case OTA_STREAM: {
-            // Handle OTA stream packets.
+            // With an OTA receiver, OTA data is written as it arrives and never reassembled.
+            fprintf(stderr, "No OTA receiver :: Dropping OTA data [%zu]\n", bufferSize);
+            if (role == ROLE_GADGET) {
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_UNSUPPORTED,
+                                     rspQueue);
+            }
         }
             break;
         case ALEXA_STREAM: {
             if (role == ROLE_GADGET) {
-                packet_t controlAck = createControlAckPacket(streamId, transactionId, ack,
-                                                             CONTROL_PACKET_RESULT_SUCCESS);
-                rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
-                rspPacketList = handleAlexaDirective(rspPacketList, buffer, bufferSize);
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_SUCCESS, rspQueue);
+                handleAlexaDirective(session, rspQueue, buffer, bufferSize);
             } else { // ROLE_ECHO
-                rspPacketList = handleAlexaEvent(rspPacketList, buffer, bufferSize);
+                handleAlexaEvent(session, rspQueue, buffer, bufferSize);
             }
             break;
         }
         default:
             fprintf(stderr, "Unhandled stream [%u]", streamId);
     }
-    return rspPacketList;
 }
 
-packet_list_t *decodePacket(role_t role, packet_list_t *rspPacketList, packet_t const *const packet) {
-    if (!packet) return rspPacketList;
+void decodePacket(gadget_session_t *session, role_t role, packet_queue_t *rspQueue, packet_t const *const packet) {
+    if (!packet) return;
 
     uint8_t const *const buffer = packet->data;
     size_t const bufferSize = packet->dataSize;
 
-    static rx_buffer_t *rxBuffers[3] = {NULL, NULL, NULL};
+    rx_buffer_t **const rxBuffers = session->rxBuffers;
     size_t offset = 0;
 
     while (bufferSize > offset) {
         if (bufferSize - offset < 2) {
             fprintf(stderr, "Insufficient Length :: [%lu/%d]", bufferSize - offset, 2);
-            return rspPacketList;
+            return;
         }
         stream_id_t streamId = (buffer[offset] >> STREAM_ID_SHIFT) & STREAM_ID_MASK;
         transaction_id_t transactionId = (buffer[offset] >> TRANSACTION_ID_SHIFT) & TRANSACTION_ID_MASK;
@@ -226,7 +316,7 @@ packet_list_t *decodePacket(role_t role, packet_list_t *rspPacketList, packet_t
             if (bufferSize - offset < (CONTROL_PACKET_LENGTH - 2)) {
                 fprintf(stderr, "Insufficient Length :: Control Packet [%lu/%d]", bufferSize - offset,
                         CONTROL_PACKET_LENGTH - 2);
-                return rspPacketList;
+                return;
             }
             // Reserved: 1 byte.
             offset++;
@@ -257,15 +347,21 @@ packet_list_t *decodePacket(role_t role, packet_list_t *rspPacketList, packet_t
             rxBufferIndex = streamToIndex(streamId);
             if (rxBufferIndex < 0) {
                 fprintf(stderr, "Invalid streamId [%d]. Could not create an RX Buffer.", streamId);
-                return rspPacketList;
+                return;
             }
+            // Directives are decoded and OTA data is written while they arrive when the application registered a
+            // handler for them.
+            bool streamed = role == ROLE_GADGET &&
+                            ((streamId == ALEXA_STREAM && session->directiveHandler != NULL) ||
+                             (streamId == OTA_STREAM && session->otaReceiver != NULL));
             // Ensure that this packet does not exist and then create it.
             assert(rxBuffers[rxBufferIndex] == NULL);
-            rxBuffers[rxBufferIndex] = malloc(sizeof(rx_buffer_t) + transactionLength);
+            rxBuffers[rxBufferIndex] = allocRxBuffer(session, rxBufferIndex, transactionLength, streamed);
             if (!rxBuffers[rxBufferIndex]) {
                 fprintf(stderr, "Failed to alloc a new RX packet for Transaction [%d] :: stream [%d]",
                         transactionId, streamId);
-                return rspPacketList;
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+                return;
             }
 
             // Initialize the new packet.
@@ -274,16 +370,20 @@ packet_list_t *decodePacket(role_t role, packet_list_t *rspPacketList, packet_t
             rxBuffers[rxBufferIndex]->bufferSize = transactionLength;
             rxBuffers[rxBufferIndex]->seqNum = 0;
             rxBuffers[rxBufferIndex]->dataSize = 0;
+            if (streamed && streamId == ALEXA_STREAM) {
+                DirectiveStream_init(&session->directiveStream, transactionLength, session->directiveHandler,
+                                     session->directiveHandlerContext);
+            }
         } else {
             // Find an existing packet
             rxBufferIndex = streamToIndex(streamId);
             if (rxBufferIndex < 0) {
                 fprintf(stderr, "Invalid streamId [%d]. Could not find an RX Buffer.", streamId);
-                return rspPacketList;
+                return;
             }
             if (rxBuffers[rxBufferIndex] == NULL) { // Ensure that this packet exists.
                 fprintf(stderr, "Unable to find Rx packet :: Transaction [%d] :: Stream [%d]", transactionId, streamId);
-                return rspPacketList;
+                return;
             }
             assert(rxBuffers[rxBufferIndex]->transactionId == transactionId);
             assert(rxBuffers[rxBufferIndex]->streamId == streamId);
@@ -292,72 +392,92 @@ packet_list_t *decodePacket(role_t role, packet_list_t *rspPacketList, packet_t
         if (extendLength) {
             if (bufferSize - offset < 2) {
                 fprintf(stderr, "Insufficient Length :: Extended Payload Header [%lu/%d]", bufferSize - offset, 2);
-                packet_t controlAck = createControlAckPacket(streamId, transactionId, ack,
-                                                             CONTROL_PACKET_RESULT_FAILURE);
-                rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
-                freeRxBufferPtr(&rxBuffers[rxBufferIndex]);
-                return rspPacketList;
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+                freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+                return;
             }
             currentPayloadLength |= buffer[offset++] << 8U; // MSB of payload length.
         } else {
             if (bufferSize - offset < 1) {
                 fprintf(stderr, "Insufficient Length :: Extended Payload Header [%lu/%d]", bufferSize - offset, 1);
-                packet_t controlAck = createControlAckPacket(streamId, transactionId, ack,
-                                                             CONTROL_PACKET_RESULT_FAILURE);
-                rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
-                freeRxBufferPtr(&rxBuffers[rxBufferIndex]);
-                return rspPacketList;
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+                freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+                return;
             }
         }
         currentPayloadLength |= buffer[offset++] << 0U; // LSB of payload length.
 
         if (bufferSize - offset < currentPayloadLength) {
             fprintf(stderr, "Insufficient Length :: payload [%lu/%zu]", bufferSize - offset, currentPayloadLength);
-            packet_t controlAck = createControlAckPacket(streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE);
-            rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
-            freeRxBufferPtr(&rxBuffers[rxBufferIndex]);
-            return rspPacketList;
+            sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+            freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+            return;
         }
 
         if (rxBuffers[rxBufferIndex]->seqNum != seqNum) {
             fprintf(stderr, "Sequence Failed [%d] :: Expected [%d]", seqNum, rxBuffers[rxBufferIndex]->seqNum);
-            packet_t controlAck = createControlAckPacket(streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE);
-            rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
-            freeRxBufferPtr(&rxBuffers[rxBufferIndex]);
-            return rspPacketList;
+            sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+            freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+            return;
         }
 
         // Check if destination packet has sufficient length.
         if (rxBuffers[rxBufferIndex]->bufferSize - rxBuffers[rxBufferIndex]->dataSize < currentPayloadLength) {
             fprintf(stderr, "Buffer Overflow :: Transaction [%d] :: Received [%zu/%zu] :: Packet %zu\n", transactionId,
                     rxBuffers[rxBufferIndex]->dataSize, rxBuffers[rxBufferIndex]->bufferSize, currentPayloadLength);
-            packet_t controlAck = createControlAckPacket(streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE);
-            rspPacketList = PacketList_addToTail(rspPacketList, &controlAck);
-            freeRxBufferPtr(&rxBuffers[rxBufferIndex]);
-            return rspPacketList;
+            sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+            freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+            return;
+        }
+        if (role == ROLE_GADGET && streamId == ALEXA_STREAM && session->wakewordMatcher.handler) {
+            // Signal wakeword transitions from the raw payload, before the directive is reassembled and dispatched.
+            if (transactionType == TRANSACTION_TYPE_INITIAL) {
+                WakewordMatcher_reset(&session->wakewordMatcher);
+            }
+            WakewordMatcher_feed(&session->wakewordMatcher, &buffer[offset], currentPayloadLength);
+        }
+        if (rxBuffers[rxBufferIndex]->isStreamed) {
+            bool consumed = (streamId == OTA_STREAM)
+                            ? session->otaReceiver != NULL &&
+                              OtaReceiver_write(session->otaReceiver, &buffer[offset], currentPayloadLength) ==
+                              OTA_RESULT_OK
+                            : DirectiveStream_feed(&session->directiveStream, &buffer[offset], currentPayloadLength);
+            if (!consumed) {
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_FAILURE, rspQueue);
+                freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+                return;
+            }
+        } else {
+            memcpy(rxBuffers[rxBufferIndex]->data + rxBuffers[rxBufferIndex]->dataSize,
+                   &buffer[offset],
+                   currentPayloadLength);
         }
-        memcpy(rxBuffers[rxBufferIndex]->data + rxBuffers[rxBufferIndex]->dataSize,
-               &buffer[offset],
-               currentPayloadLength);
         rxBuffers[rxBufferIndex]->dataSize += currentPayloadLength;
         offset += currentPayloadLength;
         rxBuffers[rxBufferIndex]->seqNum = (rxBuffers[rxBufferIndex]->seqNum + 1) & 0x0FU;
         printf("Rx Progress [%zu/%zu] :: Stream [%d] :: Transaction [%d]\n",
                rxBuffers[rxBufferIndex]->dataSize, rxBuffers[rxBufferIndex]->bufferSize, streamId, transactionId);
-        if (rxBuffers[rxBufferIndex]->dataSize == rxBuffers[rxBufferIndex]->bufferSize) {
-            rspPacketList = handleDataReceived(role, rspPacketList, streamId, transactionId,
-                                               rxBuffers[rxBufferIndex]->data, rxBuffers[rxBufferIndex]->dataSize, ack);
-            freeRxBufferPtr(&rxBuffers[rxBufferIndex]);
+        if (rxBuffers[rxBufferIndex]->dataSize == rxBuffers[rxBufferIndex]->bufferSize &&
+            rxBuffers[rxBufferIndex]->isStreamed) {
+            if (streamId == OTA_STREAM) {
+                // Every packet was written as it arrived.
+                sendControlAckPacket(session, streamId, transactionId, ack, CONTROL_PACKET_RESULT_SUCCESS, rspQueue);
+            } else {
+                handleStreamedAlexaDirective(session, rspQueue, transactionId, ack);
+            }
+            freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
+        } else if (rxBuffers[rxBufferIndex]->dataSize == rxBuffers[rxBufferIndex]->bufferSize) {
+            handleDataReceived(session, role, rspQueue, streamId, transactionId, rxBuffers[rxBufferIndex]->data,
+                               rxBuffers[rxBufferIndex]->dataSize, ack);
+            freeRxBufferPtr(session, &rxBuffers[rxBufferIndex]);
         }
     }
-    return rspPacketList;
 }
 
 
-packet_list_t *receivePackets(role_t role, packet_list_t const *const list) {
-    packet_list_t *response = NULL;
-    for (packet_list_t const *node = list; node != NULL; node = node->next) {
-        response = decodePacket(role, response, &node->packet);
+void receivePackets(gadget_session_t *session, role_t role, packet_queue_t const *const rxQueue,
+                    packet_queue_t *const txQueue) {
+    for (packet_list_t const *node = rxQueue->head; node != NULL; node = node->next) {
+        decodePacket(session, role, txQueue, &node->packet);
     }
-    return response;
 }
@@ -10,6 +10,7 @@
 #define ALEXA_GADGETS_SAMPLE_CODE_RX_H
 
 #include "helpers.h"
+#include "session.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,7 +21,15 @@ typedef enum {
     ROLE_GADGET
 } role_t;
 
-packet_list_t *receivePackets(role_t role, packet_list_t const *list);
+/**
+ * Decodes the packets received on a connection and handles every transaction they complete.
+ * @param session the session of the connection the packets were received on.
+ * @param role the role of the receiving side.
+ * @param rxQueue the received packets, in order.
+ * @param txQueue receives the packets to send back to the peer. If the session has a TX sink, the packets are passed
+ * to the sink as they are produced instead.
+ */
+void receivePackets(gadget_session_t *session, role_t role, packet_queue_t const *rxQueue, packet_queue_t *txQueue);
 
 #ifdef __cplusplus
 }
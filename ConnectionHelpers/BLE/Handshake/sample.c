@@ -8,11 +8,21 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <time.h>
 
+#include "allocator.h"
+#include "discovery.h"
+#include "flash_backend.h"
+#include "fragment_pool.h"
 #include "helpers.h"
-#include "tx.h"
+#include "mbedtls/sha256.h"
+#include "ota.h"
+#include "response_cache.h"
 #include "rx.h"
+#include "session.h"
+#include "tx.h"
 
 
 void runSampleCreateAdvertisingPacket() {
@@ -30,49 +40,651 @@ void runSampleCreateAdvertisingPacket() {
     freePacket(&advPacket);
 }
 
-void runSampleProtocolVersionPacket() {
+void runSampleProtocolVersionPacket(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
     printf("=================================================================================\n");
     printf("runSample for handshake: ProtocolVersionPacket\n");
     printf("=================================================================================\n");
     // Build protocol version packet.
-    packet_t pvPacket = createProtocolVersionPacket();
+    packet_t pvPacket = createProtocolVersionPacket(gadgetSession);
     if (!pvPacket.data) {
         fprintf(stderr, "Could not create ProtocolVersion packet. Exiting");
         exit(1);
     }
     int indentSize = printf("Protocol Version packet content is: ");
     printPacket(&pvPacket, indentSize);
+    // The Echo device sizes its packets and transactions to what the gadget advertised.
+    if (!GadgetSession_handleProtocolVersionPacket(echoSession, &pvPacket)) {
+        fprintf(stderr, "Could not handle ProtocolVersion packet. Exiting");
+        exit(1);
+    }
     freePacket(&pvPacket);
 }
 
-void runSample(packet_list_t *txPackets, char *sampleName) {
+void runSample(gadget_session_t *echoSession, gadget_session_t *gadgetSession, message_builder_t createMessage,
+               char *sampleName) {
     printf("=================================================================================\n");
     printf("runSample for handshake: %s\n", sampleName);
     printf("=================================================================================\n");
     printf("<<<<< Sending a message from Echo -> Gadget:\n");
-    if (!txPackets) {
+    packet_queue_t txPackets = {};
+    if (!createMessage(echoSession, &txPackets) || !txPackets.head) {
         fprintf(stderr, "%s: Could not create  message. Exiting", __FUNCTION__);
         exit(1);
     }
-    PacketList_PrintAll(txPackets);
+    PacketList_PrintAll(txPackets.head);
     printf("----- Gadget receives the message -----\n");
-    packet_list_t *responseList = receivePackets(ROLE_GADGET, txPackets);
-    PacketList_freeList(txPackets);
+    packet_queue_t responsePackets = {};
+    receivePackets(gadgetSession, ROLE_GADGET, &txPackets, &responsePackets);
+    PacketQueue_free(&txPackets);
 
     printf(">>>>> Response from Gadget -> Echo:\n");
-    PacketList_PrintAll(responseList);
+    PacketList_PrintAll(responsePackets.head);
 
     printf("----- Echo receives the response -----\n");
-    txPackets = responseList;
-    responseList = receivePackets(ROLE_ECHO, txPackets);
+    txPackets = responsePackets;
+    responsePackets = (packet_queue_t) {};
+    receivePackets(echoSession, ROLE_ECHO, &txPackets, &responsePackets);
+    // No further responses sent from Echo device.
+    assert(responsePackets.head == NULL);
+
+    PacketQueue_free(&txPackets);
+    PacketQueue_free(&responsePackets);
+}
+
+static void sampleDirectiveHeader(void *context, directive_header_t const *header) {
+    printf("Inside %s\n", __FUNCTION__);
+    // Route the directive here, before its payload is received.
+    printf("Directive header: namespace=%s name=%s messageId=%s\n", header->nameSpace, header->name,
+           header->messageId);
+}
+
+static void sampleDirectivePayload(void *context, uint8_t const *data, size_t size) {
+    size_t *payloadSize = context;
+    *payloadSize += size;
+    int indentSize = printf("Directive payload chunk: ");
+    printHexBuffer(data, size, indentSize);
+}
+
+static void sampleDirectiveComplete(void *context, directive_header_t const *header) {
+    size_t const *payloadSize = context;
+    printf("Inside %s\n", __FUNCTION__);
+    printf("Directive %s::%s complete, payload size [%zu]\n", header->nameSpace, header->name, *payloadSize);
+}
+
+void runSampleStreamedDirective(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    static directive_handler_t const directiveHandler = {
+            .onHeader = sampleDirectiveHeader,
+            .onPayload = sampleDirectivePayload,
+            .onComplete = sampleDirectiveComplete,
+    };
+    size_t payloadSize = 0;
+    GadgetSession_setDirectiveHandler(gadgetSession, &directiveHandler, &payloadSize);
+    runSample(echoSession, gadgetSession, createAlexaDiscoveryDiscoverDirective, "AlexaDiscovery (streamed decode)");
+    GadgetSession_setDirectiveHandler(gadgetSession, NULL, NULL);
+}
+
+// Number of StateUpdate directives sent in each mode, alternating between the wake word being detected and cleared.
+#define WAKEWORD_SAMPLE_TRANSITIONS (8U)
+
+typedef struct {
+    struct timespec rxStart;
+    double fastPathUs;
+    double dispatchUs;
+} wakeword_latency_t;
+
+static double getMonotonicElapsedUs(struct timespec const *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) * 1000000.0 + (double) (now.tv_nsec - start->tv_nsec) / 1000.0;
+}
+
+static void sampleWakeword(void *context, bool active) {
+    wakeword_latency_t *const latency = context;
+    latency->fastPathUs = getMonotonicElapsedUs(&latency->rxStart);
+    printf("Inside %s: wakeword %s\n", __FUNCTION__, active ? "active" : "cleared");
+}
+
+static void sampleWakewordDirectiveComplete(void *context, directive_header_t const *header) {
+    wakeword_latency_t *const latency = context;
+    latency->dispatchUs = getMonotonicElapsedUs(&latency->rxStart);
+}
+
+static void measureWakewordLatency(gadget_session_t *echoSession, gadget_session_t *gadgetSession,
+                                   wakeword_latency_t *latency, char const *mode) {
+    double fastPathUs = 0, dispatchUs = 0;
+    for (size_t i = 0; i < WAKEWORD_SAMPLE_TRANSITIONS; i++) {
+        packet_queue_t txPackets = {};
+        char const *value = i % 2 == 0 ? "active" : "cleared";
+        if (!createAlexaStateListenerStateUpdateDirective(echoSession, "wakeword", value, &txPackets)) {
+            fprintf(stderr, "%s: Could not create  message. Exiting", __FUNCTION__);
+            exit(1);
+        }
+        latency->fastPathUs = -1;
+        latency->dispatchUs = -1;
+        packet_queue_t responsePackets = {};
+        clock_gettime(CLOCK_MONOTONIC, &latency->rxStart);
+        receivePackets(gadgetSession, ROLE_GADGET, &txPackets, &responsePackets);
+        if (latency->dispatchUs < 0) {
+            // Reassembled directives have no application callback: they are dispatched once receivePackets() returns.
+            latency->dispatchUs = getMonotonicElapsedUs(&latency->rxStart);
+        }
+        // Every directive is a transition, so the fast path signaled each of them.
+        assert(latency->fastPathUs >= 0);
+        fastPathUs += latency->fastPathUs;
+        dispatchUs += latency->dispatchUs;
+        PacketQueue_free(&txPackets);
+        PacketQueue_free(&responsePackets);
+    }
+    printf("Wakeword %s :: Transitions [%u] :: RX to wakeword callback [%.1f us] :: RX to directive dispatch "
+           "[%.1f us]\n", mode, WAKEWORD_SAMPLE_TRANSITIONS, fastPathUs / WAKEWORD_SAMPLE_TRANSITIONS,
+           dispatchUs / WAKEWORD_SAMPLE_TRANSITIONS);
+}
+
+void runSampleWakewordFastPath(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    printf("=================================================================================\n");
+    printf("runSample for wakeword fast path\n");
+    printf("=================================================================================\n");
+    static directive_handler_t const directiveHandler = {
+            .onComplete = sampleWakewordDirectiveComplete,
+    };
+    wakeword_latency_t reassembled = {}, streamed = {};
+    GadgetSession_setWakewordHandler(gadgetSession, sampleWakeword, &reassembled);
+    measureWakewordLatency(echoSession, gadgetSession, &reassembled, "reassembled");
+
+    GadgetSession_setWakewordHandler(gadgetSession, sampleWakeword, &streamed);
+    GadgetSession_setDirectiveHandler(gadgetSession, &directiveHandler, &streamed);
+    measureWakewordLatency(echoSession, gadgetSession, &streamed, "streamed");
+    GadgetSession_setDirectiveHandler(gadgetSession, NULL, NULL);
+    GadgetSession_setWakewordHandler(gadgetSession, NULL, NULL);
+}
+
+#define OTA_SAMPLE_COMPONENT_NAME "ComponentName"
+#define OTA_SAMPLE_COMPONENT_SIZE (16U * 1024U)
+#define OTA_SAMPLE_SEGMENT_SIZE (4U * 1024U)
+
+// Writes the signature of data, its SHA-256 in hex, as the Echo device sends it.
+static void computeOtaSignature(uint8_t const *data, size_t dataSize, char signature[OTA_SIGNATURE_SIZE]) {
+    uint8_t digest[OTA_DIGEST_SIZE];
+    if (mbedtls_sha256_ret(data, dataSize, digest, 0) != 0) {
+        fprintf(stderr, "%s: Could not compute the signature. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    static char const hexDigits[] = "0123456789abcdef";
+    for (size_t index = 0; index < sizeof(digest); index++) {
+        signature[2 * index] = hexDigits[digest[index] >> 4U];
+        signature[2 * index + 1] = hexDigits[digest[index] & 0x0FU];
+    }
+    signature[OTA_SIGNATURE_SIZE - 1] = '\0';
+}
+
+// Passes the packets sent by the Echo device to the gadget, and the responses of the gadget back.
+static void exchangePackets(gadget_session_t *echoSession, gadget_session_t *gadgetSession,
+                            packet_queue_t *txPackets) {
+    packet_queue_t responsePackets = {};
+    receivePackets(gadgetSession, ROLE_GADGET, txPackets, &responsePackets);
+    PacketQueue_free(txPackets);
+    packet_queue_t echoResponsePackets = {};
+    receivePackets(echoSession, ROLE_ECHO, &responsePackets, &echoResponsePackets);
+    // No further responses sent from Echo device.
+    assert(echoResponsePackets.head == NULL);
+    PacketQueue_free(&responsePackets);
+}
+
+static void initOtaSampleImage(uint8_t *const image, size_t imageSize) {
+    for (size_t index = 0; index < imageSize; index++) {
+        image[index] = (uint8_t) (index * 31U + (index >> 8U));
+    }
+}
+
+// Sends the segment of the image at offset as the Echo device does, followed by data as its payload, unless data is
+// NULL because the link drops before.
+static void sendOtaSegment(gadget_session_t *echoSession, gadget_session_t *gadgetSession, uint8_t const *image,
+                           size_t imageSize, uint32_t offset, uint8_t const *data) {
+    UpdateComponentSegment updateComponentSegment = UpdateComponentSegment_init_default;
+    strcpy(updateComponentSegment.component_name, OTA_SAMPLE_COMPONENT_NAME);
+    updateComponentSegment.component_offset = offset;
+    updateComponentSegment.segment_size = MIN(OTA_SAMPLE_SEGMENT_SIZE, imageSize - offset);
+    computeOtaSignature(&image[offset], updateComponentSegment.segment_size, updateComponentSegment.segment_signature);
+    packet_queue_t txPackets = {};
+    if (!createUpdateComponentSegmentCommand(echoSession, &updateComponentSegment, &txPackets) ||
+        (data && !createOtaData(echoSession, data, updateComponentSegment.segment_size, &txPackets))) {
+        fprintf(stderr, "%s: Could not create  message. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    exchangePackets(echoSession, gadgetSession, &txPackets);
+}
+
+static void initOtaSampleApplyFirmware(ApplyFirmware *const applyFirmware, uint8_t const *image, size_t imageSize) {
+    *applyFirmware = (ApplyFirmware) ApplyFirmware_init_default;
+    applyFirmware->firmware_information.components_count = 1;
+    strcpy(applyFirmware->firmware_information.components[0].name, OTA_SAMPLE_COMPONENT_NAME);
+    applyFirmware->firmware_information.components[0].size = imageSize;
+    computeOtaSignature(image, imageSize, applyFirmware->firmware_information.components[0].signature);
+}
+
+// Checks that the component file holds the image, and removes it.
+static void checkOtaSampleComponent(uint8_t const *image, size_t imageSize) {
+    static uint8_t written[OTA_SAMPLE_COMPONENT_SIZE + 1];
+    FILE *file = fopen("./" OTA_SAMPLE_COMPONENT_NAME, "rb");
+    assert(file != NULL);
+    size_t writtenSize = fread(written, 1, sizeof(written), file);
+    fclose(file);
+    remove("./" OTA_SAMPLE_COMPONENT_NAME);
+    assert(writtenSize == imageSize && memcmp(written, image, imageSize) == 0);
+}
+
+void runSampleOta(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    printf("=================================================================================\n");
+    printf("runSample for OTA\n");
+    printf("=================================================================================\n");
+    static uint8_t image[OTA_SAMPLE_COMPONENT_SIZE];
+    initOtaSampleImage(image, sizeof(image));
+    // The component is written to a file in the current directory, as it would be to the update partition.
+    static file_flash_t flash;
+    static ota_receiver_t receiver;
+    FileFlash_init(&flash, ".");
+    OtaReceiver_init(&receiver, FileFlash_getBackend(&flash));
+    GadgetSession_setOtaReceiver(gadgetSession, &receiver);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t offset = 0; offset < sizeof(image); offset += OTA_SAMPLE_SEGMENT_SIZE) {
+        sendOtaSegment(echoSession, gadgetSession, image, sizeof(image), offset, &image[offset]);
+    }
+    ApplyFirmware applyFirmware;
+    initOtaSampleApplyFirmware(&applyFirmware, image, sizeof(image));
+    packet_queue_t txPackets = {};
+    if (!createApplyFirmwareCommand(echoSession, &applyFirmware, &txPackets)) {
+        fprintf(stderr, "%s: Could not create  message. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    struct timespec applyStart;
+    clock_gettime(CLOCK_MONOTONIC, &applyStart);
+    exchangePackets(echoSession, gadgetSession, &txPackets);
+    double applyUs = getMonotonicElapsedUs(&applyStart);
+    double elapsedUs = getMonotonicElapsedUs(&start);
+    GadgetSession_setOtaReceiver(gadgetSession, NULL);
+    FileFlash_close(&flash);
+
+    // The file holds the image as sent. Reading it back and hashing it is what verifying the component after
+    // receiving it would cost on top of applying it.
+    static uint8_t written[OTA_SAMPLE_COMPONENT_SIZE + 1];
+    char readBackSignature[OTA_SIGNATURE_SIZE];
+    struct timespec readBackStart;
+    clock_gettime(CLOCK_MONOTONIC, &readBackStart);
+    FILE *file = fopen("./" OTA_SAMPLE_COMPONENT_NAME, "rb");
+    assert(file != NULL);
+    size_t writtenSize = fread(written, 1, sizeof(written), file);
+    fclose(file);
+    computeOtaSignature(written, writtenSize, readBackSignature);
+    double readBackUs = getMonotonicElapsedUs(&readBackStart);
+    assert(strcmp(readBackSignature, applyFirmware.firmware_information.components[0].signature) == 0);
+    checkOtaSampleComponent(image, sizeof(image));
+
+    printf("OTA :: Component [%zu] bytes :: Segments [%zu] :: Flash writes [%zu] :: Receiver RAM [%zu] bytes :: "
+           "%.0f KB/s\n", sizeof(image), receiver.segmentCount, receiver.writeCount, sizeof(receiver),
+           sizeof(image) / 1024.0 / (elapsedUs / 1000000.0));
+    printf("OTA :: ApplyFirmware with incremental verification [%.0f us] :: Read-back verification [%.0f us]\n",
+           applyUs, readBackUs);
+}
+
+void runSampleOtaResume(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    printf("=================================================================================\n");
+    printf("runSample for OTA resume\n");
+    printf("=================================================================================\n");
+    static uint8_t image[OTA_SAMPLE_COMPONENT_SIZE];
+    initOtaSampleImage(image, sizeof(image));
+    static file_flash_t flash;
+    static ota_receiver_t receiver;
+    FileFlash_init(&flash, ".");
+    OtaReceiver_init(&receiver, FileFlash_getBackend(&flash));
+    GadgetSession_setOtaReceiver(gadgetSession, &receiver);
+
+    // Half of the component is received. The last segment is then sent again but corrupted on the way, and the link
+    // drops: the journal must not cover that segment anymore, since its data on the flash is corrupted.
+    uint32_t interruptOffset = sizeof(image) / 2;
+    for (uint32_t offset = 0; offset < interruptOffset; offset += OTA_SAMPLE_SEGMENT_SIZE) {
+        sendOtaSegment(echoSession, gadgetSession, image, sizeof(image), offset, &image[offset]);
+    }
+    uint32_t resendOffset = interruptOffset - OTA_SAMPLE_SEGMENT_SIZE;
+    static uint8_t corruptedSegment[OTA_SAMPLE_SEGMENT_SIZE];
+    memcpy(corruptedSegment, &image[resendOffset], sizeof(corruptedSegment));
+    corruptedSegment[sizeof(corruptedSegment) / 2] ^= 0xFFU;
+    sendOtaSegment(echoSession, gadgetSession, image, sizeof(image), resendOffset, corruptedSegment);
+    size_t journalCount = receiver.journalCount;
+
+    // The gadget reboots: only the flash and its journal are left.
+    FileFlash_close(&flash);
+    FileFlash_init(&flash, ".");
+    OtaReceiver_init(&receiver, FileFlash_getBackend(&flash));
+    bool resumed = OtaReceiver_resume(&receiver);
+    assert(resumed);
+
+    // The Echo device starts the update over, and the gadget answers the first segment with its resume point.
+    echoSession->peerOtaResumeOffset = 0;
+    sendOtaSegment(echoSession, gadgetSession, image, sizeof(image), 0, NULL);
+    uint32_t resumeOffset = echoSession->peerOtaResumeOffset;
+    assert(resumeOffset == resendOffset);
+    for (uint32_t offset = resumeOffset; offset < sizeof(image); offset += OTA_SAMPLE_SEGMENT_SIZE) {
+        sendOtaSegment(echoSession, gadgetSession, image, sizeof(image), offset, &image[offset]);
+    }
+    ApplyFirmware applyFirmware;
+    initOtaSampleApplyFirmware(&applyFirmware, image, sizeof(image));
+    packet_queue_t txPackets = {};
+    if (!createApplyFirmwareCommand(echoSession, &applyFirmware, &txPackets)) {
+        fprintf(stderr, "%s: Could not create  message. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    exchangePackets(echoSession, gadgetSession, &txPackets);
+    journalCount += receiver.journalCount;
+    GadgetSession_setOtaReceiver(gadgetSession, NULL);
+    // The update is over, so the journal is erased.
+    uint8_t journal[OTA_JOURNAL_SIZE];
+    assert(!flash.backend.loadJournal(flash.backend.context, journal, sizeof(journal)));
+    FileFlash_close(&flash);
+    checkOtaSampleComponent(image, sizeof(image));
+
+    printf("OTA resume :: Component [%zu] bytes :: Resumed at [%u] :: Sent after the reboot [%zu] bytes :: "
+           "Journals [%zu] of [%u] bytes\n", sizeof(image), resumeOffset, sizeof(image) - resumeOffset,
+           journalCount, OTA_JOURNAL_SIZE);
+}
+
+static void sampleTxSink(void *context, uint8_t const *data, size_t dataSize) {
+    gadget_session_t *echoSession = context;
+    int indentSize = printf(">>>>> Gadget TX sink sends: ");
+    printHexBuffer(data, dataSize, indentSize);
+    // Loop the packet straight back to the Echo device, as if it had been sent over the air.
+    packet_list_t node = {.packet = {.dataSize = dataSize, .data = (uint8_t *) data}, .next = NULL};
+    packet_queue_t rxPackets = {.head = &node, .tail = &node, .size = 1};
+    packet_queue_t responsePackets = {};
+    receivePackets(echoSession, ROLE_ECHO, &rxPackets, &responsePackets);
     // No further responses sent from Echo device.
-    assert(responseList == NULL);
+    assert(responsePackets.head == NULL);
+}
+
+void runSampleTxSink(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    printf("=================================================================================\n");
+    printf("runSample for handshake: GetDeviceInformation (TX sink)\n");
+    printf("=================================================================================\n");
+    printf("<<<<< Sending a message from Echo -> Gadget:\n");
+    packet_queue_t txPackets = {};
+    if (!createCommandGetDeviceInformation(echoSession, &txPackets)) {
+        fprintf(stderr, "%s: Could not create  message. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    PacketList_PrintAll(txPackets.head);
+    printf("----- Gadget receives the message -----\n");
+    GadgetSession_setTxSink(gadgetSession, sampleTxSink, echoSession);
+    packet_queue_t responsePackets = {};
+    receivePackets(gadgetSession, ROLE_GADGET, &txPackets, &responsePackets);
+    GadgetSession_setTxSink(gadgetSession, NULL, NULL);
+    // Every response packet already went out through the sink.
+    assert(responsePackets.head == NULL);
+    PacketQueue_free(&txPackets);
+}
+
+void runSampleFragmentPool(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    // The pool is owned by the application and can be shared by all connections whose packets fit its buffers.
+    fragment_pool_t *const txPool = FragmentPool_create(NULL, gadgetSession->maxPacketSize);
+    if (!txPool) {
+        fprintf(stderr, "%s: Could not create the TX pool\n", __FUNCTION__);
+        return;
+    }
+    GadgetSession_setTxPool(gadgetSession, txPool);
+    runSample(echoSession, gadgetSession, createCommandGetDeviceInformation, "GetDeviceInformation (TX pool)");
+    runSample(echoSession, gadgetSession, createAlexaDiscoveryDiscoverDirective, "AlexaDiscovery (TX pool)");
+    GadgetSession_setTxPool(gadgetSession, NULL);
+
+    fragment_pool_stats_t stats;
+    FragmentPool_getStats(txPool, &stats);
+    // All packets were returned to the pool by PacketQueue_free().
+    assert(stats.inUse == 0);
+    printf("TX pool :: Capacity [%zu] of [%zu] bytes :: In use [%zu] :: High water mark [%zu] :: Allocations [%zu] :: "
+           "Exhausted [%zu]\n", stats.capacity, stats.bufferSize, stats.inUse, stats.highWaterMark, stats.allocCount,
+           stats.exhaustedCount);
+    FragmentPool_destroy(txPool);
+}
+
+void runSampleResponseCache(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    // Encode the fixed responses once, e.g. at boot, for the MTU the connections use.
+    response_cache_t *const responseCache = ResponseCache_create();
+    if (!responseCache || !ResponseCache_prepare(responseCache, gadgetSession->mtu)) {
+        fprintf(stderr, "Could not prepare the response cache. Exiting");
+        exit(1);
+    }
+    GadgetSession_setResponseCache(gadgetSession, responseCache);
+    runSample(echoSession, gadgetSession, createCommandGetDeviceInformation, "GetDeviceInformation (cached)");
+    runSample(echoSession, gadgetSession, createAlexaDiscoveryDiscoverDirective, "AlexaDiscovery (cached)");
+    GadgetSession_setResponseCache(gadgetSession, NULL);
+    response_cache_stats_t stats;
+    ResponseCache_getStats(responseCache, &stats);
+    printf("Response cache :: Entries [%zu] :: Hits [%zu] :: Misses [%zu]\n", stats.numEntries, stats.hits,
+           stats.misses);
+    ResponseCache_destroy(responseCache);
+}
+
+typedef struct {
+    size_t allocCount;
+    size_t freeCount;
+} allocation_counter_t;
+
+static void *countingAlloc(void *context, size_t size) {
+    allocation_counter_t *const counter = context;
+    counter->allocCount++;
+    return malloc(size);
+}
+
+static void countingFree(void *context, void *ptr) {
+    allocation_counter_t *const counter = context;
+    counter->freeCount++;
+    free(ptr);
+}
+
+void runSampleArenaAllocator(gadget_session_t *echoSession, gadget_session_t *gadgetSession) {
+    static uint8_t arenaBuffer[4096];
+    gadget_arena_t arena;
+    GadgetArena_init(&arena, arenaBuffer, sizeof(arenaBuffer));
+    // Count the allocations of the Echo side with an allocator of its own session. The default allocator is left
+    // alone, since memory must be returned to the allocator it came from.
+    allocation_counter_t counter = {};
+    gadget_allocator_t const countingAllocator = {countingAlloc, countingFree, &counter};
+    GadgetSession_setAllocator(echoSession, &countingAllocator);
+
+    // The gadget allocates the packets and buffers of the handshake from the arena, and releases them all at once.
+    GadgetSession_setAllocator(gadgetSession, GadgetArena_getAllocator(&arena));
+    runSample(echoSession, gadgetSession, createCommandGetDeviceInformation, "GetDeviceInformation (arena)");
+    runSample(echoSession, gadgetSession, createCommandGetDeviceFeatures, "GetDeviceFeatures (arena)");
+    GadgetSession_setAllocator(gadgetSession, NULL);
+    GadgetSession_setAllocator(echoSession, NULL);
+
+    printf("Arena :: Allocations [%zu] :: Peak [%zu/%zu] bytes :: Failed [%zu]\n", arena.allocCount, arena.peak,
+           arena.size, arena.failedCount);
+    printf("Echo session allocator :: Allocations [%zu] :: Frees [%zu]\n", counter.allocCount, counter.freeCount);
+    GadgetArena_reset(&arena);
+}
+
+// Bytes of stack painted, more than the measured calls use.
+#define STACK_PAINT_SIZE (16U * 1024U)
+// Bytes left unpainted right below the bound, for the frames of paintStack() and measureStack() themselves.
+#define STACK_PAINT_GAP (256U)
+#define STACK_PAINT_PATTERN (0xA5U)
+
+// Fills the area of the stack that ends STACK_PAINT_GAP bytes below bound with a pattern. Stacks grow downwards, so
+// the area is below the frame that bound belongs to. It is addressed from an integer, so that the compiler makes no
+// assumption about what it holds.
+static __attribute__((noinline)) void paintStack(uintptr_t bound) {
+    uint8_t volatile *const area = (uint8_t volatile *) (bound - STACK_PAINT_GAP - STACK_PAINT_SIZE);
+    for (size_t index = 0; index < STACK_PAINT_SIZE; index++) {
+        area[index] = STACK_PAINT_PATTERN;
+    }
+}
+
+// Returns how many bytes below bound have been used since paintStack(bound), down to the lowest painted byte that
+// does not hold the pattern anymore.
+static __attribute__((noinline)) size_t measureStack(uintptr_t bound) {
+    uint8_t const volatile *const area = (uint8_t const volatile *) (bound - STACK_PAINT_GAP - STACK_PAINT_SIZE);
+    size_t index = 0;
+    while (index < STACK_PAINT_SIZE && area[index] == STACK_PAINT_PATTERN) {
+        index++;
+    }
+    return STACK_PAINT_GAP + STACK_PAINT_SIZE - index;
+}
+
+// Calls function and returns the stack high-water mark of the call. The painted area is bounded by the frame of this
+// function, which stays live until the area is measured.
+static __attribute__((noinline)) size_t measureStackHighWater(void (*function)(void *), void *argument) {
+    uintptr_t const bound = (uintptr_t) __builtin_frame_address(0);
+    paintStack(bound);
+    function(argument);
+    return measureStack(bound);
+}
+
+typedef struct {
+    discovery_endpoint_t const *endpoint;
+    uint8_t *encoded;
+    size_t encodedSize;
+} discovery_encoding_t;
+
+static void encodeDiscoveryResponse(void *argument) {
+    discovery_encoding_t *const encoding = argument;
+    encoding->encoded = DiscoveryResponse_encode(encoding->endpoint, NULL, &encoding->encodedSize);
+}
+
+void runSampleDiscoveryFootprint() {
+    printf("=================================================================================\n");
+    printf("runSample for Discover.Response footprint\n");
+    printf("=================================================================================\n");
+    // The largest endpoint Echo devices support, as a const table.
+    static char const *const supportedTypes[DISCOVERY_MAX_SUPPORTED_TYPES] = {
+            "type 0", "type 1", "type 2", "type 3", "type 4", "type 5", "type 6", "type 7", "type 8", "type 9"};
+    static discovery_capability_t capabilities[DISCOVERY_MAX_CAPABILITIES];
+    for (size_t index = 0; index < DISCOVERY_MAX_CAPABILITIES; index++) {
+        capabilities[index] = (discovery_capability_t) {"AlexaInterface", "Alexa.Gadget.StateListener", "1.0",
+                                                        supportedTypes, DISCOVERY_MAX_SUPPORTED_TYPES};
+    }
+    discovery_endpoint_t const endpoint = {
+            .endpointId = "test id",
+            .friendlyName = "friendly name",
+            .capabilities = capabilities,
+            .numCapabilities = DISCOVERY_MAX_CAPABILITIES,
+            .deviceToken = "xxxxxxxxx",
+    };
+
+    // DiscoveryResponse_encode() fills the event on the stack, so the high-water mark includes the event struct.
+    discovery_encoding_t encoding = {.endpoint = &endpoint};
+    size_t stackUsed = measureStackHighWater(encodeDiscoveryResponse, &encoding);
+    if (!encoding.encoded) {
+        fprintf(stderr, "%s: Could not encode the event\n", __FUNCTION__);
+        return;
+    }
+    GadgetAllocator_free(NULL, encoding.encoded);
+
+    printf("Encoding %zu capabilities of %u supported types :: Encoded [%zu] bytes\n", endpoint.numCapabilities,
+           DISCOVERY_MAX_SUPPORTED_TYPES, encoding.encodedSize);
+    printf("Event struct [%zu] bytes :: Stack high-water [%zu] bytes, event struct included\n",
+           sizeof(alexaDiscovery_DiscoverResponseEventProto), stackUsed);
+}
 
-    PacketList_freeList(txPackets);
-    PacketList_freeList(responseList);
+// Appends by walking to the tail of the list, as a packet list without a tail pointer has to.
+static packet_list_t *appendToListTail(packet_list_t *list, packet_t const *packet) {
+    packet_list_t *node = malloc(sizeof(packet_list_t));
+    if (!node) {
+        fprintf(stderr, "%s: malloc failed. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    node->packet = *packet;
+    node->next = NULL;
+    if (!list) return node;
+    packet_list_t *tail = list;
+    while (tail->next) {
+        tail = tail->next;
+    }
+    tail->next = node;
+    return list;
 }
 
-packet_list_t *testMyPacketCapturesFromEchoDevice() {
+static double getElapsedUs(clock_t start) {
+    return (double) (clock() - start) * 1000000.0 / CLOCKS_PER_SEC;
+}
+
+// Fragments a transaction with the stream fragmenter, appending each packet by walking to the tail of the list.
+static packet_list_t *fragmentToListTail(gadget_session_t *session, uint8_t const *payload, size_t payloadSize) {
+    stream_fragmenter_t fragmenter;
+    if (!StreamFragmenter_init(&fragmenter, session, OTA_STREAM, true, payload, payloadSize)) {
+        return NULL;
+    }
+    packet_list_t *list = NULL;
+    fragment_t fragment;
+    while (StreamFragmenter_next(&fragmenter, &fragment)) {
+        packet_t packet = {};
+        if (!allocTxPacket(session, &packet, fragment.headerSize + fragment.payloadSize)) {
+            fprintf(stderr, "%s: Failed to allocate memory for TX packet\n", __FUNCTION__);
+            break;
+        }
+        memcpy(packet.data, fragment.header, fragment.headerSize);
+        memcpy(&packet.data[fragment.headerSize], fragment.payload, fragment.payloadSize);
+        list = appendToListTail(list, &packet);
+    }
+    return list;
+}
+
+// Number of times each transaction is built, so that the timings of small transactions are above the clock resolution.
+#define SAMPLE_BENCHMARK_ITERATIONS (5U)
+
+void runSampleBenchmarkPacketQueue() {
+    printf("=================================================================================\n");
+    printf("runSample of packet queue benchmark\n");
+    printf("=================================================================================\n");
+    // The minimum MTU gives the most packets per transaction. The session accepts transactions up to 0xffff bytes,
+    // as it does once the Protocol Version packet of a peer advertises them.
+    gadget_session_t session;
+    GadgetSession_init(&session, ATT_MTU_MIN);
+    session.peerMaxTransactionSize = UINT16_MAX;
+    size_t const transactionSizes[] = {5000, UINT16_MAX};
+    uint8_t *const payload = GadgetAllocator_alloc(NULL, UINT16_MAX);
+    if (!payload) {
+        fprintf(stderr, "%s: Failed to allocate the payload\n", __FUNCTION__);
+        GadgetSession_deinit(&session);
+        return;
+    }
+    memset(payload, 0xAA, UINT16_MAX);
+
+    for (size_t i = 0; i < ARRAY_SIZE(transactionSizes); i++) {
+        size_t numListPackets = 0;
+        clock_t start = clock();
+        for (size_t j = 0; j < SAMPLE_BENCHMARK_ITERATIONS; j++) {
+            packet_list_t *list = fragmentToListTail(&session, payload, transactionSizes[i]);
+            numListPackets = 0;
+            for (packet_list_t const *node = list; node != NULL; node = node->next) {
+                numListPackets++;
+            }
+            PacketList_freeList(list);
+        }
+        double listUs = getElapsedUs(start) / SAMPLE_BENCHMARK_ITERATIONS;
+
+        size_t numQueuePackets = 0;
+        start = clock();
+        for (size_t j = 0; j < SAMPLE_BENCHMARK_ITERATIONS; j++) {
+            packet_queue_t queue = {};
+            if (!createOtaData(&session, payload, transactionSizes[i], &queue)) {
+                fprintf(stderr, "%s: Failed to build the transaction\n", __FUNCTION__);
+            }
+            numQueuePackets = queue.size;
+            PacketQueue_free(&queue);
+        }
+        double queueUs = getElapsedUs(start) / SAMPLE_BENCHMARK_ITERATIONS;
+        if (numQueuePackets != numListPackets) {
+            fprintf(stderr, "%s: The fragmenter did not build the same packets\n", __FUNCTION__);
+        }
+
+        printf("Transaction [%zu] :: Packets [%zu] :: Iterations [%u] :: List tail walk [%.0f us] :: Queue [%.0f us]\n",
+               transactionSizes[i], numListPackets, SAMPLE_BENCHMARK_ITERATIONS, listUs, queueUs);
+    }
+    GadgetAllocator_free(NULL, payload);
+    GadgetSession_deinit(&session);
+}
+
+bool testMyPacketCapturesFromEchoDevice(gadget_session_t *session, packet_queue_t *queue) {
     // Replace these payloads with your own BLE packet captures.
     uint8_t packet1[] = {0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x08, 0x14};
     uint8_t packet2[] = {0x02, 0x00, 0x00, 0x00, 0x02, 0x02, 0x08, 0x1c};
@@ -80,38 +692,69 @@ packet_list_t *testMyPacketCapturesFromEchoDevice() {
     uint8_t *capturedBlePackets[] = {packet1, packet2};
     size_t capturedBlePacketSizes[] = {ARRAY_SIZE(packet1), ARRAY_SIZE(packet2)};
 
-    packet_list_t *packetList = NULL;
     for (size_t i = 0; i < ARRAY_SIZE(capturedBlePackets); i++) {
         packet_t packet = {};
         packet.data = malloc(capturedBlePacketSizes[i]);
         if (!packet.data) {
             fprintf(stderr, "%s: malloc failed\n", __FUNCTION__);
-            return packetList;
+            return false;
         }
         memcpy(packet.data, capturedBlePackets[i], capturedBlePacketSizes[i]);
         packet.dataSize = capturedBlePacketSizes[i];
-        packetList = PacketList_addToTail(packetList, &packet);
+        if (!PacketQueue_push(queue, &packet)) {
+            return false;
+        }
     }
-    return packetList;
+    return true;
 }
 
 int main(int argc, char *argv[]) {
+    if (!initSampleDiscoveryEndpoint()) {
+        fprintf(stderr, "%s: Could not compute the device token. Exiting", __FUNCTION__);
+        exit(1);
+    }
+    gadget_session_t echoSession, gadgetSession;
+    GadgetSession_init(&echoSession, SAMPLE_NEGOTIATED_MTU);
+    GadgetSession_init(&gadgetSession, SAMPLE_NEGOTIATED_MTU);
 
     runSampleCreateAdvertisingPacket();
 
-    runSampleProtocolVersionPacket();
+    runSampleProtocolVersionPacket(&echoSession, &gadgetSession);
+
+    runSample(&echoSession, &gadgetSession, createCommandGetDeviceInformation, "GetDeviceInformation");
 
-    runSample(createCommandGetDeviceInformation(), "GetDeviceInformation");
+    runSample(&echoSession, &gadgetSession, createCommandGetDeviceFeatures, "GetDeviceFeatures");
 
-    runSample(createCommandGetDeviceFeatures(), "GetDeviceFeatures");
+    runSample(&echoSession, &gadgetSession, createCommandUpdateComponentSegment, "UpdateComponentSegment");
 
-    runSample(createCommandUpdateComponentSegment(), "UpdateComponentSegment");
+    runSample(&echoSession, &gadgetSession, createCommandApplyFirmware, "ApplyFirmware");
 
-    runSample(createCommandApplyFirmware(), "ApplyFirmware");
+    runSample(&echoSession, &gadgetSession, createAlexaDiscoveryDiscoverDirective, "AlexaDiscovery");
 
-    runSample(createAlexaDiscoveryDiscoverDirective(), "AlexaDiscovery");
+    runSampleStreamedDirective(&echoSession, &gadgetSession);
+
+    runSampleWakewordFastPath(&echoSession, &gadgetSession);
+
+    runSampleOta(&echoSession, &gadgetSession);
+
+    runSampleOtaResume(&echoSession, &gadgetSession);
+
+    runSampleTxSink(&echoSession, &gadgetSession);
+
+    runSampleFragmentPool(&echoSession, &gadgetSession);
+
+    runSampleArenaAllocator(&echoSession, &gadgetSession);
+
+    runSampleResponseCache(&echoSession, &gadgetSession);
+
+    runSampleDiscoveryFootprint();
+
+    runSampleBenchmarkPacketQueue();
 
     // Test your packet captures here...
-    runSample(testMyPacketCapturesFromEchoDevice(), "TestMyPacketCaptures");
+    runSample(&echoSession, &gadgetSession, testMyPacketCapturesFromEchoDevice, "TestMyPacketCaptures");
+
+    GadgetSession_deinit(&echoSession);
+    GadgetSession_deinit(&gadgetSession);
 
 }
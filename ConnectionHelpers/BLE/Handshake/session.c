@@ -0,0 +1,109 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "common.h"
+#include "helpers.h"
+#include "session.h"
+
+void GadgetSession_init(gadget_session_t *const session, uint16_t negotiatedMtu) {
+    memset(session, 0, sizeof(*session));
+    if (negotiatedMtu < ATT_MTU_MIN) {
+        negotiatedMtu = ATT_MTU_MIN;
+    } else if (negotiatedMtu > ATT_MTU_MAX) {
+        negotiatedMtu = ATT_MTU_MAX;
+    }
+    session->mtu = negotiatedMtu;
+    session->maxPacketSize = negotiatedMtu - ATT_HEADER_SIZE;
+    session->maxTransactionSize = SAMPLE_MAX_TRANSACTION_SIZE;
+    session->peerMaxTransactionSize = SAMPLE_MAX_TRANSACTION_SIZE;
+    // The first transaction on each stream gets id 0.
+    memset(session->lastTransactionId, TRANSACTION_ID_MASK, sizeof(session->lastTransactionId));
+}
+
+bool GadgetSession_handleProtocolVersionPacket(gadget_session_t *const session, packet_t const *const packet) {
+    printf("Inside %s\n", __FUNCTION__);
+    if (!packet || !packet->data || packet->dataSize < PROTOCOL_VERSION_PACKET_SIZE) {
+        fprintf(stderr, "Insufficient Length :: Protocol Version Packet\n");
+        return false;
+    }
+    uint8_t const *const buffer = packet->data;
+    uint16_t identifier = (buffer[0] << 8U) | buffer[1];
+    if (identifier != PROTOCOL_IDENTIFIER) {
+        fprintf(stderr, "Invalid protocol identifier [0x%04x]\n", identifier);
+        return false;
+    }
+    if (buffer[2] != PROTOCOL_VERSION_MAJOR) {
+        fprintf(stderr, "Unsupported protocol version [%u.%u]\n", buffer[2], buffer[3]);
+        return false;
+    }
+    uint16_t peerMtu = (buffer[4] << 8U) | buffer[5];
+    uint16_t peerMaxTransactionSize = (buffer[6] << 8U) | buffer[7];
+    if (peerMtu < ATT_MTU_MIN || peerMaxTransactionSize == 0) {
+        fprintf(stderr, "Invalid Protocol Version Packet :: MTU [%u] :: Max transaction size [%u]\n", peerMtu,
+                peerMaxTransactionSize);
+        return false;
+    }
+
+    session->peerProtocolVersionMajor = buffer[2];
+    session->peerProtocolVersionMinor = buffer[3];
+    session->mtu = MIN(session->mtu, peerMtu);
+    session->maxPacketSize = session->mtu - ATT_HEADER_SIZE;
+    session->peerMaxTransactionSize = peerMaxTransactionSize;
+    printf("Peer protocol version [%u.%u] :: MTU [%u] :: Max transaction size [%u]\n",
+           session->peerProtocolVersionMajor, session->peerProtocolVersionMinor, session->mtu,
+           session->peerMaxTransactionSize);
+    return true;
+}
+
+void GadgetSession_setDirectiveHandler(gadget_session_t *const session, directive_handler_t const *const handler,
+                                       void *const context) {
+    session->directiveHandler = handler;
+    session->directiveHandlerContext = context;
+}
+
+void GadgetSession_setWakewordHandler(gadget_session_t *const session, wakeword_handler_t handler,
+                                      void *const context) {
+    session->wakewordMatcher.handler = handler;
+    session->wakewordMatcher.context = context;
+}
+
+void GadgetSession_setOtaReceiver(gadget_session_t *const session, ota_receiver_t *const receiver) {
+    session->otaReceiver = receiver;
+}
+
+void GadgetSession_setTxSink(gadget_session_t *const session, tx_sink_t sink, void *const context) {
+    session->txSink = sink;
+    session->txSinkContext = context;
+}
+
+void GadgetSession_setTxPool(gadget_session_t *const session, fragment_pool_t *const pool) {
+    session->txPool = pool;
+}
+
+void GadgetSession_setAllocator(gadget_session_t *const session, gadget_allocator_t const *const allocator) {
+    session->allocator = allocator;
+}
+
+void GadgetSession_setResponseCache(gadget_session_t *const session, struct response_cache_s *const cache) {
+    session->responseCache = cache;
+}
+
+void GadgetSession_deinit(gadget_session_t *const session) {
+    for (size_t i = 0; i < ARRAY_SIZE(session->rxBuffers); i++) {
+        if (session->rxBuffers[i] != NULL) {
+            if (!session->rxBuffers[i]->isStatic) {
+                GadgetAllocator_free(session->allocator, session->rxBuffers[i]);
+            }
+            session->rxBuffers[i] = NULL;
+        }
+    }
+}
@@ -0,0 +1,213 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_SESSION_H
+#define ALEXA_GADGETS_SAMPLE_CODE_SESSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "common.h"
+#include "directive_stream.h"
+#include "fragment_pool.h"
+#include "helpers.h"
+#include "ota.h"
+#include "wakeword_matcher.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Callback that transmits a single packet to the peer.
+ * @param context the context registered along with the callback.
+ * @param data the packet. It is only valid for the duration of the call.
+ * @param dataSize the packet size in bytes, at most the session maxPacketSize.
+ * @sa GadgetSession_setTxSink().
+ */
+typedef void (*tx_sink_t)(void *context, uint8_t const *data, size_t dataSize);
+
+/**
+ * A transaction being reassembled by rx.c.
+ * The data either points into the session's preallocated reassembly storage or follows the structure in the same
+ * heap allocation. Streamed transactions are decoded or written as they arrive and have no data.
+ */
+typedef struct rx_buffer_s {
+    transaction_id_t transactionId;
+    stream_id_t streamId;
+    uint8_t seqNum;
+    bool isStatic;
+    bool isStreamed;
+    size_t bufferSize;
+    size_t dataSize;
+    uint8_t *data;
+} rx_buffer_t;
+
+/**
+ * The parameters and protocol state of a single BLE connection between the gadget and an Echo device.
+ * Every TX and RX function takes the session so that each connection uses the packet size it negotiated.
+ * All TX and RX state lives in the session, so connections with different sessions can be handled side by side,
+ * including on different threads, without locking. A single session must not be used by two threads at once.
+ * @sa GadgetSession_init().
+ * @sa GadgetSession_handleProtocolVersionPacket().
+ * @sa GadgetSession_deinit().
+ */
+typedef struct {
+    /// ATT MTU negotiated on the bearer, lowered to the peer's one, and advertised in the Protocol Version packet.
+    uint16_t mtu;
+    /// Maximum size of a single packet: the ATT MTU less the ATT header of the notification or write carrying it.
+    uint16_t maxPacketSize;
+    /// Maximum transaction size this side can receive, as advertised in the Protocol Version packet.
+    uint16_t maxTransactionSize;
+    /// Maximum transaction size the peer can receive. Set from the peer's Protocol Version packet.
+    uint16_t peerMaxTransactionSize;
+    uint8_t peerProtocolVersionMajor;
+    uint8_t peerProtocolVersionMinor;
+    /// Last transaction id sent on each stream, indexed with streamToIndex().
+    transaction_id_t lastTransactionId[NUM_STREAMS];
+    /// Transaction being reassembled on each stream, indexed with streamToIndex(). Owned by rx.c.
+    rx_buffer_t *rxBuffers[NUM_STREAMS];
+#if SAMPLE_STATIC_RX_BUFFERS
+    /// Preallocated reassembly storage for each stream, used for transactions that fit the advertised maximum.
+    rx_buffer_t rxStaticBuffers[NUM_STREAMS];
+    uint8_t rxStaticData[NUM_STREAMS][SAMPLE_MAX_TRANSACTION_SIZE];
+#endif
+    /// Application callbacks for Alexa directives. When set, directives are decoded while they are being received.
+    directive_handler_t const *directiveHandler;
+    void *directiveHandlerContext;
+    /// Decoder of the directive being received, when directiveHandler is set. Owned by rx.c.
+    directive_stream_t directiveStream;
+    /// Spots wakeword transitions in ALEXA_STREAM packets when its handler is set. Owned by rx.c.
+    wakeword_matcher_t wakewordMatcher;
+    /// When set, OTA_STREAM data is written to this receiver as it arrives instead of being reassembled.
+    ota_receiver_t *otaReceiver;
+    /// Bytes of its OTA component the peer holds, from the last UpdateComponentSegment response with a resume point.
+    /// Resume points are a convention of this sample, see createResponseUpdateComponentSegmentResume().
+    uint32_t peerOtaResumeOffset;
+    /// When set, TX packets are passed to this callback as they are produced instead of being returned in a list.
+    tx_sink_t txSink;
+    void *txSinkContext;
+    /// When set, TX packets are allocated from this pool, and from the heap only when it is exhausted.
+    fragment_pool_t *txPool;
+    /// Allocator of the TX packets and RX buffers of the session. NULL for the default gadget allocator.
+    gadget_allocator_t const *allocator;
+    /// When set, the fixed responses are sent from this cache instead of being encoded. See response_cache.h.
+    struct response_cache_s *responseCache;
+} gadget_session_t;
+
+/**
+ * Initializes a session for a new connection.
+ * @param session the session to initialize.
+ * @param negotiatedMtu the ATT MTU negotiated with the peer. It is clamped to [ATT_MTU_MIN, ATT_MTU_MAX], and packets
+ * are ATT_HEADER_SIZE bytes smaller.
+ * Until the peer's Protocol Version packet is received, the peer is assumed to accept transactions of up to
+ * SAMPLE_MAX_TRANSACTION_SIZE bytes.
+ */
+void GadgetSession_init(gadget_session_t *session, uint16_t negotiatedMtu);
+
+/**
+ * Updates the session with the limits advertised in the peer's Protocol Version packet.
+ * The session MTU is lowered to the peer's MTU if that is smaller than the negotiated one.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/bluetooth-le-settings.html#pvp
+ * @param session the session of the connection the packet was received on.
+ * @param packet the received Protocol Version packet.
+ * @return false if the packet is malformed or announces an unsupported major protocol version.
+ */
+bool GadgetSession_handleProtocolVersionPacket(gadget_session_t *session, packet_t const *packet);
+
+/**
+ * Registers the application callbacks for the Alexa directives received by the gadget.
+ * Once set, the payload of each ALEXA_STREAM packet is fed to a directive_stream_t as soon as the packet is received
+ * instead of being reassembled first. The header is passed to the handler as soon as it is complete, and the
+ * directive payload is passed through in chunks, so no reassembly buffer is allocated for the directive.
+ * The payload chunks are still encoded: only the header is decoded as it arrives. A handler that needs the decoded
+ * payload buffers it for the directives it routes and decodes it once onComplete is called, see directive_stream_t.
+ * @param session the session of the connection the directives are received on.
+ * @param handler the application callbacks, or NULL to go back to reassembling whole directives.
+ * @param context passed as is to the callbacks.
+ */
+void GadgetSession_setDirectiveHandler(gadget_session_t *session, directive_handler_t const *handler,
+                                       void *context);
+
+/**
+ * Registers the callback that signals the wakeword state transitions sent in Alexa.Gadget.StateListener StateUpdate
+ * directives, e.g. to light up the gadget as soon as the wake word is detected.
+ * The raw payload of each ALEXA_STREAM packet is matched against the encoded wakeword state as soon as the packet is
+ * received, before the directive is reassembled or decoded and before it is passed to the directive handler, so the
+ * callback can run before the last packet of the directive has arrived. The directive is still dispatched as usual
+ * afterwards, and remains the reference if it then fails to be received or decoded.
+ * @param session the session of the connection the directives are received on.
+ * @param handler the callback, or NULL to stop matching.
+ * @param context passed as is to the callback.
+ */
+void GadgetSession_setWakewordHandler(gadget_session_t *session, wakeword_handler_t handler, void *context);
+
+/**
+ * Makes the session receive firmware updates: the UpdateComponentSegment and ApplyFirmware commands are passed to
+ * \p receiver, and the payload of each OTA_STREAM packet is written to it as soon as the packet is received, so OTA
+ * transactions are never reassembled.
+ * @param session the session of the connection the updates are received on.
+ * @param receiver the receiver, owned by the application, or NULL to reject OTA data.
+ */
+void GadgetSession_setOtaReceiver(gadget_session_t *session, ota_receiver_t *receiver);
+
+/**
+ * Registers the callback that transmits the packets produced on the session.
+ * Once set, the packets built by tx.c and the responses and ACKs produced by receivePackets() are passed to the
+ * callback one at a time, as soon as each is complete, and are not allocated or returned in a packet_list_t.
+ * The first packet of a response can thus be on air before the rest of the response is encoded.
+ * @param session the session of the connection to transmit on.
+ * @param sink the callback, or NULL to go back to returning packet lists.
+ * @param context passed as is to the callback.
+ */
+void GadgetSession_setTxSink(gadget_session_t *session, tx_sink_t sink, void *context);
+
+/**
+ * Makes the session allocate its TX packets from a fragment pool instead of the heap.
+ * freePacket() and PacketQueue_free() return the packets to the pool. If the pool is exhausted, the packet is
+ * allocated from the session allocator and the pool counts the exhaustion in its statistics.
+ * @param session the session of the connection to transmit on.
+ * Packets larger than the buffers of the pool, e.g. after a larger MTU was negotiated, are allocated from the session
+ * allocator as well.
+ * @param pool the pool, owned by the application. It can be shared by several sessions and must outlive all the
+ * packets allocated from it. NULL to go back to allocating from the heap.
+ */
+void GadgetSession_setTxPool(gadget_session_t *session, fragment_pool_t *pool);
+
+/**
+ * Makes the session allocate its TX packets and RX reassembly buffers from \p allocator, e.g. a gadget_arena_t that
+ * is reset once the handshake is complete.
+ * Set it while no RX transaction is in progress, since RX buffers are released to the session allocator.
+ * TX packets remember their allocator, so they can be freed after the allocator of the session has changed.
+ * @param session the session.
+ * @param allocator the allocator, or NULL to use the default gadget allocator. It must outlive the memory allocated
+ * from it.
+ */
+void GadgetSession_setAllocator(gadget_session_t *session, gadget_allocator_t const *allocator);
+
+/**
+ * Makes the session answer the requests for the responses of response_cache_id_t from a cache of pre-encoded packets.
+ * Responses that are not in the cache for the session MTU are encoded as usual.
+ * @param session the session.
+ * @param cache the cache, owned by the application, or NULL to always encode the responses.
+ */
+void GadgetSession_setResponseCache(gadget_session_t *session, struct response_cache_s *cache);
+
+/**
+ * Releases the transactions that are still being reassembled when the connection goes away.
+ * The session can be initialized again with GadgetSession_init() afterwards.
+ * @param session the session to release.
+ */
+void GadgetSession_deinit(gadget_session_t *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_SESSION_H
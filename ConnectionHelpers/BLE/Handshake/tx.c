@@ -12,41 +12,53 @@
 #include <string.h>
 
 #include "accessories.pb.h"
+#include "allocator.h"
 #include "common.h"
+#include "discovery.h"
+#include "fragment_pool.h"
 #include "helpers.h"
 #include "pb.h"
 #include "pb_encode.h"
+#include "session.h"
+#include "tx.h"
 
-static transaction_id_t getNextTransactionId(stream_id_t streamId) {
-    static uint8_t lastTransactionId[3] = {0xff, 0xff, 0xff};
-
+transaction_id_t getNextTransactionId(gadget_session_t *const session, stream_id_t streamId) {
     int index = streamToIndex(streamId);
     if (index < 0) {
         return 0;
     }
 
-    lastTransactionId[index] = (lastTransactionId[index] + 1) & 0x0f; // TransactionId is 4-bits only.
-    return lastTransactionId[index];
+    // TransactionId is 4-bits only.
+    session->lastTransactionId[index] = (session->lastTransactionId[index] + 1) & TRANSACTION_ID_MASK;
+    return session->lastTransactionId[index];
 }
 
-packet_t createProtocolVersionPacket() {
+bool allocTxPacket(gadget_session_t *const session, packet_t *const packet, size_t dataSize) {
+    if (session->txPool && FragmentPool_allocPacket(session->txPool, packet, dataSize)) {
+        return true;
+    }
+    packet->data = GadgetAllocator_alloc(session->allocator, dataSize);
+    packet->dataSize = packet->data ? dataSize : 0;
+    // Packets from the default allocator need no hook.
+    packet->release = session->allocator ? GadgetAllocator_releasePacket : NULL;
+    packet->releaseContext = (void *) session->allocator;
+    return packet->data != NULL;
+}
+
+packet_t createProtocolVersionPacket(gadget_session_t *const session) {
     printf("Inside %s\n", __FUNCTION__);
-    uint8_t *buffer = malloc(PROTOCOL_VERSION_PACKET_SIZE);
-    if (buffer) {
+    packet_t packet = {};
+    if (allocTxPacket(session, &packet, PROTOCOL_VERSION_PACKET_SIZE)) {
+        uint8_t *const buffer = packet.data;
         memset(buffer, 0, PROTOCOL_VERSION_PACKET_SIZE);
         buffer[0] = (uint8_t) (PROTOCOL_IDENTIFIER >> 8U);
         buffer[1] = (uint8_t) (PROTOCOL_IDENTIFIER >> 0U);
         buffer[2] = PROTOCOL_VERSION_MAJOR;
         buffer[3] = PROTOCOL_VERSION_MINOR;
-        buffer[4] = (uint8_t) (SAMPLE_NEGOTIATED_MTU >> 8U);
-        buffer[5] = (uint8_t) (SAMPLE_NEGOTIATED_MTU >> 0U);
-        buffer[6] = (uint8_t) (SAMPLE_MAX_TRANSACTION_SIZE >> 8U);
-        buffer[7] = (uint8_t) (SAMPLE_MAX_TRANSACTION_SIZE >> 0U);
-    }
-    packet_t packet = {};
-    if (buffer) {
-        packet.data = buffer;
-        packet.dataSize = PROTOCOL_VERSION_PACKET_SIZE;
+        buffer[4] = (uint8_t) (session->mtu >> 8U);
+        buffer[5] = (uint8_t) (session->mtu >> 0U);
+        buffer[6] = (uint8_t) (session->maxTransactionSize >> 8U);
+        buffer[7] = (uint8_t) (session->maxTransactionSize >> 0U);
     }
     return packet;
 }
@@ -54,7 +66,7 @@ packet_t createProtocolVersionPacket() {
 packet_t createAdvertisingPacket() {
     printf("Inside %s\n", __FUNCTION__);
     // Advertising data (AD) is organized in LTV (Length/Tag/Value) triplets.
-    uint8_t *buffer = malloc(ADV_DATA_LEN);
+    uint8_t *buffer = GadgetAllocator_alloc(NULL, ADV_DATA_LEN);
     if (buffer) {
         // Flags
         buffer[0] = 2;    // AD Type Length.
@@ -85,185 +97,335 @@ packet_t createAdvertisingPacket() {
     return packet;
 }
 
-packet_t
-createControlAckPacket(stream_id_t streamId, transaction_id_t transactionId, bool ack, control_ack_result_t result) {
+static void writeControlAckPacket(uint8_t *const buffer, stream_id_t streamId, transaction_id_t transactionId,
+                                  control_ack_result_t result) {
+    buffer[0] = (streamId & STREAM_ID_MASK) << STREAM_ID_SHIFT;
+    buffer[0] |= (transactionId & TRANSACTION_ID_MASK) << TRANSACTION_ID_SHIFT;
+    buffer[1] = (TRANSACTION_TYPE_CONTROL & TRANSACTION_TYPE_MASK) << TRANSACTION_TYPE_SHIFT;
+    buffer[1] |= (result == CONTROL_PACKET_RESULT_SUCCESS) ? (1U << ACK_BIT_SHIFT) : 0;
+    buffer[2] = 0; // Reserved.
+    buffer[3] = 2; // Length 2 bytes.
+    buffer[4] = 1; // Reserved
+    buffer[5] = result;
+}
+
+packet_t createControlAckPacket(gadget_session_t *const session, stream_id_t streamId, transaction_id_t transactionId,
+                                bool ack, control_ack_result_t result) {
     packet_t packet = {};
     if (ack == false) return packet;
 
     printf("Inside %s\n", __FUNCTION__);
-    uint8_t *buffer = malloc(CONTROL_PACKET_LENGTH);
-    if (buffer) {
+    if (allocTxPacket(session, &packet, CONTROL_PACKET_LENGTH)) {
+        writeControlAckPacket(packet.data, streamId, transactionId, result);
+    }
+    return packet;
+}
 
-        buffer[0] = (streamId & STREAM_ID_MASK) << STREAM_ID_SHIFT;
-        buffer[0] |= (transactionId & TRANSACTION_ID_MASK) << TRANSACTION_ID_SHIFT;
-        buffer[1] = (TRANSACTION_TYPE_CONTROL & TRANSACTION_TYPE_MASK) << TRANSACTION_TYPE_SHIFT;
-        buffer[1] |= (result == CONTROL_PACKET_RESULT_SUCCESS) ? (1U << ACK_BIT_SHIFT) : 0;
-        buffer[2] = 0; // Reserved.
-        buffer[3] = 2; // Length 2 bytes.
-        buffer[4] = 1; // Reserved
-        buffer[5] = result;
+void sendControlAckPacket(gadget_session_t *const session, stream_id_t streamId, transaction_id_t transactionId,
+                          bool ack, control_ack_result_t result, packet_queue_t *const queue) {
+    if (session->txSink == NULL) {
+        packet_t controlAck = createControlAckPacket(session, streamId, transactionId, ack, result);
+        PacketQueue_push(queue, &controlAck);
+        return;
+    }
+    if (ack == false) return;
 
-        packet.data = buffer;
-        packet.dataSize = CONTROL_PACKET_LENGTH;
+    printf("Inside %s\n", __FUNCTION__);
+    uint8_t buffer[CONTROL_PACKET_LENGTH];
+    writeControlAckPacket(buffer, streamId, transactionId, result);
+    session->txSink(session->txSinkContext, buffer, sizeof(buffer));
+}
+
+static size_t getFragmentPayloadSize(uint16_t maxPacketSize, bool initial, size_t remainingSize,
+                                     bool *extendedLength) {
+    size_t headerSize = initial ? 6 : 3;
+    size_t payloadSize = MIN(maxPacketSize - headerSize, remainingSize);
+    *extendedLength = false;
+    if (payloadSize > 0xff) {
+        *extendedLength = true;
+        headerSize++;
+        if (payloadSize > maxPacketSize - headerSize) {
+            payloadSize--;
+        }
     }
-    return packet;
+    return payloadSize;
+}
+
+static size_t writeFragmentHeader(uint8_t *const header, stream_id_t streamId, transaction_id_t transactionId,
+                                  uint8_t seqNum, transaction_type_t transactionType, bool ack, bool extendedLength,
+                                  size_t transactionSize, size_t payloadSize) {
+    size_t dstIndex = 0;
+    // StreamId: 4 bits
+    header[dstIndex] = (streamId & STREAM_ID_MASK) << STREAM_ID_SHIFT;
+    // TransactionId: 4 bits
+    header[dstIndex] |= (transactionId & TRANSACTION_ID_MASK) << TRANSACTION_ID_SHIFT;
+    dstIndex++;
+
+    // Sequence number: 4 bits
+    header[dstIndex] = (seqNum & SEQ_NUM_ID_MASK) << SEQ_NUM_ID_SHIFT;
+    // Transaction type: 4 bits
+    header[dstIndex] |= (transactionType & TRANSACTION_TYPE_MASK) << TRANSACTION_TYPE_SHIFT;
+    // ACK: 1 bit
+    header[dstIndex] |= (ack) ? (1U << ACK_BIT_SHIFT) : 0;
+    // LengthExtender: 1 bit
+    header[dstIndex] |= (extendedLength) ? (1U << EXTENDED_LENGTH_BIT_SHIFT) : 0;
+    dstIndex++;
+
+    if (transactionType == TRANSACTION_TYPE_INITIAL) {
+        // Reserved: 8 bits
+        header[dstIndex++] = 0x00;
+        // Total transaction length.
+        header[dstIndex++] = transactionSize >> 8U;
+        header[dstIndex++] = transactionSize >> 0U;
+    }
+
+    if (extendedLength) {
+        // ExtendedLength: extra 8 bits in payload length.
+        header[dstIndex++] = payloadSize >> 8U;
+    }
+    // Length: 8 bits.
+    header[dstIndex++] = payloadSize >> 0U;
+    return dstIndex;
 }
 
-static packet_list_t *buildStreamPacket(stream_id_t streamId, bool ack, uint8_t *payload, size_t payloadSize) {
+bool StreamFragmenter_init(stream_fragmenter_t *const fragmenter, gadget_session_t *const session,
+                           stream_id_t streamId, bool ack, uint8_t const *const payload, size_t payloadSize) {
     // https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#packet-format
     if (streamId != CONTROL_STREAM && streamId != OTA_STREAM && streamId != ALEXA_STREAM) {
         fprintf(stderr, "Invalid argument streamId");
-        return NULL;
+        return false;
     }
-    if (payloadSize > 0xffff) {
+    if (payloadSize > 0xffff || payloadSize > session->peerMaxTransactionSize) {
         fprintf(stderr, "Invalid argument payloadSize");
-        return NULL;
+        return false;
+    }
+    fragmenter->maxPacketSize = session->maxPacketSize;
+    fragmenter->streamId = streamId;
+    fragmenter->transactionId = (payloadSize > 0) ? getNextTransactionId(session, streamId) : 0;
+    fragmenter->ack = ack;
+    fragmenter->seqNum = 0;
+    fragmenter->payload = payload;
+    fragmenter->payloadSize = payloadSize;
+    fragmenter->offset = 0;
+    return true;
+}
+
+bool StreamFragmenter_next(stream_fragmenter_t *const fragmenter, fragment_t *const fragment) {
+    size_t remainingSize = fragmenter->payloadSize - fragmenter->offset;
+    if (remainingSize == 0) {
+        return false;
+    }
+
+    transaction_type_t transactionType = TRANSACTION_TYPE_CONTINUE;
+    if (fragmenter->offset == 0) { // First packet header
+        transactionType = TRANSACTION_TYPE_INITIAL;
+        printf("New Tx Transaction [%d] :: Stream [%d]\n", fragmenter->transactionId, fragmenter->streamId);
+    }
+    bool extendedLength;
+    size_t payloadSize = getFragmentPayloadSize(fragmenter->maxPacketSize, transactionType == TRANSACTION_TYPE_INITIAL,
+                                                remainingSize, &extendedLength);
+
+    // Make the last packet as final.
+    if (transactionType == TRANSACTION_TYPE_CONTINUE && payloadSize == remainingSize) {
+        transactionType = TRANSACTION_TYPE_FINAL;
+    }
+
+    fragment->headerSize = writeFragmentHeader(fragment->header, fragmenter->streamId, fragmenter->transactionId,
+                                               fragmenter->seqNum, transactionType, fragmenter->ack, extendedLength,
+                                               fragmenter->payloadSize, payloadSize);
+    fragment->payload = (fragmenter->payload != NULL) ? &fragmenter->payload[fragmenter->offset] : NULL;
+    fragment->payloadSize = payloadSize;
+
+    fragmenter->seqNum = (fragmenter->seqNum + 1) & SEQ_NUM_ID_MASK;
+    fragmenter->offset += payloadSize;
+    printf("Tx Progress [%zu/%zu] :: Stream [%d] :: Transaction [%d]\n", fragmenter->offset, fragmenter->payloadSize,
+           fragmenter->streamId, fragmenter->transactionId);
+    return true;
+}
+
+static bool buildStreamPacket(gadget_session_t *const session, stream_id_t streamId, bool ack, uint8_t *payload,
+                              size_t payloadSize, packet_queue_t *const queue) {
+    stream_fragmenter_t fragmenter;
+    if (!StreamFragmenter_init(&fragmenter, session, streamId, ack, payload, payloadSize)) {
+        return false;
     }
 
-    size_t remainingSize = payloadSize;
-    packet_list_t *packetListHead = NULL;
-    uint8_t seqNum = 0;
-    transaction_id_t transactionId = 0;
-    size_t srcIndex = 0;
-
-    while (remainingSize > 0) {
-        // Calculate the current size.
-        size_t currentPacketHeaderSize = 3;
-        transaction_type_t transactionType = TRANSACTION_TYPE_CONTINUE;
-        if (srcIndex == 0) { // First packet header
-            transactionType = TRANSACTION_TYPE_INITIAL;
-            transactionId = getNextTransactionId(streamId);
-            printf("New Tx Transaction [%d] :: Stream [%d]\n", transactionId, streamId);
-            currentPacketHeaderSize += 3;
+    packet_queue_t packetQueue = {};
+    fragment_t fragment;
+    while (StreamFragmenter_next(&fragmenter, &fragment)) {
+        size_t currentPacketSize = fragment.headerSize + fragment.payloadSize;
+        if (session->txSink) {
+            // The sink does not keep the packet, so it can be assembled on the stack.
+            uint8_t sinkBuffer[ATT_MTU_MAX];
+            memcpy(sinkBuffer, fragment.header, fragment.headerSize);
+            memcpy(&sinkBuffer[fragment.headerSize], fragment.payload, fragment.payloadSize);
+            session->txSink(session->txSinkContext, sinkBuffer, currentPacketSize);
+            continue;
         }
-        size_t currentPacketPayloadSize = MIN(SAMPLE_NEGOTIATED_MTU - currentPacketHeaderSize, remainingSize);
-        bool extendedLength = false;
-        if (currentPacketPayloadSize > 0xff) {
-            extendedLength = true;
-            currentPacketHeaderSize++;
-            if (currentPacketPayloadSize > SAMPLE_NEGOTIATED_MTU - currentPacketHeaderSize) {
-                currentPacketPayloadSize--;
+        packet_t packet = {};
+        if (allocTxPacket(session, &packet, currentPacketSize)) {
+            memcpy(packet.data, fragment.header, fragment.headerSize);
+            memcpy(&packet.data[fragment.headerSize], fragment.payload, fragment.payloadSize);
+
+            // Append this packet to the queue of buffers ready for TX.
+            if (!PacketQueue_push(&packetQueue, &packet)) {
+                PacketQueue_free(&packetQueue);
+                return false;
             }
+        } else {
+            fprintf(stderr, "Failed to allocate memory for TX packet\n");
+            PacketQueue_free(&packetQueue);
+            return false;
         }
+    }
+    // Only hand over complete messages.
+    PacketQueue_append(queue, &packetQueue);
+    return true;
+}
 
-        // Make the last packet as final.
-        if (transactionType == TRANSACTION_TYPE_CONTINUE && currentPacketPayloadSize == remainingSize) {
-            transactionType = TRANSACTION_TYPE_FINAL;
-        }
-
-        size_t currentPacketSize = currentPacketHeaderSize + currentPacketPayloadSize;
-        uint8_t *const buffer = malloc(currentPacketSize);
-        if (buffer) {
-            size_t dstIndex = 0;
-            // StreamId: 4 bits
-            buffer[dstIndex] = (streamId & STREAM_ID_MASK) << STREAM_ID_SHIFT;
-            // TransactionId: 4 bits
-            buffer[dstIndex] |= (transactionId & TRANSACTION_ID_MASK) << TRANSACTION_ID_SHIFT;
-            dstIndex++;
-
-            // Sequence number: 4 bits
-            buffer[dstIndex] = (seqNum & SEQ_NUM_ID_MASK) << SEQ_NUM_ID_SHIFT;
-            seqNum = (seqNum + 1) & SEQ_NUM_ID_MASK;
-            // Transaction type: 4 bits
-            buffer[dstIndex] |= (transactionType & TRANSACTION_TYPE_MASK) << TRANSACTION_TYPE_SHIFT;
-            // ACK: 1 bit
-            buffer[dstIndex] |= (ack) ? (1U << ACK_BIT_SHIFT) : 0;
-            // LengthExtender: 1 bit
-            buffer[dstIndex] |= (extendedLength) ? (1U << EXTENDED_LENGTH_BIT_SHIFT) : 0;
-            dstIndex++;
-
-            if (transactionType == TRANSACTION_TYPE_INITIAL) {
-                // Reserved: 8 bits
-                buffer[dstIndex++] = 0x00;
-                // Total transaction length.
-                buffer[dstIndex++] = payloadSize >> 8U;
-                buffer[dstIndex++] = payloadSize >> 0U;
+/**
+ * State of a pb_ostream_t that writes the encoded message straight into the payload area of TX packets.
+ * A packet is allocated with its header already written when the first byte for it is produced, and is
+ * appended to the packet queue as soon as it is full. With a TX sink, the packet is assembled in sinkBuffer instead
+ * and passed to the sink as soon as it is full.
+ */
+typedef struct {
+    gadget_session_t *session;
+    stream_fragmenter_t fragmenter;
+    packet_queue_t queue;
+    packet_t packet;
+    size_t packetOffset;
+    uint8_t sinkBuffer[ATT_MTU_MAX];
+} frame_writer_t;
+
+static bool frameWriterCallback(pb_ostream_t *stream, const pb_byte_t *buf, size_t count) {
+    frame_writer_t *const writer = stream->state;
+    while (count > 0) {
+        if (writer->packet.data == NULL) {
+            fragment_t fragment;
+            if (!StreamFragmenter_next(&writer->fragmenter, &fragment)) {
+                return false;
             }
+            size_t packetSize = fragment.headerSize + fragment.payloadSize;
+            if (writer->session->txSink) {
+                writer->packet = (packet_t) {.dataSize = packetSize, .data = writer->sinkBuffer};
+            } else if (!allocTxPacket(writer->session, &writer->packet, packetSize)) {
+                fprintf(stderr, "Failed to allocate memory for TX packet");
+                return false;
+            }
+            memcpy(writer->packet.data, fragment.header, fragment.headerSize);
+            writer->packetOffset = fragment.headerSize;
+        }
 
-            if (extendedLength) {
-                // ExtendedLength: extra 8 bits in payload length.
-                buffer[dstIndex++] = currentPacketPayloadSize >> 8U;
+        size_t chunkSize = MIN(count, writer->packet.dataSize - writer->packetOffset);
+        memcpy(&writer->packet.data[writer->packetOffset], buf, chunkSize);
+        writer->packetOffset += chunkSize;
+        buf += chunkSize;
+        count -= chunkSize;
+
+        if (writer->packetOffset == writer->packet.dataSize) {
+            if (writer->session->txSink) {
+                writer->session->txSink(writer->session->txSinkContext, writer->packet.data, writer->packet.dataSize);
+            } else if (!PacketQueue_push(&writer->queue, &writer->packet)) {
+                // The queue released the packet.
+                writer->packet.data = NULL;
+                return false;
             }
-            // Length: 8 bits.
-            buffer[dstIndex++] = currentPacketPayloadSize >> 0U;
-
-            // Payload
-            memcpy(&buffer[dstIndex], &payload[srcIndex], currentPacketPayloadSize);
-            dstIndex += currentPacketPayloadSize;
-            srcIndex += currentPacketPayloadSize;
-            printf("Tx Progress [%zu/%zu] :: Stream [%d] :: Transaction [%d]\n", srcIndex, payloadSize, streamId,
-                   transactionId);
-
-            // Append this packet to the list of buffers ready for TX.
-            packet_t packet = {};
-            packet.data = buffer;
-            packet.dataSize = currentPacketSize;
-            packetListHead = PacketList_addToTail(packetListHead, &packet);
-        } else {
-            fprintf(stderr, "Failed to allocate memory for TX packet. Exiting");
-            exit(1);
+            writer->packet.data = NULL;
+            writer->packet.dataSize = 0;
         }
-        // Update the remaining size.
-        remainingSize -= currentPacketPayloadSize;
     }
-    return packetListHead;
+    return true;
 }
 
-static packet_list_t *createControlPacket(ControlEnvelope const *const controlEnvelope, bool ackRequired) {
+// Encodes a message straight into the TX packets of a transaction on the stream, from the TX pool when the session
+// has one, without encoding it into an intermediate buffer first.
+static bool encodeStreamPacket(gadget_session_t *const session, stream_id_t streamId, bool ackRequired,
+                               pb_field_t const *const fields, void const *const message, packet_queue_t *const queue) {
     size_t encoded_size;
-    if (!pb_get_encoded_size(&encoded_size, ControlEnvelope_fields, controlEnvelope)) {
-        fprintf(stderr, "Failed To Calculate Control Envelope Encoded Size");
-        return NULL;
+    if (!pb_get_encoded_size(&encoded_size, fields, message)) {
+        fprintf(stderr, "Failed To Calculate Encoded Size");
+        return false;
     }
-    uint8_t buffer[encoded_size];
-    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
-    bool status = pb_encode(&stream, ControlEnvelope_fields, controlEnvelope);
-    if (!status) {
+    // The INITIAL packet carries the total transaction length, so the size has to be known before encoding.
+    frame_writer_t writer = {};
+    writer.session = session;
+    if (!StreamFragmenter_init(&writer.fragmenter, session, streamId, ackRequired, NULL, encoded_size)) {
+        return false;
+    }
+    pb_ostream_t stream = {&frameWriterCallback, &writer, encoded_size, 0};
+    bool status = pb_encode(&stream, fields, message);
+    if (!status || stream.bytes_written != encoded_size) {
         fprintf(stderr, "%s: pb_encode failed :: %s\n", __FUNCTION__, PB_GET_ERROR(&stream));
-        return NULL;
+        if (writer.packet.data != writer.sinkBuffer) {
+            freePacket(&writer.packet);
+        }
+        PacketQueue_free(&writer.queue);
+        return false;
     }
-    return buildStreamPacket(CONTROL_STREAM, ackRequired, buffer, stream.bytes_written);
+    // Only hand over complete messages.
+    PacketQueue_append(queue, &writer.queue);
+    return true;
 }
 
-packet_list_t *createCommandGetDeviceInformation() {
+static bool createControlPacket(gadget_session_t *const session, ControlEnvelope const *const controlEnvelope,
+                                bool ackRequired, packet_queue_t *const queue) {
+    return encodeStreamPacket(session, CONTROL_STREAM, ackRequired, ControlEnvelope_fields, controlEnvelope, queue);
+}
+
+bool createCommandGetDeviceInformation(gadget_session_t *const session, packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_GET_DEVICE_INFORMATION;
 
     printf("Creating command: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createCommandGetDeviceFeatures() {
+bool createCommandGetDeviceFeatures(gadget_session_t *const session, packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_GET_DEVICE_FEATURES;
 
     printf("Creating command: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createCommandUpdateComponentSegment() {
+bool createUpdateComponentSegmentCommand(gadget_session_t *const session,
+                                         UpdateComponentSegment const *const updateComponentSegment,
+                                         packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_UPDATE_COMPONENT_SEGMENT;
     controlEnvelope.which_payload = ControlEnvelope_update_component_segment_tag;
+    controlEnvelope.payload.update_component_segment = *updateComponentSegment;
+
+    printf("Creating command: %s\n", commandToString(controlEnvelope.command));
+    return createControlPacket(session, &controlEnvelope, true, queue);
+}
 
-    UpdateComponentSegment *updateComponentSegment = &controlEnvelope.payload.update_component_segment;
-    strcpy(updateComponentSegment->component_name, "ComponentName");
-    updateComponentSegment->component_offset = 0;
+bool createCommandUpdateComponentSegment(gadget_session_t *const session, packet_queue_t *const queue) {
+    UpdateComponentSegment updateComponentSegment = UpdateComponentSegment_init_default;
+    strcpy(updateComponentSegment.component_name, "ComponentName");
+    updateComponentSegment.component_offset = 0;
     // note: cannot overwrite the last byte of the signature because nanopb needs null termination.
-    memset(updateComponentSegment->segment_signature, 0xAA,
-           sizeof(updateComponentSegment->segment_signature) - 1);
-    updateComponentSegment->segment_size = 1024;
+    memset(updateComponentSegment.segment_signature, 0xAA, sizeof(updateComponentSegment.segment_signature) - 1);
+    updateComponentSegment.segment_size = 1024;
 
-    printf("Creating command: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, true);
+    return createUpdateComponentSegmentCommand(session, &updateComponentSegment, queue);
 }
 
-packet_list_t *createCommandApplyFirmware() {
+bool createApplyFirmwareCommand(gadget_session_t *const session, ApplyFirmware const *const applyFirmware,
+                                packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_APPLY_FIRMWARE;
     controlEnvelope.which_payload = ControlEnvelope_apply_firmware_tag;
+    controlEnvelope.payload.apply_firmware = *applyFirmware;
 
-    ApplyFirmware *applyFirmware = &controlEnvelope.payload.apply_firmware;
+    printf("Creating command: %s\n", commandToString(controlEnvelope.command));
+    return createControlPacket(session, &controlEnvelope, true, queue);
+}
+
+bool createCommandApplyFirmware(gadget_session_t *const session, packet_queue_t *const queue) {
+    ApplyFirmware applyFirmwareCommand = ApplyFirmware_init_default;
+    ApplyFirmware *applyFirmware = &applyFirmwareCommand;
     applyFirmware->restart_required = true;
     applyFirmware->firmware_information.version = 12;
     strcpy(applyFirmware->firmware_information.name, "FirmwareName");
@@ -276,12 +438,28 @@ packet_list_t *createCommandApplyFirmware() {
     // note: cannot overwrite the last byte of the signature because nanopb needs null termination.
     memset(firmwareComponent->signature, 0xBB, sizeof(firmwareComponent->signature) - 1);
 
+    return createApplyFirmwareCommand(session, applyFirmware, queue);
+}
 
-    printf("Creating command: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, true);
+bool createOtaData(gadget_session_t *const session, uint8_t const *data, size_t dataSize,
+                   packet_queue_t *const queue) {
+    packet_queue_t packetQueue = {};
+    while (dataSize > 0) {
+        // Each transaction carries as much as the peer accepts.
+        size_t transactionSize = MIN(dataSize, session->peerMaxTransactionSize);
+        if (!buildStreamPacket(session, OTA_STREAM, true, (uint8_t *) data, transactionSize, &packetQueue)) {
+            PacketQueue_free(&packetQueue);
+            return false;
+        }
+        data += transactionSize;
+        dataSize -= transactionSize;
+    }
+    PacketQueue_append(queue, &packetQueue);
+    return true;
 }
 
-packet_list_t *createResponseError(Command cmd, ErrorCode errorCode, uint16_t tag) {
+bool createResponseError(gadget_session_t *const session, Command cmd, ErrorCode errorCode, uint16_t tag,
+                         packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = cmd;
     controlEnvelope.which_payload = ControlEnvelope_response_tag;
@@ -291,10 +469,10 @@ packet_list_t *createResponseError(Command cmd, ErrorCode errorCode, uint16_t ta
     response->which_payload = tag;
 
     printf("Creating response error for command: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createResponseGetDeviceInformation() {
+bool createResponseGetDeviceInformation(gadget_session_t *const session, packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_GET_DEVICE_INFORMATION;
     controlEnvelope.which_payload = ControlEnvelope_response_tag;
@@ -309,10 +487,10 @@ packet_list_t *createResponseGetDeviceInformation() {
     strcpy(deviceInformation->device_type, "wxyz");
 
     printf("Creating response: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createResponseGetDeviceFeatures() {
+bool createResponseGetDeviceFeatures(gadget_session_t *const session, packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_GET_DEVICE_FEATURES;
     controlEnvelope.which_payload = ControlEnvelope_response_tag;
@@ -323,59 +501,136 @@ packet_list_t *createResponseGetDeviceFeatures() {
     deviceFeatures->features = 0x13; // Support Alexa Gadgets Toolkit and OTA.
 
     printf("Creating response: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createResponseUpdateComponentSegment() {
+bool createResponseUpdateComponentSegment(gadget_session_t *const session, packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_UPDATE_COMPONENT_SEGMENT;
     controlEnvelope.which_payload = ControlEnvelope_response_tag;
     controlEnvelope.payload.response.error_code = ErrorCode_SUCCESS;
 
     printf("Creating response: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
+}
+
+bool createResponseUpdateComponentSegmentResume(gadget_session_t *const session, char const *const componentName,
+                                                uint32_t componentOffset, packet_queue_t *const queue) {
+    ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
+    controlEnvelope.command = Command_UPDATE_COMPONENT_SEGMENT;
+    controlEnvelope.which_payload = ControlEnvelope_response_tag;
+    controlEnvelope.payload.response.error_code = ErrorCode_INVALID;
+    controlEnvelope.payload.response.which_payload = Response_firmware_component_tag;
+    FirmwareComponent *component = &controlEnvelope.payload.response.payload.firmware_component;
+    strncpy(component->name, componentName, sizeof(component->name) - 1);
+    component->size = componentOffset;
+
+    printf("Creating response: %s :: Resume point [%u]\n", commandToString(controlEnvelope.command), componentOffset);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createResponseApplyFirmware() {
+bool createResponseApplyFirmware(gadget_session_t *const session, packet_queue_t *const queue) {
     ControlEnvelope controlEnvelope = ControlEnvelope_init_default;
     controlEnvelope.command = Command_APPLY_FIRMWARE;
     controlEnvelope.which_payload = ControlEnvelope_response_tag;
     controlEnvelope.payload.response.error_code = ErrorCode_SUCCESS;
 
     printf("Creating response: %s\n", commandToString(controlEnvelope.command));
-    return createControlPacket(&controlEnvelope, false);
+    return createControlPacket(session, &controlEnvelope, false, queue);
 }
 
-packet_list_t *createAlexaDiscoveryDiscoverDirective() {
+bool createAlexaDiscoveryDiscoverDirective(gadget_session_t *const session, packet_queue_t *const queue) {
     printf("Creating Alexa.Discovery::Discover directive\n");
 
     // For creating this message, check out the sample code in AlexaGadgetsProtobuf/examples folder.
     uint8_t buffer[] = {0x0a, 0x1d, 0x0a, 0x1b, 0x0a, 0x0f, 0x41, 0x6c, 0x65, 0x78, 0x61, 0x2e, 0x44, 0x69, 0x73, 0x63,
                         0x6f, 0x76, 0x65, 0x72, 0x79, 0x12, 0x08, 0x44, 0x69, 0x73, 0x63, 0x6f, 0x76, 0x65, 0x72};
-    packet_list_t *packetList = buildStreamPacket(ALEXA_STREAM, false, buffer, sizeof(buffer));
-    return packetList;
+    return buildStreamPacket(session, ALEXA_STREAM, false, buffer, sizeof(buffer), queue);
 }
 
-packet_list_t *createSampleDiscoveryResponseMessage() {
-    printf("Creating Alexa.Discovery::Discover.Response event\n");
+bool createAlexaStateListenerStateUpdateDirective(gadget_session_t *const session, char const *const name,
+                                                  char const *const value, packet_queue_t *const queue) {
+    printf("Creating Alexa.Gadget.StateListener::StateUpdate directive [%s=%s]\n", name, value);
+
+    // Directive header with namespace "Alexa.Gadget.StateListener" and name "StateUpdate".
+    static uint8_t const header[] = {0x0a, 0x29, 0x0a, 0x1a, 0x41, 0x6c, 0x65, 0x78, 0x61, 0x2e, 0x47, 0x61, 0x64,
+                                     0x67, 0x65, 0x74, 0x2e, 0x53, 0x74, 0x61, 0x74, 0x65, 0x4c, 0x69, 0x73, 0x74,
+                                     0x65, 0x6e, 0x65, 0x72, 0x12, 0x0b, 0x53, 0x74, 0x61, 0x74, 0x65, 0x55, 0x70,
+                                     0x64, 0x61, 0x74, 0x65};
+    size_t nameSize = strlen(name);
+    size_t valueSize = strlen(value);
+    size_t statesSize = 2 + nameSize + 2 + valueSize;
+    size_t payloadSize = 2 + statesSize;
+    size_t directiveSize = sizeof(header) + 2 + payloadSize;
+    // All lengths are encoded on a single byte.
+    uint8_t buffer[2 + 0x7f];
+    if (directiveSize > 0x7f) {
+        fprintf(stderr, "%s: State too long [%zu]\n", __FUNCTION__, directiveSize);
+        return false;
+    }
+    size_t size = 0;
+    buffer[size++] = 0x0a;
+    buffer[size++] = directiveSize;
+    memcpy(&buffer[size], header, sizeof(header));
+    size += sizeof(header);
+    buffer[size++] = 0x12;
+    buffer[size++] = payloadSize;
+    buffer[size++] = 0x0a;
+    buffer[size++] = statesSize;
+    buffer[size++] = 0x0a;
+    buffer[size++] = nameSize;
+    memcpy(&buffer[size], name, nameSize);
+    size += nameSize;
+    buffer[size++] = 0x12;
+    buffer[size++] = valueSize;
+    memcpy(&buffer[size], value, valueSize);
+    size += valueSize;
+    return buildStreamPacket(session, ALEXA_STREAM, false, buffer, size, queue);
+}
 
-    // For creating this message, check out the sample code in AlexaGadgetsProtobuf/examples folder.
-    uint8_t buffer[] = {0x0a, 0xf2, 0x01, 0x0a, 0x24, 0x0a, 0x0f, 0x41, 0x6c, 0x65, 0x78, 0x61, 0x2e, 0x44, 0x69, 0x73,
-                        0x63, 0x6f, 0x76, 0x65, 0x72, 0x79, 0x12, 0x11, 0x44, 0x69, 0x73, 0x63, 0x6f, 0x76, 0x65, 0x72,
-                        0x2e, 0x52, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x12, 0xc9, 0x01, 0x0a, 0xc6, 0x01, 0x0a,
-                        0x07, 0x74, 0x65, 0x73, 0x74, 0x20, 0x69, 0x64, 0x12, 0x0d, 0x66, 0x72, 0x69, 0x65, 0x6e, 0x64,
-                        0x6c, 0x79, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x5a, 0x24, 0x0a, 0x0b, 0x74, 0x65, 0x73, 0x74, 0x20,
-                        0x74, 0x79, 0x70, 0x65, 0x20, 0x31, 0x12, 0x10, 0x54, 0x65, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x74,
-                        0x65, 0x72, 0x66, 0x61, 0x63, 0x65, 0x20, 0x31, 0x1a, 0x03, 0x31, 0x2e, 0x30, 0x5a, 0x24, 0x0a,
-                        0x0b, 0x74, 0x65, 0x73, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65, 0x20, 0x32, 0x12, 0x10, 0x54, 0x65,
-                        0x73, 0x74, 0x20, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x66, 0x61, 0x63, 0x65, 0x20, 0x32, 0x1a, 0x03,
-                        0x31, 0x2e, 0x30, 0x5a, 0x24, 0x0a, 0x0b, 0x74, 0x65, 0x73, 0x74, 0x20, 0x74, 0x79, 0x70, 0x65,
-                        0x20, 0x33, 0x12, 0x10, 0x54, 0x65, 0x73, 0x74, 0x20, 0x69, 0x6e, 0x74, 0x65, 0x72, 0x66, 0x61,
-                        0x63, 0x65, 0x20, 0x33, 0x1a, 0x03, 0x31, 0x2e, 0x31, 0x62, 0x3a, 0x0a, 0x02, 0x31, 0x39, 0x12,
-                        0x09, 0x78, 0x78, 0x78, 0x78, 0x78, 0x78, 0x78, 0x78, 0x78, 0x1a, 0x03, 0x79, 0x79, 0x79, 0x22,
-                        0x07, 0x61, 0x61, 0x62, 0x62, 0x63, 0x63, 0x64, 0x2a, 0x0f, 0x6d, 0x6f, 0x63, 0x6b, 0x20, 0x6d,
-                        0x6f, 0x64, 0x65, 0x6c, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x32, 0x0a, 0x31, 0x32, 0x33, 0x34, 0x35,
-                        0x36, 0x37, 0x38, 0x39, 0x30};
-    packet_list_t *packetList = buildStreamPacket(ALEXA_STREAM, false, buffer, sizeof(buffer));
-    return packetList;
+bool createDiscoveryResponse(gadget_session_t *const session, discovery_endpoint_t const *const endpoint,
+                             packet_queue_t *const queue) {
+    alexaDiscovery_DiscoverResponseEventProto event;
+    if (!DiscoveryResponse_fill(endpoint, &event)) {
+        return false;
+    }
+    return encodeStreamPacket(session, ALEXA_STREAM, false, alexaDiscovery_DiscoverResponseEventProto_fields, &event,
+                              queue);
+}
+
+static discovery_capability_t const sampleCapabilities[] = {
+        {.type = "test type 1", .interface = "Test interface 1", .version = "1.0"},
+        {.type = "test type 2", .interface = "Test interface 2", .version = "1.0"},
+        {.type = "test type 3", .interface = "Test interface 3", .version = "1.1"},
+};
+
+// Written once by initSampleDiscoveryEndpoint(), before any session reads it.
+static char sampleDeviceToken[DEVICE_TOKEN_SIZE];
+
+static discovery_endpoint_t const sampleEndpoint = {
+        .endpointId = "test id",
+        .friendlyName = "friendly name",
+        .capabilities = sampleCapabilities,
+        .numCapabilities = sizeof(sampleCapabilities) / sizeof(sampleCapabilities[0]),
+        .firmwareVersion = "19",
+        .deviceToken = sampleDeviceToken,
+        .deviceTokenEncryptionType = "yyy",
+        .amazonDeviceType = "aabbccd",
+        .modelName = "mock model name",
+        .radioAddress = "1234567890",
+};
+
+bool initSampleDiscoveryEndpoint() {
+    // Replace with the device secret received from the developer portal at gadget registration.
+    static char const sampleDeviceSecret[] = "76AB4E896EE2A081BCAEA241058A2EEC2D016C250CF355451D7A7009A560B3F2";
+    return DiscoveryEndpoint_computeDeviceToken(sampleEndpoint.endpointId, sampleDeviceSecret, sampleDeviceToken);
+}
+
+bool createSampleDiscoveryResponseMessage(gadget_session_t *const session, packet_queue_t *const queue) {
+    printf("Creating Alexa.Discovery::Discover.Response event\n");
+    if (sampleDeviceToken[0] == '\0') {
+        fprintf(stderr, "%s: initSampleDiscoveryEndpoint() was not called\n", __FUNCTION__);
+        return false;
+    }
+    return createDiscoveryResponse(session, &sampleEndpoint, queue);
 }
@@ -11,73 +11,210 @@
 
 #include "helpers.h"
 #include "common.h"
+#include "discovery.h"
 #include "accessories.pb.h"
+#include "session.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Builds a message and appends its packets to \p queue, such as createCommandGetDeviceInformation().
+ */
+typedef bool (*message_builder_t)(gadget_session_t *session, packet_queue_t *queue);
+
+/**
+ * Assigns the next transaction id of a stream.
+ * @param session the session of the connection to send on.
+ * @param streamId the stream of the transaction.
+ * @return the transaction id, 4 bits only.
+ */
+transaction_id_t getNextTransactionId(gadget_session_t *session, stream_id_t streamId);
+
+/**
+ * Allocates the data of a TX packet from the session's fragment pool if it has one and it is not exhausted, and
+ * from the session allocator otherwise. The packet is set up so that freePacket() releases the data correctly.
+ * @param session the session of the connection to send on.
+ * @param packet the packet to set up.
+ * @param dataSize the packet size in bytes.
+ * @return false if the allocation failed.
+ */
+bool allocTxPacket(gadget_session_t *session, packet_t *packet, size_t dataSize);
+
+/**
+ * Splits an encoded stream payload into packets of the session maxPacketSize without allocating or copying.
+ * Initialize it with StreamFragmenter_init() and call StreamFragmenter_next() until it returns false.
+ */
+typedef struct {
+    uint16_t maxPacketSize;
+    stream_id_t streamId;
+    transaction_id_t transactionId;
+    bool ack;
+    uint8_t seqNum;
+    uint8_t const *payload;
+    size_t payloadSize;
+    size_t offset;
+} stream_fragmenter_t;
+
+/**
+ * Starts a new TX transaction over \p payload and assigns it the next transaction id of the stream.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#packet-format
+ * @param fragmenter the fragmenter to initialize.
+ * @param session the session of the connection to send on. Packets are sized to the session maxPacketSize.
+ * @param streamId the stream to send the transaction on.
+ * @param ack set to true to request an ACK from the receiver.
+ * @param payload the encoded payload. It must stay valid until all fragments have been sent. It can be NULL if the
+ * caller fills the payload of each fragment itself, in which case the fragments only carry the header and size.
+ * @param payloadSize the payload size in bytes, at most the peer's maximum transaction size.
+ * @return false if any of the arguments is invalid.
+ */
+bool StreamFragmenter_init(stream_fragmenter_t *fragmenter, gadget_session_t *session, stream_id_t streamId,
+                           bool ack, uint8_t const *payload, size_t payloadSize);
+
+/**
+ * Produces the next packet of the transaction.
+ * @param fragmenter an initialized fragmenter.
+ * @param fragment receives the packet header and a pointer/length into the payload passed to StreamFragmenter_init().
+ * @return false once all of the payload has been fragmented.
+ */
+bool StreamFragmenter_next(stream_fragmenter_t *fragmenter, fragment_t *fragment);
+
+/*
+ * The create* functions below append the packets of the message to \p queue and return false if the message could not
+ * be built, in which case nothing is appended. If the session has a TX sink, the packets are passed to the sink as
+ * they are built instead.
+ */
+
 /**
  * Create sample AlexaDiscovery.Discover directive as sent from Echo device.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/proto-buffer-format.html#directive-proto-files
  */
-packet_list_t *createAlexaDiscoveryDiscoverDirective();
+bool createAlexaDiscoveryDiscoverDirective(gadget_session_t *session, packet_queue_t *queue);
+
+/**
+ * Create sample Alexa.Gadget.StateListener StateUpdate directive with a single state, as sent from Echo device.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/alexa-gadget-statelistener-interface.html#StateUpdate-directive
+ * @param session the session of the connection.
+ * @param name the state name, e.g. "wakeword".
+ * @param value the state value, e.g. "active".
+ * @param queue the queue the packets are appended to.
+ */
+bool createAlexaStateListenerStateUpdateDirective(gadget_session_t *session, char const *name, char const *value,
+                                                  packet_queue_t *queue);
 
 /**
  * Create sample ApplyFirmware response as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#apply-firmware-response
  */
-packet_list_t *createResponseApplyFirmware();
+bool createResponseApplyFirmware(gadget_session_t *session, packet_queue_t *queue);
 
 /**
  * Create sample error response as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#response
  */
-packet_list_t *createResponseError(Command cmd, ErrorCode errorCode, uint16_t tag);
+bool createResponseError(gadget_session_t *session, Command cmd, ErrorCode errorCode, uint16_t tag,
+                         packet_queue_t *queue);
 
 /**
  * Create sample GetDeviceFeatures response as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#device-features-response
  */
-packet_list_t *createResponseGetDeviceFeatures();
+bool createResponseGetDeviceFeatures(gadget_session_t *session, packet_queue_t *queue);
 
 /**
  * Create sample GetDeviceInformation response as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#device-information-response
  */
-packet_list_t *createResponseGetDeviceInformation();
+bool createResponseGetDeviceInformation(gadget_session_t *session, packet_queue_t *queue);
 
 /**
  * Create sample UpdateComponentSegment response as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#update-component-segment-response
  */
-packet_list_t *createResponseUpdateComponentSegment();
+bool createResponseUpdateComponentSegment(gadget_session_t *session, packet_queue_t *queue);
+
+/**
+ * Create the UpdateComponentSegment response of a Gadget that resumes an interrupted update. The segment is not
+ * received: the error code is INVALID, and the firmware_component payload names the component and carries, as its
+ * size, the offset the Echo device sends the component from.
+ * This is a convention of this sample, not part of the Alexa Gadgets protocol: Echo devices do not interpret it, and
+ * only see an INVALID response. Use it only with a peer that implements the same convention, such as the Echo side of
+ * sample.c.
+ */
+bool createResponseUpdateComponentSegmentResume(gadget_session_t *session, char const *componentName,
+                                                uint32_t componentOffset, packet_queue_t *queue);
+
+/**
+ * Create an Alexa.Discovery Discover.Response event for \p endpoint as sent from Gadget.
+ * The event is sized with pb_get_encoded_size() and encoded straight into the payload of its ALEXA_STREAM packets,
+ * taken from the session TX pool when it has one, so it is never held in an intermediate buffer.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/alexa-discovery-interface.html#discover-response-event
+ */
+bool createDiscoveryResponse(gadget_session_t *session, discovery_endpoint_t const *endpoint, packet_queue_t *queue);
+
+/**
+ * Computes the device token of the sample Discover.Response endpoint. Call it once at boot, before any session sends
+ * the sample Discover.Response, so that sessions on different threads only read the token.
+ * @return false if the token could not be computed.
+ */
+bool initSampleDiscoveryEndpoint();
 
 /**
  * Create sample Alexa.Discovery DiscoveryResponse as sent from Gadget.
+ * initSampleDiscoveryEndpoint() must have been called.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/proto-buffer-format.html#event-proto-files
  */
-packet_list_t *createSampleDiscoveryResponseMessage();
+bool createSampleDiscoveryResponseMessage(gadget_session_t *session, packet_queue_t *queue);
+
+/**
+ * Create ApplyFirmware command as sent from Echo device.
+ * @param session the session of the connection.
+ * @param applyFirmware the command payload.
+ * @param queue the queue the packets are appended to.
+ */
+bool createApplyFirmwareCommand(gadget_session_t *session, ApplyFirmware const *applyFirmware,
+                                packet_queue_t *queue);
 
 /**
  * Create sample ApplyFirmware command as sent from Echo device.
  */
-packet_list_t *createCommandApplyFirmware();
+bool createCommandApplyFirmware(gadget_session_t *session, packet_queue_t *queue);
 
 /**
  * Create sample GetDeviceFeatures command as sent from Echo device.
  */
-packet_list_t *createCommandGetDeviceFeatures();
+bool createCommandGetDeviceFeatures(gadget_session_t *session, packet_queue_t *queue);
 
 /**
  * Create sample GetDeviceInformation command as sent from Echo device.
  */
-packet_list_t *createCommandGetDeviceInformation();
+bool createCommandGetDeviceInformation(gadget_session_t *session, packet_queue_t *queue);
+
+/**
+ * Create UpdateComponentSegment command as sent from Echo device.
+ * @param session the session of the connection.
+ * @param updateComponentSegment the command payload.
+ * @param queue the queue the packets are appended to.
+ */
+bool createUpdateComponentSegmentCommand(gadget_session_t *session,
+                                         UpdateComponentSegment const *updateComponentSegment,
+                                         packet_queue_t *queue);
 
 /**
  * Create sample UpdateComponentSegment command as sent from Echo device.
  */
-packet_list_t *createCommandUpdateComponentSegment();
+bool createCommandUpdateComponentSegment(gadget_session_t *session, packet_queue_t *queue);
+
+/**
+ * Create the OTA_STREAM transactions that carry the data of a segment, as sent from Echo device after an
+ * UpdateComponentSegment command. The data is split into transactions of at most the peer's maximum transaction size.
+ * @param session the session of the connection.
+ * @param data the segment data.
+ * @param dataSize the segment size in bytes.
+ * @param queue the queue the packets are appended to.
+ */
+bool createOtaData(gadget_session_t *session, uint8_t const *data, size_t dataSize, packet_queue_t *queue);
 
 /**
  * Create sample advertising packet payload as sent from Gadget.
@@ -89,14 +226,23 @@ packet_t createAdvertisingPacket();
  * Create sample control ACK packet as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#ack-packet
  */
-packet_t
-createControlAckPacket(stream_id_t streamId, transaction_id_t transactionId, bool ack, control_ack_result_t result);
+packet_t createControlAckPacket(gadget_session_t *session, stream_id_t streamId, transaction_id_t transactionId,
+                                bool ack, control_ack_result_t result);
+
+/**
+ * Sends a control ACK packet for a received transaction.
+ * If the session has a TX sink, the packet is built on the stack and passed to the sink. Otherwise it is created
+ * with createControlAckPacket() and appended to \p queue.
+ * https://developer.amazon.com/docs/alexa-gadgets-toolkit/packet-ble.html#ack-packet
+ */
+void sendControlAckPacket(gadget_session_t *session, stream_id_t streamId, transaction_id_t transactionId, bool ack,
+                          control_ack_result_t result, packet_queue_t *queue);
 
 /**
  * Create sample Protocol Version packet as sent from Gadget.
  * https://developer.amazon.com/docs/alexa-gadgets-toolkit/bluetooth-le-settings.html#pvp
  */
-packet_t createProtocolVersionPacket();
+packet_t createProtocolVersionPacket(gadget_session_t *session);
 
 #ifdef __cplusplus
 }
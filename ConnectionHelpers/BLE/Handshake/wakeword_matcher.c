@@ -0,0 +1,88 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#include <string.h>
+
+#include "wakeword_matcher.h"
+
+#define NAMESPACE_PATTERN (0U)
+#define ACTIVE_PATTERN (1U)
+#define CLEARED_PATTERN (2U)
+
+// First byte of every pattern: the tag of field 1, length-delimited.
+#define PATTERN_START (0x0aU)
+
+typedef struct {
+    uint8_t const *bytes;
+    uint8_t size;
+} pattern_t;
+
+#define PATTERN(literal) {(uint8_t const *) (literal), sizeof(literal) - 1}
+
+// The namespace field of directiveHeader.proto, and the name and value fields of a StateUpdate States entry.
+static pattern_t const patterns[WAKEWORD_PATTERN_COUNT] = {
+        [NAMESPACE_PATTERN] = PATTERN("\x0a\x1a" "Alexa.Gadget.StateListener"),
+        [ACTIVE_PATTERN] = PATTERN("\x0a\x08" "wakeword" "\x12\x06" "active"),
+        [CLEARED_PATTERN] = PATTERN("\x0a\x08" "wakeword" "\x12\x07" "cleared"),
+};
+
+void WakewordMatcher_reset(wakeword_matcher_t *const matcher) {
+    memset(matcher->progress, 0, sizeof(matcher->progress));
+    matcher->inStateUpdate = false;
+}
+
+// Matches the next byte against a pattern. Returns true when the byte completes the pattern.
+static bool advance(wakeword_matcher_t *const matcher, size_t index, uint8_t byte) {
+    pattern_t const *const pattern = &patterns[index];
+    uint8_t progress = matcher->progress[index];
+    if (byte == pattern->bytes[progress]) {
+        progress++;
+    } else {
+        // PATTERN_START does not occur again in the pattern, so no partial match can overlap this one.
+        progress = byte == PATTERN_START ? 1 : 0;
+    }
+    if (progress == pattern->size) {
+        matcher->progress[index] = 0;
+        return true;
+    }
+    matcher->progress[index] = progress;
+    return false;
+}
+
+static void setState(wakeword_matcher_t *const matcher, bool active) {
+    wakeword_state_t state = active ? WAKEWORD_STATE_ACTIVE : WAKEWORD_STATE_CLEARED;
+    if (state == matcher->state) return;
+    matcher->state = state;
+    if (matcher->handler) {
+        matcher->handler(matcher->context, active);
+    }
+}
+
+void WakewordMatcher_feed(wakeword_matcher_t *const matcher, uint8_t const *data, size_t size) {
+    uint8_t const *const end = data + size;
+    while (data < end) {
+        // The header comes first, so only the namespace is looked for until it is found.
+        bool idle = matcher->inStateUpdate
+                    ? matcher->progress[ACTIVE_PATTERN] == 0 && matcher->progress[CLEARED_PATTERN] == 0
+                    : matcher->progress[NAMESPACE_PATTERN] == 0;
+        if (idle) {
+            data = memchr(data, PATTERN_START, (size_t) (end - data));
+            if (!data) return;
+        }
+        uint8_t byte = *data++;
+        if (!matcher->inStateUpdate) {
+            matcher->inStateUpdate = advance(matcher, NAMESPACE_PATTERN, byte);
+        } else {
+            bool active = advance(matcher, ACTIVE_PATTERN, byte);
+            bool cleared = advance(matcher, CLEARED_PATTERN, byte);
+            if (active || cleared) {
+                setState(matcher, active);
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+//
+// Copyright 2019 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+// These materials are licensed under the Amazon Software License in connection with the Alexa Gadgets Program.
+// The Agreement is available at https://aws.amazon.com/asl/.
+// See the Agreement for the specific terms and conditions of the Agreement.
+// Capitalized terms not defined in this file have the meanings given to them in the Agreement.
+//
+
+#ifndef ALEXA_GADGETS_SAMPLE_CODE_WAKEWORD_MATCHER_H
+#define ALEXA_GADGETS_SAMPLE_CODE_WAKEWORD_MATCHER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The byte patterns looked for: the StateListener namespace, and the wakeword state with each of its values.
+#define WAKEWORD_PATTERN_COUNT (3U)
+
+/**
+ * Value of the wakeword state, as last spotted by a wakeword_matcher_t.
+ */
+typedef enum {
+    WAKEWORD_STATE_UNKNOWN = 0,
+    WAKEWORD_STATE_ACTIVE,
+    WAKEWORD_STATE_CLEARED
+} wakeword_state_t;
+
+/**
+ * Callback that signals a wakeword state transition.
+ * @param context the context registered along with the callback.
+ * @param active true when the wake word was detected, false when it was cleared.
+ * @sa GadgetSession_setWakewordHandler().
+ */
+typedef void (*wakeword_handler_t)(void *context, bool active);
+
+/**
+ * Spots the wakeword state of Alexa.Gadget.StateListener StateUpdate directives in the raw bytes of ALEXA_STREAM
+ * transactions, without decoding them.
+ * The patterns are the encoded protobuf fields, tags and lengths included, built at compile time. They all start with
+ * a byte that does not occur again in any of them, so a mismatch only ever falls back to the start of the pattern,
+ * and the bytes in between the fields are skipped with memchr(). The matcher is resumable: the transaction can be fed
+ * in any number of chunks, e.g. one per packet, and a pattern split across two packets is still found.
+ * The handler is only called when the state changes, not for a StateUpdate that repeats the current value.
+ * @sa WakewordMatcher_reset().
+ * @sa WakewordMatcher_feed().
+ */
+typedef struct {
+    wakeword_handler_t handler;
+    void *context;
+    /// Number of bytes of each pattern matched so far.
+    uint8_t progress[WAKEWORD_PATTERN_COUNT];
+    /// Set once the StateListener namespace was found in the directive header of the current transaction.
+    bool inStateUpdate;
+    wakeword_state_t state;
+} wakeword_matcher_t;
+
+/**
+ * Starts looking at a new transaction. The wakeword state is kept.
+ * @param matcher the matcher.
+ */
+void WakewordMatcher_reset(wakeword_matcher_t *matcher);
+
+/**
+ * Looks at the next chunk of the current transaction, and calls the handler for each wakeword state transition found.
+ * @param matcher the matcher.
+ * @param data the chunk, typically the payload of one packet.
+ * @param size the chunk size in bytes.
+ */
+void WakewordMatcher_feed(wakeword_matcher_t *matcher, uint8_t const *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ALEXA_GADGETS_SAMPLE_CODE_WAKEWORD_MATCHER_H